@@ -1,24 +1,127 @@
-/* checksize.c 
+/* checksize.c
  *
  * Copyright (C) 2000- GODA Kazuo (The University of Tokyo)
  *
  * $Id: iotest.c,v 1.8 2007/09/27 10:04:59 kgoda Exp $
  *
  * Time-stamp: <2008-05-08 14:24:29 kgoda>
+ *
+ * Sizes of C types, and what the I/O stack of this host and of the given
+ * targets supports. The latter may be saved as a profile (-p), which
+ * iotest -I reads; each line of it is key=value, and the keys following
+ * a target= line are of that target.
  */
 
+#ifndef _GNU_SOURCE
+#define _GNU_SOURCE
+#endif
+
 #include <stdio.h>
+#include <stdlib.h>
+#include <stddef.h>
+#include <stdarg.h>
+#include <string.h>
 #include <unistd.h>
 #include <stdint.h>
+#include <fcntl.h>
+#include <limits.h>
+#include <sys/types.h>
+#include <sys/stat.h>
+#include <sys/syscall.h>
+
+#ifdef __linux__
+#include <sys/sysmacros.h>
+#if defined(__NR_io_uring_setup) && defined(__has_include)
+#if __has_include(<linux/io_uring.h>)
+#include <linux/io_uring.h>
+#define HAVE_IO_URING
+#endif
+#endif
+#endif
+
+#if defined(__x86_64__) || defined(__i386__)
+#include <cpuid.h>
+#endif
 
 #define CHECK(var) \
-  printf("  %18s: %8ld bytes long, %8s\n", \
+  printf("  %18s: %8zu bytes long, %8s\n", \
     #var, \
     sizeof(var), \
     (var)-1 < (var)0 ? "signed" : "unsigned"\
   );
 
+#define DIO_MAX_ALIGN 65536
+
+static FILE *profile;
+
+static void print_usage(void);
+static void check_types(void);
+static void probe_host(void);
+static void probe_target(char *);
+static void probe_dio(char *, int *, int *);
+static void report(char *, char *, ...);
+static long long read_num(char *);
+static int read_str(char *, char *, int);
+
 int main(int argc, char **argv)
+{
+    int ch, i;
+
+    while((ch = getopt(argc, argv, "p:")) != -1){
+	switch(ch){
+	case 'p':
+	    if((profile = fopen(optarg, "w")) == NULL){
+		perror("main:fopen()");
+		exit(EXIT_FAILURE);
+	    }
+	    break;
+	default:
+	    print_usage();
+	    exit(EXIT_FAILURE);
+	}
+    }
+
+    check_types();
+
+    if(profile)
+	fprintf(profile, "# checksize profile\n");
+    printf("Host:\n");
+    probe_host();
+    for(i=optind; i<argc; i++){
+	printf("Target %s:\n", argv[i]);
+	probe_target(argv[i]);
+    }
+
+    if(profile && fclose(profile) != 0){
+	perror("main:fclose()");
+	exit(EXIT_FAILURE);
+    }
+
+    return(0);
+}
+
+/*
+ * print_usage():
+ */
+
+static void print_usage(void)
+{
+    fputs("\
+Usage: checksize [-p profile] [targets ...]\n\
+Description:\n\
+  Sizes of C types, and I/O capabilities of this host and of the targets\n\
+  (devices or files)\n\
+Options:\n\
+  -p <s> : saves the capabilities to the profile, to be read by iotest -I\n\
+",
+	  stderr);
+}
+
+/*
+ * check_types(): sizes and signedness of C types
+ */
+
+static void check_types(void)
 {
     CHECK(char);
     CHECK(unsigned char);
@@ -56,8 +159,260 @@ int main(int argc, char **argv)
     CHECK(__off64_t);
 #endif
     CHECK(wchar_t);
+    puts("");
+}
+
+/*
+ * probe_host(): aio limits, io_uring, hugepages, NUMA and the TSC
+ */
+
+static void probe_host(void)
+{
+    char buf[256];
+    long long v;
+
+    report("page_size", "%ld", sysconf(_SC_PAGESIZE));
+    report("ncpu", "%ld", sysconf(_SC_NPROCESSORS_ONLN));
+
+    /* Each aio context takes max(n, 4 x cpus) x 2 events of aio-max-nr. */
+    if((v = read_num("/proc/sys/fs/aio-max-nr")) >= 0){
+	report("aio_max_nr", "%lld", v);
+	report("aio_nr", "%lld", read_num("/proc/sys/fs/aio-nr"));
+    }
+
+#ifdef HAVE_IO_URING
+    {
+	struct io_uring_params p;
+	struct io_uring_probe *probe;
+	int fd, n = 0, i, is_rw = 0;
+	size_t size = sizeof(struct io_uring_probe) + 256 * sizeof(struct io_uring_probe_op);
+
+	memset(&p, 0, sizeof(p));
+	/* Not built in, or disabled by kernel.io_uring_disabled or seccomp */
+	if((fd = syscall(__NR_io_uring_setup, 4, &p)) < 0)
+	    report("io_uring", "0");
+	else{
+	    report("io_uring", "1");
+	    report("io_uring_features", "0x%x", p.features);
+	    if((probe = (struct io_uring_probe *)calloc(1, size)) != NULL &&
+	       syscall(__NR_io_uring_register, fd, IORING_REGISTER_PROBE, probe, 256) == 0){
+		for(i=0; i<probe->ops_len; i++)
+		    if(probe->ops[i].flags & IO_URING_OP_SUPPORTED)
+			n++;
+		is_rw = probe->last_op >= IORING_OP_WRITE &&
+		    (probe->ops[IORING_OP_READ].flags & IO_URING_OP_SUPPORTED) &&
+		    (probe->ops[IORING_OP_WRITE].flags & IO_URING_OP_SUPPORTED);
+		report("io_uring_ops", "%d", n);
+		report("io_uring_rw", "%d", is_rw);
+	    }
+	    free(probe);
+	    close(fd);
+	}
+    }
+#else
+    report("io_uring", "0");
+#endif
+
+    {
+	FILE *fp;
+	long long total = 0, nfree = 0, size = 0;
+	if((fp = fopen("/proc/meminfo", "r")) != NULL){
+	    while(fgets(buf, sizeof(buf), fp)){
+		sscanf(buf, "HugePages_Total: %lld", &total);
+		sscanf(buf, "HugePages_Free: %lld", &nfree);
+		sscanf(buf, "Hugepagesize: %lld", &size);
+	    }
+	    fclose(fp);
+	    report("hugepage_size", "%lld", size);
+	    report("hugepages_total", "%lld", total);
+	    report("hugepages_free", "%lld", nfree);
+	}
+    }
+    if(read_str("/sys/kernel/mm/transparent_hugepage/enabled", buf, sizeof(buf)) == 0){
+	char *s = strchr(buf, '['), *e = s ? strchr(s, ']') : NULL;
+	if(s && e){
+	    *e = '\0';
+	    report("thp", "%s", s + 1);
+	}
+    }
+
+    /* Online nodes, as a list of ranges such as 0-1,3 */
+    if(read_str("/sys/devices/system/node/online", buf, sizeof(buf)) == 0){
+	char *s = buf;
+	int n = 0, lo, hi, k;
+	while(*s){
+	    if((k = sscanf(s, "%d-%d", &lo, &hi)) < 1)
+		break;
+	    n += k == 2 ? hi - lo + 1 : 1;
+	    if((s = strchr(s, ',')) == NULL)
+		break;
+	    s++;
+	}
+	report("numa_nodes", "%d", n);
+    }else
+	report("numa_nodes", "1");
+
+#if defined(__x86_64__) || defined(__i386__)
+    {
+	unsigned int eax, ebx, ecx, edx;
+	/* Invariant TSC: CPUID.80000007H:EDX[8] */
+	report("tsc_invariant", "%d",
+	       __get_cpuid(0x80000007, &eax, &ebx, &ecx, &edx) && (edx & (1 << 8)) ? 1 : 0);
+    }
+#else
+    report("tsc_invariant", "0");
+#endif
+    if(read_str("/sys/devices/system/clocksource/clocksource0/current_clocksource", buf, sizeof(buf)) == 0)
+	report("clocksource", "%s", buf);
+}
+
+/*
+ * probe_target(): block sizes, O_DIRECT alignment, queue and NUMA node
+ * of a device or of the device under a file
+ */
+
+static void probe_target(char *path)
+{
+    struct stat st;
+    char sys[64], name[PATH_MAX];
+    int mem_align, ofst_align;
+    long long v;
+
+    if(profile)
+	fprintf(profile, "target=%s\n", path);
+    if(stat(path, &st) != 0){
+	perror("probe_target:stat()");
+	exit(EXIT_FAILURE);
+    }
+    report("type", "%s", S_ISBLK(st.st_mode) ? "block" : S_ISREG(st.st_mode) ? "file" : "other");
+
+    probe_dio(path, &mem_align, &ofst_align);
+    report("dio", "%d", ofst_align > 0);
+    if(ofst_align > 0){
+	report("dio_mem_align", "%d", mem_align);
+	report("dio_offset_align", "%d", ofst_align);
+    }
+
+#ifdef __linux__
+    {
+	dev_t dev = S_ISBLK(st.st_mode) ? st.st_rdev : st.st_dev;
+	char *q = "";
+
+	/* A partition has its queue and device in its parent. */
+	snprintf(sys, sizeof(sys), "/sys/dev/block/%u:%u", major(dev), minor(dev));
+	snprintf(name, sizeof(name), "%s/queue", sys);
+	if(access(name, F_OK) != 0)
+	    q = "/..";
+	if(access(sys, F_OK) != 0){
+	    printf("  %19s: no block device under it\n", "queue");
+	    return;
+	}
+	snprintf(name, sizeof(name), "%s%s/queue/logical_block_size", sys, q);
+	if((v = read_num(name)) > 0)
+	    report("logical_block_size", "%lld", v);
+	snprintf(name, sizeof(name), "%s%s/queue/physical_block_size", sys, q);
+	if((v = read_num(name)) > 0)
+	    report("physical_block_size", "%lld", v);
+	snprintf(name, sizeof(name), "%s%s/queue/nr_requests", sys, q);
+	if((v = read_num(name)) > 0)
+	    report("nr_requests", "%lld", v);
+	snprintf(name, sizeof(name), "%s%s/queue/rotational", sys, q);
+	if((v = read_num(name)) >= 0)
+	    report("rotational", "%lld", v);
+	snprintf(name, sizeof(name), "%s%s/device/numa_node", sys, q);
+	report("numa_node", "%lld", read_num(name));
+    }
+#endif
+}
+
+/*
+ * probe_dio(): O_DIRECT alignment of memory and of offsets and sizes;
+ * statx() tells it where supported, otherwise the smallest power of two
+ * read successfully is taken. 0 if O_DIRECT is not supported.
+ */
+
+static void probe_dio(char *path, int *mem_align, int *ofst_align)
+{
+    char *base;
+    int fd, a;
+
+    *mem_align = *ofst_align = 0;
+
+#ifdef STATX_DIOALIGN
+    {
+	struct statx stx;
+	if(statx(AT_FDCWD, path, 0, STATX_DIOALIGN, &stx) == 0 &&
+	   (stx.stx_mask & STATX_DIOALIGN) && stx.stx_dio_offset_align){
+	    *mem_align = stx.stx_dio_mem_align;
+	    *ofst_align = stx.stx_dio_offset_align;
+	    return;
+	}
+    }
+#endif
+
+#ifdef O_DIRECT
+    if((fd = open(path, O_RDONLY | O_DIRECT)) < 0)
+	return;
+    if(posix_memalign((void **)&base, DIO_MAX_ALIGN, DIO_MAX_ALIGN * 2) != 0){
+	perror("probe_dio:posix_memalign()");
+	exit(EXIT_FAILURE);
+    }
+    for(a=512; a<=DIO_MAX_ALIGN && !*ofst_align; a*=2)
+	if(pread(fd, base, a, a) >= 0)
+	    *ofst_align = a;
+    for(a=1; a<=DIO_MAX_ALIGN && *ofst_align && !*mem_align; a*=2)
+	if(pread(fd, base + a, *ofst_align, 0) >= 0)
+	    *mem_align = a;
+    free(base);
+    close(fd);
+#endif
+}
+
+/*
+ * report(): prints a capability, and saves it to the profile
+ */
+
+static void report(char *key, char *fmt, ...)
+{
+    char val[256];
+    va_list ap;
+
+    va_start(ap, fmt);
+    vsnprintf(val, sizeof(val), fmt, ap);
+    va_end(ap);
+
+    printf("  %19s: %s\n", key, val);
+    if(profile)
+	fprintf(profile, "%s=%s\n", key, val);
+}
+
+/*
+ * read_num(), read_str(): the first number or line of a file; -1 if it
+ * cannot be read
+ */
+
+static long long read_num(char *path)
+{
+    char buf[64];
+
+    if(read_str(path, buf, sizeof(buf)) != 0)
+	return(-1);
+    return(strtoll(buf, NULL, 10));
+}
+
+static int read_str(char *path, char *buf, int len)
+{
+    FILE *fp;
 
+    if((fp = fopen(path, "r")) == NULL)
+	return(-1);
+    if(fgets(buf, len, fp) == NULL){
+	fclose(fp);
+	return(-1);
+    }
+    fclose(fp);
+    buf[strcspn(buf, "\n")] = '\0';
     return(0);
 }
 
-/* iotest.c */
+/* checksize.c */
@@ -0,0 +1,138 @@
+#!/bin/sh
+#
+# bench.sh - iotest
+#
+# Copyright (C) 2000- The University of Tokyo.
+#
+# Regression benchmark of iotest itself: runs a fixed matrix on a file in
+# tmpfs (or on a loop device), writes the results to bench.out, and
+# compares them with the baseline, bench.base. A point regresses when its
+# throughput falls, or its CPU time per io rises, by more than the
+# tolerance.
+#
+# Usage: bench.sh [-b]
+#   -b : saves the results as the baseline instead of comparing
+#
+# Environment:
+#   BENCH_FILE : target; unless set, /dev/shm/iotest.bench
+#   BENCH_SIZE : its size (in MiB); unless set, 256
+#   BENCH_DUR  : duration of each run (in s); unless set, 3
+#   BENCH_REP  : runs of each point, of which the best is taken; unless
+#                set, 3
+#   BENCH_TOL  : tolerance (in %); unless set, 10
+#   BENCH_SEED : random seed of iotest -x; unless set, 1
+
+IOTEST=${IOTEST:-./iotest}
+FILE=${BENCH_FILE:-/dev/shm/iotest.bench}
+SIZE=${BENCH_SIZE:-256}
+DUR=${BENCH_DUR:-3}
+REP=${BENCH_REP:-3}
+TOL=${BENCH_TOL:-10}
+SEED=${BENCH_SEED:-1}
+OUT=bench.out
+BASE=bench.base
+
+is_base=0
+if [ "$1" = "-b" ]; then
+    is_base=1
+fi
+
+if [ ! -x "$IOTEST" ]; then
+    echo "Error: $IOTEST is not built." 1>&2
+    exit 1
+fi
+
+# The file is filled once, so that reads hit its pages rather than holes.
+if [ ! -f "$FILE" ] || [ `wc -c < "$FILE"` -ne `expr $SIZE \* 1048576` ]; then
+    $IOTEST -P fill,size=${SIZE}m "$FILE" > /dev/null || exit 1
+fi
+
+#
+# run(): runs a point $REP times and appends the run of the highest
+# throughput to $OUT, as
+#
+#   name   throughput [IO/s], [MB/s]   avg, 99% [ms]   CPU time [us/io]
+#
+
+run() {
+    name=$1
+    shift
+    printf "  %-24s" "$name" 1>&2
+    : > $OUT.tmp
+    i=0
+    while [ $i -lt $REP ]; do
+	$IOTEST -x $SEED -D $DUR "$@" "$FILE" | awk -v name="$name" -F: '
+	    /^  Total throughput/  { iops = $2 + 0; getline; mbps = $2 + 0 }
+	    /^  Avg. Resp. time/   { avg = $2 + 0 }
+	    /^  Resp. time pctl./  { split($2, p, " "); p99 = p[2] + 0 }
+	    /^  CPU time/          { cpu = $2 + 0 }
+	    END {
+		if(iops == 0)
+		    exit 1
+		printf("%s\t%.3f\t%.3f\t%.6f\t%.6f\t%.3f\n", name, iops, mbps, avg, p99, cpu)
+	    }' >> $OUT.tmp || { echo " failed" 1>&2; rm -f $OUT.tmp; exit 1; }
+	i=`expr $i + 1`
+    done
+    awk -F'\t' '$2 + 0 > best { best = $2 + 0; line = $0 } END { print line }' $OUT.tmp >> $OUT
+    rm -f $OUT.tmp
+    tail -1 $OUT | awk -F'\t' '{ printf(" %12.3f [IO/s] %8.3f [us/io]\n", $2, $6) }' 1>&2
+}
+
+echo "# iotest bench: $FILE ${SIZE}m, best of $REP runs of ${DUR}s per point, seed $SEED" > $OUT
+printf "# name\tiops\tmbps\tavg_ms\tp99_ms\tcpu_us\n" >> $OUT
+
+# Ceiling of iotest itself, without system calls
+run null-rand-4k-1 -n -R -b 4096
+run null-seq-4k-1 -n -S -b 4096
+
+for engine in sync libaio; do
+    case $engine in
+    sync)   eopt="-i sync" ;;
+    libaio) eopt="-i libaio -A 4" ;;
+    esac
+    for mode in rand seq; do
+	case $mode in
+	rand) mopt=-R ;;
+	seq)  mopt=-S ;;
+	esac
+	for bs in 4096 65536; do
+	    for nthr in 1 4; do
+		run $engine-$mode-`expr $bs / 1024`k-$nthr $eopt $mopt -b $bs -M $nthr
+	    done
+	done
+    done
+done
+
+if [ $is_base -eq 1 ]; then
+    cp $OUT $BASE
+    echo "Baseline saved to $BASE."
+    exit 0
+fi
+if [ ! -f $BASE ]; then
+    echo "No baseline; make bench-base saves $OUT as the baseline."
+    exit 0
+fi
+
+#
+# Comparison with the baseline; points missing from either are skipped
+#
+
+awk -v tol=$TOL -F'\t' '
+    /^#/ { next }
+    FNR == NR { iops[$1] = $2; cpu[$1] = $6; next }
+    !($1 in iops) { next }
+    {
+	d_iops = iops[$1] > 0 ? ($2 - iops[$1]) / iops[$1] * 100 : 0
+	d_cpu = cpu[$1] > 0 ? ($6 - cpu[$1]) / cpu[$1] * 100 : 0
+	flag = ""
+	if(d_iops < -tol || d_cpu > tol){
+	    flag = "  REGRESSED"
+	    nreg++
+	}
+	printf("  %-24s %+8.2f%% [IO/s] %+8.2f%% [us/io]%s\n", $1, d_iops, d_cpu, flag)
+	n++
+    }
+    END {
+	printf("%d of %d points regressed over %s%% from the baseline.\n", nreg, n, tol)
+	exit(nreg > 0)
+    }' $BASE $OUT
@@ -0,0 +1,758 @@
+/* iotcoord.c
+ *
+ * Copyright (C) 2000- GODA Kazuo (The University of Tokyo)
+ *
+ * Coordinator of iotest -z: starts iotests together, and reports their
+ * counters over the run and combined at the end
+ */
+
+#include "iotest_int.h"
+
+#define MAX_NWORKER     256
+#define COORD_INT       1000        /* [ms] */
+#define COORD_DELAY     100         /* [ms] */
+#define COORD_TIMEOUT   60          /* [s] to connect and get ready */
+
+#define WORKER_HELLO    0           /* connected */
+#define WORKER_READY    1           /* at the start barrier */
+#define WORKER_RUNNING  2
+#define WORKER_DONE     3           /* sent FINAL */
+#define WORKER_LOST     4
+
+struct iotcoord_worker_t {
+    int fd;
+    pid_t pid;                      /* launched by -e, or 0 */
+    int state;                      /* WORKER_* */
+    struct iotest_coord_msg_t hello;
+    struct iotest_coord_msg_t cur;  /* latest counters, and those last shown */
+    struct iotest_coord_msg_t prev;
+    uint64_t hist[HIST_NBUCKET];
+    uint64_t phist[HIST_NBUCKET];
+};
+
+static struct {
+    char *path;                     /* Unix domain socket, or */
+    int port;                       /* TCP port on loopback */
+    int lfd;
+    char *exe;                      /* iotest run by -e */
+    char *cmd[MAX_NWORKER];
+    int ncmd;
+    pid_t pid[MAX_NWORKER];
+    int nextern;                    /* iotests started by others */
+    int interval;                   /* [ms] */
+    int delay;                      /* [ms] */
+    int is_verbose;
+    struct iotcoord_worker_t *w;
+    int nw;
+    uint64_t t0;                    /* start time [ns] */
+    volatile sig_atomic_t stop_signo;
+} iotcoord;
+
+static void print_usage(void);
+static void listen_socket(void);
+static void launch(void);
+static void accept_workers(void);
+static void start_workers(void);
+static void run(void);
+static void stop_workers(void);
+static int recv_msg(struct iotcoord_worker_t *);
+static int send_msg(struct iotcoord_worker_t *, int, uint64_t);
+static void lost(struct iotcoord_worker_t *);
+static void print_interval(void);
+static void print_result(void);
+static void print_row(char *, struct iotest_stat_ent_t *, struct iotest_stat_ent_t *,
+		      double, uint64_t *, uint64_t *);
+static uint64_t coord_clock(void);
+static void on_signal(int);
+
+/*
+ *
+ * Main
+ *
+ */
+
+int main(int argc, char **argv)
+{
+    int ch, i, status, is_failed = 0;
+    char *p;
+
+    iotcoord.interval = COORD_INT;
+    iotcoord.delay = COORD_DELAY;
+    iotcoord.lfd = -1;
+
+    while((ch = getopt(argc, argv, "s:p:n:e:x:i:d:vV")) != -1){
+	switch(ch){
+	case 's':
+	    iotcoord.path = optarg;
+	    break;
+	case 'p':
+	    if((iotcoord.port = atoi(optarg)) <= 0 || iotcoord.port > 65535){
+		fprintf(stderr, "Error: Port must be between 1 and 65535.\n");
+		exit(EXIT_FAILURE);
+	    }
+	    break;
+	case 'n':
+	    if((iotcoord.nextern = atoi(optarg)) < 0){
+		fprintf(stderr, "Error: Number of iotests must be a non-negative integer.\n");
+		exit(EXIT_FAILURE);
+	    }
+	    break;
+	case 'e':
+	    if(iotcoord.ncmd >= MAX_NWORKER){
+		fprintf(stderr, "Error: Up to %d iotests can be run.\n", MAX_NWORKER);
+		exit(EXIT_FAILURE);
+	    }
+	    iotcoord.cmd[iotcoord.ncmd++] = optarg;
+	    break;
+	case 'x':
+	    iotcoord.exe = optarg;
+	    break;
+	case 'i':
+	    if((iotcoord.interval = atoi(optarg)) <= 0){
+		fprintf(stderr, "Error: Interval must be a positive integer.\n");
+		exit(EXIT_FAILURE);
+	    }
+	    break;
+	case 'd':
+	    if((iotcoord.delay = atoi(optarg)) < 0){
+		fprintf(stderr, "Error: Delay must be a non-negative integer.\n");
+		exit(EXIT_FAILURE);
+	    }
+	    break;
+	case 'v':
+	    iotcoord.is_verbose = 1;
+	    break;
+	case 'V':
+	    printf("iotcoord %s\n", VERSION);
+	    exit(EXIT_SUCCESS);
+	default:
+	    print_usage();
+	    exit(EXIT_FAILURE);
+	}
+    }
+    if(optind != argc){
+	print_usage();
+	exit(EXIT_FAILURE);
+    }
+    if(iotcoord.path && iotcoord.port){
+	fprintf(stderr, "Error: -s and -p cannot be specified simultaneously.\n");
+	exit(EXIT_FAILURE);
+    }
+    iotcoord.nw = iotcoord.ncmd + iotcoord.nextern;
+    if(iotcoord.nw == 0 || iotcoord.nw > MAX_NWORKER){
+	fprintf(stderr, "Error: 1 to %d iotests must be given by -e or -n.\n", MAX_NWORKER);
+	print_usage();
+	exit(EXIT_FAILURE);
+    }
+    if(iotcoord.nextern && !iotcoord.path && !iotcoord.port){
+	fprintf(stderr, "Error: -n requires the socket, -s or -p, to be known.\n");
+	exit(EXIT_FAILURE);
+    }
+    if(!iotcoord.path && !iotcoord.port){
+	static char path[64];
+	snprintf(path, sizeof(path), "/tmp/iotcoord.%d", (int)getpid());
+	iotcoord.path = path;
+    }
+    /* iotest is looked for beside iotcoord, or in PATH. */
+    if(iotcoord.exe == NULL){
+	if((p = strrchr(argv[0], '/')) != NULL){
+	    if((iotcoord.exe = (char *)malloc(p - argv[0] + sizeof("/iotest"))) == NULL){
+		perror("main:malloc()");
+		exit(EXIT_FAILURE);
+	    }
+	    sprintf(iotcoord.exe, "%.*s/iotest", (int)(p - argv[0]), argv[0]);
+	}else
+	    iotcoord.exe = "iotest";
+    }
+    if((iotcoord.w = (struct iotcoord_worker_t *)
+	calloc(iotcoord.nw, sizeof(struct iotcoord_worker_t))) == NULL){
+	perror("main:calloc()");
+	exit(EXIT_FAILURE);
+    }
+
+    {
+	struct sigaction sa;
+
+	/* Without SA_RESTART, so that poll() returns on a signal. */
+	memset(&sa, 0, sizeof(sa));
+	sa.sa_handler = on_signal;
+	sigemptyset(&sa.sa_mask);
+	sigaction(SIGINT, &sa, NULL);
+	sigaction(SIGTERM, &sa, NULL);
+    }
+
+    listen_socket();
+    launch();
+    accept_workers();
+    start_workers();
+    run();
+    print_result();
+
+    for(i=0; i<iotcoord.ncmd; i++)
+	if(iotcoord.pid[i] > 0 && waitpid(iotcoord.pid[i], &status, 0) == iotcoord.pid[i] &&
+	   (!WIFEXITED(status) || WEXITSTATUS(status) != EXIT_SUCCESS)){
+	    fprintf(stderr, "Error: iotest of -e \"%s\" failed.\n", iotcoord.cmd[i]);
+	    is_failed = 1;
+	}
+    for(i=0; i<iotcoord.nw; i++)
+	if(iotcoord.w[i].state == WORKER_LOST)
+	    is_failed = 1;
+
+    return(is_failed ? EXIT_FAILURE : EXIT_SUCCESS);
+}
+
+/*
+ * print_usage():
+ */
+
+static void print_usage(void)
+{
+    fputs("\
+Usage: iotcoord [options]\n\
+Description:\n\
+  Starts iotests together, and reports their counters every interval and\n\
+  combined at the end. Each of them connects by iotest -z.\n\
+Options:\n\
+  -e <s> : runs iotest with the options, e.g. -e \"-R -b 4096 -D 10 /dev/sdb\";\n\
+           may be repeated. Their output is discarded unless -v\n\
+  -n <n> : number of iotests started by others with -z; unless set, 0\n\
+  -s <s> : Unix domain socket; unless set, /tmp/iotcoord.<pid>\n\
+  -p <n> : TCP port on 127.0.0.1, instead of -s\n\
+  -x <s> : iotest of -e; unless set, that beside iotcoord, or in PATH\n\
+  -i <n> : interval of the reports (in ms); unless set, 1000\n\
+  -d <n> : delay of the start after all are ready (in ms); unless set, 100\n\
+  -v     : verbose mode; shows the output of the iotests of -e\n\
+  -V     : version\n\
+",
+	  stderr);
+}
+
+/*
+ * listen_socket(): opens the socket the iotests connect to
+ */
+
+static void listen_socket(void)
+{
+    int one = 1;
+
+    if(iotcoord.path){
+	struct sockaddr_un sa;
+
+	memset(&sa, 0, sizeof(sa));
+	sa.sun_family = AF_UNIX;
+	if(strlen(iotcoord.path) >= sizeof(sa.sun_path)){
+	    fprintf(stderr, "Error: Path of the socket is too long, %s.\n", iotcoord.path);
+	    exit(EXIT_FAILURE);
+	}
+	strcpy(sa.sun_path, iotcoord.path);
+	unlink(iotcoord.path);
+	if((iotcoord.lfd = socket(AF_UNIX, SOCK_STREAM, 0)) < 0){
+	    perror("listen_socket:socket()");
+	    exit(EXIT_FAILURE);
+	}
+	if(bind(iotcoord.lfd, (struct sockaddr *)&sa, sizeof(sa)) != 0){
+	    perror("listen_socket:bind()");
+	    exit(EXIT_FAILURE);
+	}
+    }else{
+	struct sockaddr_in sa;
+
+	memset(&sa, 0, sizeof(sa));
+	sa.sin_family = AF_INET;
+	sa.sin_port = htons(iotcoord.port);
+	sa.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+	if((iotcoord.lfd = socket(AF_INET, SOCK_STREAM, 0)) < 0){
+	    perror("listen_socket:socket()");
+	    exit(EXIT_FAILURE);
+	}
+	setsockopt(iotcoord.lfd, SOL_SOCKET, SO_REUSEADDR, &one, sizeof(one));
+	if(bind(iotcoord.lfd, (struct sockaddr *)&sa, sizeof(sa)) != 0){
+	    perror("listen_socket:bind()");
+	    exit(EXIT_FAILURE);
+	}
+    }
+    if(listen(iotcoord.lfd, MAX_NWORKER) != 0){
+	perror("listen_socket:listen()");
+	exit(EXIT_FAILURE);
+    }
+}
+
+/*
+ * launch(): runs the iotests of -e through the shell, which is replaced
+ * by iotest, so that its pid is that of the connection
+ */
+
+static void launch(void)
+{
+    char *line, zopt[128];
+    size_t len;
+    int i, fd;
+
+    if(iotcoord.path)
+	snprintf(zopt, sizeof(zopt), "-z path=%s", iotcoord.path);
+    else
+	snprintf(zopt, sizeof(zopt), "-z port=%d", iotcoord.port);
+
+    for(i=0; i<iotcoord.ncmd; i++){
+	len = strlen(iotcoord.exe) + strlen(zopt) + strlen(iotcoord.cmd[i]) + sizeof("exec   ");
+	if((line = (char *)malloc(len)) == NULL){
+	    perror("launch:malloc()");
+	    exit(EXIT_FAILURE);
+	}
+	snprintf(line, len, "exec %s %s %s", iotcoord.exe, zopt, iotcoord.cmd[i]);
+	if(iotcoord.is_verbose)
+	    printf("Running %s\n", line);
+
+	fflush(stdout);
+	if((iotcoord.pid[i] = fork()) < 0){
+	    perror("launch:fork()");
+	    exit(EXIT_FAILURE);
+	}
+	if(iotcoord.pid[i] == 0){
+	    close(iotcoord.lfd);
+	    if(!iotcoord.is_verbose && (fd = open("/dev/null", O_WRONLY)) >= 0){
+		dup2(fd, STDOUT_FILENO);
+		close(fd);
+	    }
+	    execl("/bin/sh", "sh", "-c", line, (char *)NULL);
+	    perror("launch:execl()");
+	    _exit(EXIT_FAILURE);
+	}
+	free(line);
+    }
+}
+
+/*
+ * accept_workers(): waits for all the iotests to connect and introduce
+ * themselves
+ */
+
+static void accept_workers(void)
+{
+    struct pollfd pfd;
+    uint64_t limit = coord_clock() + (uint64_t)COORD_TIMEOUT * GIGA;
+    int i, n = 0, status;
+
+    while(n < iotcoord.nw){
+	struct iotcoord_worker_t *w = &(iotcoord.w[n]);
+	int fd;
+
+	if(iotcoord.stop_signo || coord_clock() > limit){
+	    fprintf(stderr, "Error: %d of %d iotests connected.\n", n, iotcoord.nw);
+	    exit(EXIT_FAILURE);
+	}
+	/* An iotest of -e may fail on its options before connecting. */
+	for(i=0; i<iotcoord.ncmd; i++)
+	    if(iotcoord.pid[i] > 0 && waitpid(iotcoord.pid[i], &status, WNOHANG) == iotcoord.pid[i]){
+		fprintf(stderr, "Error: iotest of -e \"%s\" exited before starting.\n",
+			iotcoord.cmd[i]);
+		exit(EXIT_FAILURE);
+	    }
+
+	pfd.fd = iotcoord.lfd;
+	pfd.events = POLLIN;
+	if(poll(&pfd, 1, 100) <= 0)
+	    continue;
+	if((fd = accept(iotcoord.lfd, NULL, NULL)) < 0){
+	    if(errno == EINTR)
+		continue;
+	    perror("accept_workers:accept()");
+	    exit(EXIT_FAILURE);
+	}
+	if(iotcoord.port){
+	    int one = 1;
+	    setsockopt(fd, IPPROTO_TCP, TCP_NODELAY, &one, sizeof(one));
+	}
+
+	w->fd = fd;
+	if(recv_msg(w) != IOTEST_COORD_HELLO){
+	    fprintf(stderr, "Warning: A connection not from iotest -z is closed.\n");
+	    close(fd);
+	    continue;
+	}
+	w->hello = w->cur;
+	w->state = WORKER_HELLO;
+	for(i=0; i<iotcoord.ncmd; i++)
+	    if(iotcoord.pid[i] == w->hello.pid)
+		w->pid = w->hello.pid;
+	if(iotcoord.is_verbose)
+	    printf("Connected %s (pid %d), %u threads on %u devices.\n",
+		   w->hello.tot.name, w->hello.pid, w->hello.nthr, w->hello.ndev);
+	n++;
+    }
+
+    close(iotcoord.lfd);
+    if(iotcoord.path)
+	unlink(iotcoord.path);
+}
+
+/*
+ * start_workers(): waits for all of them to be ready, and sends the time
+ * to start, a little ahead so that it reaches all of them before
+ */
+
+static void start_workers(void)
+{
+    struct pollfd *pfd;
+    uint64_t limit = coord_clock() + (uint64_t)COORD_TIMEOUT * GIGA;
+    int i, n;
+
+    if((pfd = (struct pollfd *)calloc(iotcoord.nw, sizeof(struct pollfd))) == NULL){
+	perror("start_workers:calloc()");
+	exit(EXIT_FAILURE);
+    }
+
+    for(;;){
+	for(i=0, n=0; i<iotcoord.nw; i++){
+	    pfd[i].fd = iotcoord.w[i].state == WORKER_HELLO ? iotcoord.w[i].fd : -1;
+	    pfd[i].events = POLLIN;
+	    pfd[i].revents = 0;
+	    n += iotcoord.w[i].state == WORKER_HELLO;
+	}
+	if(n == 0)
+	    break;
+	if(iotcoord.stop_signo || coord_clock() > limit){
+	    stop_workers();
+	    break;
+	}
+	if(poll(pfd, iotcoord.nw, 100) <= 0)
+	    continue;
+	for(i=0; i<iotcoord.nw; i++){
+	    struct iotcoord_worker_t *w = &(iotcoord.w[i]);
+
+	    if(!pfd[i].revents)
+		continue;
+	    switch(recv_msg(w)){
+	    case IOTEST_COORD_READY:
+		w->state = WORKER_READY;
+		break;
+	    case IOTEST_COORD_FINAL:
+		/* Stopped by itself before the start */
+		w->state = WORKER_DONE;
+		break;
+	    default:
+		lost(w);
+		break;
+	    }
+	}
+    }
+    free(pfd);
+
+    iotcoord.t0 = coord_clock() + (uint64_t)iotcoord.delay * MEGA;
+    for(i=0; i<iotcoord.nw; i++){
+	struct iotcoord_worker_t *w = &(iotcoord.w[i]);
+
+	if(w->state != WORKER_READY)
+	    continue;
+	if(send_msg(w, IOTEST_COORD_START, iotcoord.t0) != 0){
+	    lost(w);
+	    continue;
+	}
+	w->state = WORKER_RUNNING;
+	memset(&(w->cur), 0, sizeof(w->cur));
+	w->cur.ts = iotcoord.t0;
+	w->prev = w->cur;
+    }
+}
+
+/*
+ * run(): receives the counters until all the iotests end, and shows the
+ * rates of each and their total every interval
+ */
+
+static void run(void)
+{
+    struct pollfd *pfd;
+    uint64_t next = iotcoord.t0 + (uint64_t)iotcoord.interval * MEGA * 5 / 4, now;
+    int i, n, ms, is_stopped = 0;
+
+    if((pfd = (struct pollfd *)calloc(iotcoord.nw, sizeof(struct pollfd))) == NULL){
+	perror("run:calloc()");
+	exit(EXIT_FAILURE);
+    }
+
+    for(;;){
+	for(i=0, n=0; i<iotcoord.nw; i++){
+	    pfd[i].fd = iotcoord.w[i].state == WORKER_RUNNING ? iotcoord.w[i].fd : -1;
+	    pfd[i].events = POLLIN;
+	    pfd[i].revents = 0;
+	    n += iotcoord.w[i].state == WORKER_RUNNING;
+	}
+	if(n == 0)
+	    break;
+	if(iotcoord.stop_signo && !is_stopped){
+	    stop_workers();
+	    is_stopped = 1;
+	}
+
+	/* Reports a quarter of an interval after the iotests send. */
+	if((now = coord_clock()) >= next){
+	    print_interval();
+	    while(next <= now)
+		next += (uint64_t)iotcoord.interval * MEGA;
+	}
+	ms = (next - now + MEGA - 1) / MEGA;
+	if(poll(pfd, iotcoord.nw, ms) <= 0)
+	    continue;
+
+	for(i=0; i<iotcoord.nw; i++){
+	    struct iotcoord_worker_t *w = &(iotcoord.w[i]);
+
+	    if(!pfd[i].revents)
+		continue;
+	    switch(recv_msg(w)){
+	    case IOTEST_COORD_STAT:
+		break;
+	    case IOTEST_COORD_FINAL:
+		w->state = WORKER_DONE;
+		break;
+	    default:
+		lost(w);
+		break;
+	    }
+	}
+    }
+    free(pfd);
+}
+
+/*
+ * stop_workers(): asks the iotests which have not ended to stop
+ */
+
+static void stop_workers(void)
+{
+    int i;
+
+    for(i=0; i<iotcoord.nw; i++){
+	struct iotcoord_worker_t *w = &(iotcoord.w[i]);
+	if(w->state < WORKER_DONE && send_msg(w, IOTEST_COORD_STOP, 0) != 0)
+	    lost(w);
+    }
+}
+
+/*
+ * recv_msg(): reads a message of an iotest into its latest counters;
+ * returns its type, or -1 if it is gone
+ */
+
+static int recv_msg(struct iotcoord_worker_t *w)
+{
+    struct iotest_coord_msg_t msg;
+    ssize_t len = sizeof(uint64_t) * HIST_NBUCKET;
+
+    if(recv(w->fd, &msg, sizeof(msg), MSG_WAITALL) != sizeof(msg) ||
+       msg.magic != IOTEST_COORD_MAGIC)
+	return(-1);
+    if(msg.type == IOTEST_COORD_STAT || msg.type == IOTEST_COORD_FINAL)
+	if(recv(w->fd, w->hist, len, MSG_WAITALL) != len)
+	    return(-1);
+    w->cur = msg;
+    return(msg.type);
+}
+
+/*
+ * send_msg(): sends a message of the type to an iotest
+ */
+
+static int send_msg(struct iotcoord_worker_t *w, int type, uint64_t ts)
+{
+    struct iotest_coord_msg_t msg;
+
+    memset(&msg, 0, sizeof(msg));
+    msg.magic = IOTEST_COORD_MAGIC;
+    msg.type = type;
+    msg.pid = getpid();
+    msg.interval = iotcoord.interval;
+    msg.ts = ts;
+    if(send(w->fd, &msg, sizeof(msg), MSG_NOSIGNAL) != sizeof(msg))
+	return(-1);
+    return(0);
+}
+
+/*
+ * lost(): drops an iotest which has closed the connection or failed
+ */
+
+static void lost(struct iotcoord_worker_t *w)
+{
+    if(w->state == WORKER_LOST)
+	return;
+    fprintf(stderr, "Warning: %s (pid %d) is lost before its end.\n",
+	    w->hello.tot.name, w->hello.pid);
+    close(w->fd);
+    w->state = WORKER_LOST;
+}
+
+/*
+ * print_interval(): prints the rates of each iotest since the previous
+ * report, and their total
+ */
+
+static void print_interval(void)
+{
+    struct iotest_stat_ent_t tot, ptot;
+    uint64_t *hist, *phist;
+    double elapsed, rio = 0, rbyte = 0;
+    int i, k;
+
+    if((hist = (uint64_t *)calloc(2 * HIST_NBUCKET, sizeof(uint64_t))) == NULL){
+	perror("print_interval:calloc()");
+	exit(EXIT_FAILURE);
+    }
+    phist = hist + HIST_NBUCKET;
+    memset(&tot, 0, sizeof(tot));
+    memset(&ptot, 0, sizeof(ptot));
+
+    printf("%9.3f [s]\n", NSEC2DOUBLE(coord_clock() - iotcoord.t0));
+    printf("  %-24s %12s %10s %10s %10s %10s\n",
+	   "", "[IO/s]", "[MB/s]", "avg [ms]", "99% [ms]", "max [ms]");
+    for(i=0; i<iotcoord.nw; i++){
+	struct iotcoord_worker_t *w = &(iotcoord.w[i]);
+
+	if(w->state != WORKER_RUNNING && w->state != WORKER_DONE)
+	    continue;
+	/* Each iotest is timed by itself; its rates add up to the total. */
+	if((elapsed = NSEC2DOUBLE(w->cur.ts - w->prev.ts)) > 0){
+	    print_row(w->hello.tot.name, &(w->cur.tot), &(w->prev.tot), elapsed, w->hist, w->phist);
+	    printf("\n");
+	    rio += (w->cur.tot.nio - w->prev.tot.nio) / elapsed;
+	    rbyte += (w->cur.tot.nbyte - w->prev.tot.nbyte) / elapsed;
+	}
+	tot.nio += w->cur.tot.nio;
+	tot.acciotim += w->cur.tot.acciotim;
+	if(tot.mxiotim < w->cur.tot.mxiotim)
+	    tot.mxiotim = w->cur.tot.mxiotim;
+	ptot.nio += w->prev.tot.nio;
+	ptot.acciotim += w->prev.tot.acciotim;
+	for(k=0; k<HIST_NBUCKET; k++){
+	    hist[k] += w->hist[k];
+	    phist[k] += w->phist[k];
+	}
+	w->prev = w->cur;
+	memcpy(w->phist, w->hist, sizeof(w->hist));
+    }
+
+    printf("  %-24.24s %12.3f %10.3f %10.6f %10.6f %10.6f\n",
+	   "total", rio, rbyte / MEGA,
+	   tot.nio > ptot.nio ? NSEC2MSEC(tot.acciotim - ptot.acciotim) / (tot.nio - ptot.nio) : 0.0,
+	   NSEC2MSEC(iotest_hist_percentile(hist, phist, 99)), NSEC2MSEC(tot.mxiotim));
+    fflush(stdout);
+
+    free(hist);
+}
+
+/*
+ * print_result(): prints the result of each iotest over its run, their
+ * total over the span of all of them, and how far apart they started
+ */
+
+static void print_result(void)
+{
+    struct iotest_stat_ent_t tot, zero;
+    uint64_t *hist;
+    uint64_t ts0 = 0, ts1 = 0, go0 = 0, go1 = 0;
+    int i, k, n = 0, nlost = 0;
+
+    if((hist = (uint64_t *)calloc(HIST_NBUCKET, sizeof(uint64_t))) == NULL){
+	perror("print_result:calloc()");
+	exit(EXIT_FAILURE);
+    }
+    memset(&tot, 0, sizeof(tot));
+    memset(&zero, 0, sizeof(zero));
+
+    printf("Result:\n");
+    printf("  %-24s %12s %10s %10s %10s %10s %12s\n",
+	   "", "[IO/s]", "[MB/s]", "avg [ms]", "99% [ms]", "max [ms]", "start [us]");
+    for(i=0; i<iotcoord.nw; i++){
+	struct iotcoord_worker_t *w = &(iotcoord.w[i]);
+	struct iotest_coord_msg_t *m = &(w->cur);
+
+	if(w->state != WORKER_DONE){
+	    printf("  %-24.24s %12s\n", w->hello.tot.name, "lost");
+	    nlost++;
+	    continue;
+	}
+	if(m->ts1 <= m->ts0 || m->go == 0){
+	    printf("  %-24.24s %12s\n", w->hello.tot.name, "not run");
+	    continue;
+	}
+	print_row(w->hello.tot.name, &(m->tot), &zero, NSEC2DOUBLE(m->ts1 - m->ts0), w->hist, NULL);
+	printf(" %12.3f\n", NSEC2USEC((double)m->go - (double)iotcoord.t0));
+
+	tot.nio += m->tot.nio;
+	tot.nbyte += m->tot.nbyte;
+	tot.acciotim += m->tot.acciotim;
+	if(tot.mxiotim < m->tot.mxiotim)
+	    tot.mxiotim = m->tot.mxiotim;
+	for(k=0; k<HIST_NBUCKET; k++)
+	    hist[k] += w->hist[k];
+	if(n == 0 || m->ts0 < ts0)
+	    ts0 = m->ts0;
+	if(n == 0 || m->ts1 > ts1)
+	    ts1 = m->ts1;
+	if(n == 0 || m->go < go0)
+	    go0 = m->go;
+	if(n == 0 || m->go > go1)
+	    go1 = m->go;
+	n++;
+    }
+    if(n){
+	print_row("total", &tot, &zero, NSEC2DOUBLE(ts1 - ts0), hist, NULL);
+	printf("\n");
+    }
+
+    printf("  %-20s : %d (%d lost)\n", "iotests", iotcoord.nw, nlost);
+    if(n){
+	printf("  %-20s : %.6f [s]\n", "Exec. time", NSEC2DOUBLE(ts1 - ts0));
+	printf("  %-20s : %.3f [us] apart, %.3f [us] after the start time\n", "Start skew",
+	       NSEC2USEC(go1 - go0), NSEC2USEC((double)go1 - (double)iotcoord.t0));
+    }
+
+    free(hist);
+}
+
+/*
+ * print_row(): prints the rates of an entry over a time [s], leaving the
+ * line open
+ */
+
+static void print_row(char *name, struct iotest_stat_ent_t *e, struct iotest_stat_ent_t *pe,
+		      double elapsed, uint64_t *hist, uint64_t *phist)
+{
+    unsigned long long nio = e->nio - pe->nio;
+
+    printf("  %-24.24s %12.3f %10.3f %10.6f %10.6f %10.6f",
+	   name,
+	   (double)nio / elapsed,
+	   (double)(e->nbyte - pe->nbyte) / elapsed / MEGA,
+	   nio ? NSEC2MSEC(e->acciotim - pe->acciotim) / nio : 0.0,
+	   NSEC2MSEC(iotest_hist_percentile(hist, phist, 99)),
+	   NSEC2MSEC(e->mxiotim));
+}
+
+/*
+ * coord_clock(): CLOCK_MONOTONIC_RAW [ns], the clock of the messages
+ */
+
+static uint64_t coord_clock(void)
+{
+    struct timespec ts;
+
+#ifdef CLOCK_MONOTONIC_RAW
+    clock_gettime(CLOCK_MONOTONIC_RAW, &ts);
+#else
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+#endif
+    return((uint64_t)ts.tv_sec * GIGA + ts.tv_nsec);
+}
+
+/*
+ * on_signal(): SIGINT and SIGTERM stop the iotests, which still report
+ */
+
+static void on_signal(int signo)
+{
+    iotcoord.stop_signo = signo;
+}
+
+/* iotcoord.c */
@@ -7,7 +7,7 @@
  * Time-stamp: <2008-05-09 00:52:18 kgoda>
  */
 
-#include "iotest.h"
+#include "iotest_int.h"
 
 /*
  *
@@ -15,6 +15,53 @@
  *
  */
 
+/*
+ * IO event record
+ */
+
+struct iotest_rec_t {
+    unsigned long long ts;          /* issue time [ns] */
+    unsigned long long lat;         /* response time [ns] */
+    unsigned long long ofst;        /* [byte] */
+    unsigned int size;              /* [byte] */
+    unsigned short thr;
+    unsigned char dev;
+    unsigned char op;
+};
+
+/*
+ * Heatmap cell of a device region; cumulative except for the maximum,
+ * which the sampler takes and clears every interval
+ */
+
+struct iotest_heat_t {
+    unsigned long long nio;
+    unsigned long long nbyte;
+    unsigned long long acciotim;    /* [ns] */
+    unsigned long long mxiotim;     /* [ns] */
+};
+
+#define OP_READ  IOTEST_OP_READ
+#define OP_WRITE IOTEST_OP_WRITE
+
+/*
+ * Performance counters of -X
+ */
+
+#define PERF_CYCLES     0
+#define PERF_INSTR      1
+#define PERF_LLC_MISS   2
+#define PERF_BR_MISS    3
+#define PERF_CS         4           /* context switches */
+#define PERF_FAULT      5           /* page faults */
+#define NPERF           6
+
+struct iotest_perf_t {
+    char *name;
+    unsigned int type;
+    unsigned long long config;
+};
+
 /*
  * Thread local variable
  */
@@ -30,48 +77,171 @@ struct iotest_aio_context_t {
     /* libaio io control block */
     struct iocb *iocbs[1];
     
-    /* libaio transfer buffer */
-    char *bufs[1];
-    
     /* libaio event array */
     struct io_event events[1];
     
     /* io flag */
     int is_issued;
 
-    /* Time stamp */
-    struct timeval tv[2]; /* [0]:start, [1]:end */
+    /* Ongoing io */
+    struct iotest_io_t *io;
+
+};
+
+/*
+ * Engine: an io given to the engine, with what iotest keeps of it
+ */
 
+struct iotest_slot_t {
+    struct iotest_io_t io;
+    int devid;
+    int is_measured;
+    int is_first;                   /* among the first ios of a burst */
+    unsigned long long ts;          /* issue time [ns] */
 };
 
 struct iotest_thr_t {
 
     /* Thread index (pointing array index of iotest.child) */
     int id;
+
+    /* Context, and whether the thread passed the start barrier */
+    struct iotest_t *ctx;
+    int is_started;
     
     /* Thread id (pthread implementation) */
     pthread_t thr_id;
 
-    /* Aio context array */
-    struct iotest_aio_context_t *acs;
+    /* Process id (-m) */
+    pid_t pid;
+
+    /* State of rand_r(), from iotest_seed() */
+    unsigned int seed;
+
+    /* Engine state per engine, and the ios given to engines with their
+       buffers, free ones stacked in slot_free; kept over the runs of a
+       sweep */
+    void **eng_data;
+    struct iotest_slot_t *slot;
+    char *slot_buf;
+    int *slot_free;
+    struct iotest_io_t **reaped;
     
-    /* Time stamp */
-    struct timeval tv[2]; /* [0]:start, [1]:end */
+    /* Time stamp [ns] */
+    unsigned long long ts[2]; /* [0]:start, [1]:end */
 
-    /* Accumulated IO time */
-    double acciotim;
+    /* Accumulated IO time [ns] */
+    unsigned long long acciotim;
     
-    /* Maximum IO response time */
-    double mxiotim;
+    /* Maximum IO response time [ns] */
+    unsigned long long mxiotim;
     
     /* Number of IOs */
-    double nio;
+    unsigned long long nio;
+
+    /* Number of bytes transferred */
+    unsigned long long nbyte;
+
+    /* Number of IOs including warm-up ones (read by steady state detection) */
+    volatile unsigned long long ndone;
+
+    /* User and system time [ns] of the run, and at its start */
+    unsigned long long cpu[2];
+    unsigned long long cpu0[2];
+
+    /* IO response time histogram */
+    struct iotest_hist_t hist;
+
+    /* Page cache residency samples of buffered reads [page] */
+    unsigned long long ncache_sample;
+    unsigned long long ncache_hit;
+
+    /* IO event ring and number of records ever made */
+    struct iotest_rec_t *rec;
+    unsigned long long nrec;
+
+    /* Heatmap cells, ndev x heat_nregion */
+    struct iotest_heat_t *heat;
+
+    /* Role in composite workload, its block size and rate [IO/s] */
+    int role;
+    int blksiz;
+    int rate;
+
+    /* Composite workload: reads while a checkpoint is being written */
+    struct iotest_hist_t ckpt_hist;
+    unsigned long long nburst;
+    unsigned long long burstim;     /* [ns] */
+
+    /* On/off bursts (-B): bursts issued, and the first ios of them */
+    unsigned long long nonoff;
+    unsigned long long first_nio;
+    unsigned long long first_acciotim;      /* [ns] */
+    unsigned long long first_mxiotim;       /* [ns] */
+    struct iotest_hist_t first_hist;
+
+    /* Pipeline mode: io_submit() calls and stalls of a submitter, and
+       wake-ups of a completer */
+    unsigned long long nbatch;
+    unsigned long long nstall;
+    unsigned long long nwake;
+
+    /* Metadata mode: response time of each operation, NMETA of them */
+    struct iotest_hist_t *meta_hist;
+
+    /* Performance counters of the run (-X), and their file descriptors,
+       private to the thread */
+    unsigned long long perf[NPERF];
+    int perf_fd[NPERF];
+
+    /* Log mode: commits and syncs, and their response time */
+    unsigned long long ncommit;
+    unsigned long long nsync;
+    struct iotest_hist_t commit_hist;
+    struct iotest_hist_t sync_hist;
     
     /* Buffer */
     char *buf;
 
 };
 
+/*
+ * Pipeline mode: a submitter owns an aio context whose completions are
+ * signalled by an eventfd to a completer, and the completer returns the
+ * slots through a single-producer single-consumer ring
+ */
+
+struct iotest_pipe_slot_t {
+    int devid;
+    int is_measured;
+    unsigned long long ts;          /* issue time [ns] */
+};
+
+struct iotest_pipe_t {
+
+    /* Aio context and its eventfd */
+    io_context_t ctx;
+    int efd;
+
+    /* Io control blocks, buffers and their slots, -A of each */
+    struct iocb *iocbs;
+    struct iocb **batch;
+    char *bufs;
+    struct iotest_pipe_slot_t *slot;
+
+    /* Ring of free slots; head is advanced by the submitter, tail by the
+       completer, each on its own cache line */
+    int *ring;
+    unsigned int mask;
+    volatile unsigned long long head;
+    char pad0[64];
+    volatile unsigned long long tail;
+    char pad1[64];
+
+    /* All the ios of the submitter completed */
+    volatile int is_done;
+};
+
 /*
  * Application global variable
  */
@@ -81,17 +251,132 @@ struct iotest_dev_t {
    /* Device or file */
     char *fname;
     
-    /* File descriptor */
-    int fd;
-    
-    /* Accumulated IO time */
-    double acciotim;
+    /* Accumulated IO time [ns] */
+    unsigned long long acciotim;
     
-    /* Maximum IO response time */
-    double mxiotim;
+    /* Maximum IO response time [ns] */
+    unsigned long long mxiotim;
     
     /* Number of IOs */
-    double nio;    
+    unsigned long long nio;    
+
+    /* Number of bytes transferred */
+    unsigned long long nbyte;
+
+    /* Log mode: next append position (in blocks, from ofst0) */
+    unsigned long long lsn;
+
+    /* Capabilities from the profile (-I), or -1 if unknown */
+    int dio_align;                  /* [byte] of offsets and sizes; 0: no O_DIRECT */
+    int dio_mem_align;              /* [byte] */
+    int numa_node;
+    int nr_requests;
+
+    /* Log mode: group commit */
+    pthread_mutex_t mtx;
+    pthread_cond_t cond;
+    int is_syncing;
+    unsigned long long sync_started;
+    unsigned long long sync_done;
+};
+
+/*
+ * Constants
+ */
+
+#define MAX_NTHR 4096
+#define MAX_NDEV 64
+#define MAX_NAIO 4096
+
+#define MAX_NENGINE 16
+
+#define ENGINE_SYNC     0
+#define ENGINE_NULL     1
+#define ENGINE_LIBAIO   2
+#define ENGINE_AIORING  3
+
+#define MAX_NSWEEP 64
+#define MAX_NPOINT 1024
+
+#define NTRIAL_STAT 7               /* IO/s, MB/s, avg., 3 percentiles, max. */
+
+#define ROLE_LOG   0
+#define ROLE_READ  1
+#define ROLE_CKPT  2
+#define NROLE      3
+
+#define COPY_RW         0           /* pread and pwrite */
+#define COPY_SPLICE     1           /* splice through a pipe */
+#define COPY_CFR        2           /* copy_file_range */
+#define NCOPY           3
+
+#define META_CREATE     0           /* open(O_CREAT | O_EXCL) and close */
+#define META_OPEN       1           /* open and close */
+#define META_WRITE      2           /* open(O_TRUNC), write and close */
+#define META_FSYNC      3           /* open(O_TRUNC), write, fsync and close */
+#define META_STAT       4
+#define META_RENAME     5           /* to a free name, maybe in another directory */
+#define META_UNLINK     6
+#define NMETA           7
+
+#define META_FILES      1024        /* [file/thread] */
+#define META_DIRS       16          /* [dir/thread] */
+#define META_SIZE       4096        /* [byte] */
+#define META_FILL       50          /* [%] */
+
+struct iotest_point_t {
+
+    /* Parameters */
+    int nthr;
+    int naio;
+    int blksiz;
+
+    /* Result */
+    unsigned long long nio;
+    unsigned long long nbyte;
+    unsigned long long elapsed;     /* [ns] */
+    unsigned long long acciotim;    /* [ns] */
+    unsigned long long mxiotim;     /* [ns] */
+    unsigned long long pctl[3];     /* [ns] 50, 99 and 99.9 percentiles */
+    unsigned long long ndone;       /* including warm-up ios */
+    unsigned long long cpu;         /* [ns] user and system time */
+};
+
+/*
+ * State shared among main and workers; mapped shared so that worker
+ * processes (-m) see it as well as threads
+ */
+
+struct iotest_shm_t {
+
+    /* Start barrier of workers and main */
+    pthread_barrier_t barrier;
+
+    /* Measurement began (after warm-up) */
+    volatile int is_measuring;
+
+    /* End of the run */
+    volatile int is_stopping;
+
+    /* Number of checkpoint bursts in progress */
+    volatile int ckpt_active;
+
+    /* Workers waiting at the start barrier */
+    volatile int nready;
+};
+
+/*
+ * Helper thread calling a function on a fixed schedule during a run
+ */
+
+struct iotest_tick_t {
+    struct iotest_t *ctx;
+    pthread_t thr;
+    pthread_mutex_t mtx;
+    pthread_cond_t cond;
+    int quit;
+    int ms;
+    void (*fn)(void);
 };
 
 struct iotest_t {
@@ -106,7 +391,7 @@ struct iotest_t {
     /* I/O configuration */
     int blksiz;
     unsigned long ofst0, ofst1;
-    int nio;
+    unsigned long long nio;         /* [block/thread], or NIO_INF */
 
     /* General configuration */
     int verbose;
@@ -119,25 +404,313 @@ struct iotest_t {
     /* Number of aio contexts */
     int naio;
 
-    /* Time stamp */
-    struct timeval tv[2]; /* [0]:start, [1]:end */
+    /* Engine (index of iotest_engine), or -1 for sync, or libaio with -A */
+    int engine;
+    int aio_batch;                  /* ios per io_submit() of aioring */
+
+    /* Upper bounds of resources over the run(s) */
+    int mxnthr;
+    int mxnaio;
+    int mxblksiz;
+
+    /* Access range derived from device size, if not given */
+    unsigned long long devsiz;
+    int is_auto_ofst1;
+    int is_auto_nio;
+
+    /* Sweep */
+    int sweep;
+    int knee;                       /* [%] of peak throughput */
+    int nsw_nthr, nsw_naio, nsw_blksiz;
+    int sw_nthr[MAX_NSWEEP];
+    int sw_naio[MAX_NSWEEP];
+    int sw_blksiz[MAX_NSWEEP];
+    int npoint;
+    struct iotest_point_t point[MAX_NPOINT];
+
+    /* Repeated trials, each a point */
+    int trial_n;
+    int trial_cool;                 /* [s] */
+
+    /* Log mode */
+    int log;                        /* LOG_NONE, LOG_FSYNC, ... */
+    int log_n;                      /* sync every n appends */
+    int log_us;                     /* sync every t [us] */
+    int log_group;
+
+    /* Composite workload; [ROLE_*][0]: threads, [1]: block size, [2]: rate */
+    int is_oltp;
+    int oltp[NROLE][3];
+    int ckpt_period;                /* [ms] */
+    int ckpt_pages;
+
+    /* Copy mode; methods to compare (bit of COPY_*), the one running,
+       and the result of each */
+    int copy;
+    int copy_method;
+    struct iotest_point_t copy_point[NCOPY];
+
+    /* Metadata mode; weights of the operations (META_*), files and
+       directories of the tree of each thread, and size of writes */
+    int meta;
+    int meta_mix[NMETA];
+    int meta_files;
+    int meta_dirs;
+    int meta_size;                  /* [byte] */
+    int meta_fill;                  /* [%] of files made before the run */
+    int meta_keep;
+
+    /* Pipeline mode; submitters and completers of -M, and their ratio */
+    int pipe_s, pipe_c;
+    int pipe_nsub, pipe_ncomp;
+    struct iotest_pipe_t *pipe;
+
+    /* Page cache control */
+    int cache_drop;                 /* CACHE_DROP_* */
+    int cache_advice;               /* POSIX_FADV_*, or -1 */
+    int cache_ra;                   /* readahead [KiB], or -1 */
+    int cache_hit;                  /* samples every n-th read, or 0 */
+    char **cache_map;               /* mapping of each device for mincore() */
+    unsigned long long *cache_mapsiz;
+    unsigned long long cache_pgsiz;  /* page size of mincore() */
+    int *cache_ra_saved;            /* readahead before the run [KiB] */
+    double cache_resident;          /* [%] of the access range before the run */
+
+    /* Live statistics */
+    char *stat_name;
+    int stat_int;                   /* [ms] */
+    int nrun;
+    struct iotest_stat_hdr_t *stat;
+    pthread_t stat_thr;
+    volatile int stat_quit;
+
+    /* IO event log */
+    int rec_size;                   /* [records/thread], power of two */
+    unsigned long long rec_thresh;  /* [ns] */
+    char *rec_file;
+    unsigned long long rt0;         /* CLOCK_REALTIME - iotest_now() [ns] */
+
+    /* Heatmap; sums of the cells of all threads at each sample */
+    int heat_nregion;
+    int heat_int;                   /* [ms] */
+    char *heat_file;
+    struct iotest_heat_t *heat;     /* heat_nsnap x ndev x heat_nregion */
+    unsigned long long *heat_ts;    /* [ns] */
+    int heat_nsnap, heat_mxsnap;
+    struct iotest_tick_t heat_tick;
+
+    /* Checkpoint of the results (-K) */
+    char *chk_file;
+    int chk_int;                    /* [s] */
+    struct iotest_tick_t chk_tick;
+
+    /* Coordinator (-z); Unix domain socket or TCP port on loopback */
+    char *coord_path;
+    int coord_port;
+    char *coord_name;
+    int coord_fd;
+    int coord_int;                  /* [ms], given by the coordinator */
+    unsigned long long coord_go;    /* release, CLOCK_MONOTONIC_RAW [ns] */
+    uint64_t *coord_hist;
+    struct iotest_tick_t coord_tick;
+
+    /* Performance counters (-X); those which can be opened (bit of
+       PERF_*), and whether kernel space is excluded from them */
+    int is_perf;
+    int perf_mask;
+    int perf_user;
+
+    /* Signal which stopped the run, if any */
+    volatile int stop_signo;
+
+    /* Prepare phase */
+    int prep;                       /* PREP_NONE, PREP_ALLOC, ... */
+    unsigned long long prep_size;   /* [byte] given by size=, or 0 */
+    int prep_chunk;                 /* [byte] */
+    volatile unsigned long long prep_next;
+    volatile unsigned long long prep_done;
+    unsigned long long prep_total;
+    unsigned long long *prep_devsiz;    /* [byte] of each device */
+    unsigned long long *prep_first;     /* first chunk of each device, and total */
+    int prep_pass;
+    int prep_id;                    /* next id of the threads */
+    int *prep_fd;                   /* O_DIRECT where possible */
+    int *prep_bfd;                  /* buffered, for unaligned writes */
+
+    /* Duration [s] */
+    int duration;
+
+    /* Worker processes instead of threads */
+    int is_proc;
+
+    /* File descriptors of devices, private to each process */
+    int *fd;
+
+    /* State shared with workers */
+    struct iotest_shm_t *shm;
+
+    /* Traffic shaping: think time after a completion (-k), and on/off
+       bursts (-B) */
+    int think;                      /* DIST_* */
+    double think_a, think_b;        /* [us] or shape */
+    int onoff_n;                    /* [io] per burst */
+    int onoff_idle;                 /* [ms] */
+    int onoff_dist;                 /* DIST_CONST or DIST_EXP */
+    int onoff_first;                /* [io] reported separately */
+
+    /* Steady state detection */
+    int is_steady;
+    int steady_cv;                  /* [%] */
+    int steady_win;                 /* [samples] */
+    int steady_int;                 /* [ms] */
+    int steady_max;                 /* [s] */
+    unsigned long long warmup;      /* [ns] */
+
+    /* Capability profile of the host (-I), or -1 if unknown */
+    char *prof_file;
+    int prof_tsc;                   /* invariant TSC */
+    int prof_ncpu;
+    int prof_io_uring;
+    long long prof_aio;             /* aio-max-nr less aio-nr [event] */
+
+    /* Seed of the random numbers (-x), or 0 for the time */
+    unsigned int seed;
+
+    /* Timer */
+    int timer;
+    int is_timer_set;
+    unsigned long long timer_ovh;   /* [ns] cost of one timer read */
+    unsigned long long tsc_base;    /* TSC value at calibration */
+    unsigned long long tsc_nsec;    /* clock value at calibration [ns] */
+    unsigned long long tsc_mult;    /* ns per tick, 32bit fixed point */
+
+    /* Time stamp [ns] */
+    unsigned long long ts[2]; /* [0]:start, [1]:end */
+
+    /* Library: the options, the caller of the API where errors unwind to,
+       and the state of the context */
+    int argc;
+    char **argv;
+    pthread_t caller;
+    pid_t pid;
+    jmp_buf jmp;
+    int status;
+    volatile int error;
+    int is_setup;
+    int is_run;
     
-} iotest;
+};
+
+/*
+ * The context. The command has a static one; in the library, the API and
+ * every thread of iotest set that of the calling thread.
+ */
+
+#ifdef IOTEST_LIBRARY
+static __thread struct iotest_t *iotest_cur;
+static __thread struct iotest_thr_t *iotest_worker;
+static __thread int iotest_is_helper;
+#define iotest (*iotest_cur)
+#define IOTEST_ENTER(ctx) (iotest_cur = (ctx))
+#define IOTEST_HELPER() (iotest_is_helper = 1)
+#define IOTEST_WORKER(thr) (iotest_worker = (thr))
+#else
+struct iotest_t iotest;
+static struct iotest_thr_t *iotest_worker;  /* of a worker process (-m) */
+#define IOTEST_ENTER(ctx) ((void)(ctx))
+#define IOTEST_HELPER() ((void)0)
+#define IOTEST_WORKER(thr) ((void)(thr))
+#endif
+
+/* The first perror() of glibc may reset errno, which the library returns. */
+#ifdef IOTEST_LIBRARY
+static inline void iotest_perror(const char *s)
+{
+    int e = errno;
+    perror(s);
+    errno = e;
+}
+#define perror(s) iotest_perror(s)
+#endif
+
+/* Errors of the calling thread unwind to here (see iotest_exit()). */
+#define IOTEST_TRY()                                            \
+    do{                                                         \
+	iotest.caller = pthread_self();                         \
+	iotest.pid = getpid();                                  \
+	if(setjmp(iotest.jmp))                                  \
+	    return(iotest.status == EXIT_SUCCESS ? 0 : (errno = iotest.error, -1)); \
+    }while(0)
 
 /*
  * Constants
  */
 
-#define MAX_NTHR 4096
-#define MAX_NDEV 64
-#define MAX_NAIO 4096
+#define SWEEP_NONE      0
+#define SWEEP_GRID      1
+#define SWEEP_ADAPT     2
+
+#define SWEEP_KNEE      95          /* [%] */
+#define SWEEP_PLATEAU   2           /* [%] gain regarded as saturated */
+#define SWEEP_NSTEP     16          /* doublings of threads up to MAX_NTHR */
+
+#define LOG_NONE        0
+#define LOG_FSYNC       1
+#define LOG_FDATASYNC   2
+#define LOG_SFR         3
+
+#define OLTP_LOG_BLKSIZ   4096
+#define OLTP_READ_NTHR    8
+#define OLTP_READ_BLKSIZ  8192
+#define OLTP_CKPT_PERIOD  1000      /* [ms] */
+#define OLTP_CKPT_PAGES   256
+
+#define PREP_NONE       0
+#define PREP_ALLOC      1           /* create and fallocate */
+#define PREP_FILL       2           /* and sequential fill */
+#define PREP_FULL       3           /* and random overwrite */
+
+#define PREP_CHUNK      (MEBI)
+#define PREP_ALIGN      4096        /* writes through O_DIRECT [byte] */
+#define PREP_PASS_FILL  0
+#define PREP_PASS_RAND  1
+
+#define CACHE_DROP_NONE 0
+#define CACHE_DROP_FILE 1           /* fadvise(DONTNEED) per file */
+#define CACHE_DROP_ALL  2           /* and /proc/sys/vm/drop_caches */
+
+#define STAT_INT        1000        /* [ms] */
+
+#define DIST_NONE       0
+#define DIST_CONST      1
+#define DIST_EXP        2
+#define DIST_UNIFORM    3
+#define DIST_PARETO     4
+
+#define ONOFF_FIRST     8           /* [io] */
+#define SPIN_NS         50000       /* waits shorter than this are spun [ns] */
+#define DURATION_POLL   (100*MEGA)  /* stop requests are noticed within [ns] */
+#define THINK_POLL      50000       /* completions during think time are reaped within [ns] */
+
+#define NIO_INF         ULLONG_MAX  /* -D without -c */
+
+#define REC_SIZE        65536       /* [records/thread] */
+
+#define CHK_INT         60          /* [s] */
+
+#define HEAT_NREGION    64
+#define HEAT_INT        1000        /* [ms] */
+#define MAX_NREGION     4096
+
+#define STEADY_CV       5           /* [%] */
+#define STEADY_WIN      5           /* [samples] */
+#define STEADY_INT      200         /* [ms] */
+#define STEADY_MAX      60          /* [s] */
 
-#define KILO     (1000)
-#define MEGA     (KILO*KILO)
-#define GIGA     (KILO*KILO*KILO)
-#define KIBI     (1024)
-#define MEBI     (KIBI*KIBI)
-#define GIBI     (KIBI*KIBI*KIBI)
+#define TIMER_MONOTONIC 0
+#define TIMER_TSC       1
+
+#define TIMER_NSAMPLE   1000
 
 #define MODE_RANDOM     1
 #define MODE_SEQUENTIAL 2
@@ -156,7 +729,7 @@ struct iotest_t {
 #define IS_MULTIPLE    (!IS_SINGLE)
 
 
-#define IS_NONOP      (0)
+#define IS_NONOP      (iotest.is_nonop)
 
 #define VERBOSE       (iotest.verbose)
 #define VERBOSE1      (VERBOSE >= 1)
@@ -173,7 +746,94 @@ struct iotest_t {
 
 static void *thread_handler(void *);
 static void disktest(int);
-static void disktest_libaio(int);
+static int engine_of_run(void);
+static int engine_find(char *);
+static void engine_attach(struct iotest_thr_t *, int);
+static void engine_detach(struct iotest_thr_t *);
+static void engine_fail(int, char *);
+static int sync_setup(void **, int);
+static int sync_submit(void *, struct iotest_io_t *);
+static int sync_reap(void *, struct iotest_io_t **, int, int);
+static void sync_teardown(void *);
+static int null_setup(void **, int);
+static int null_submit(void *, struct iotest_io_t *);
+static int null_reap(void *, struct iotest_io_t **, int, int);
+static void null_teardown(void *);
+#ifdef __linux__
+static int libaio_setup(void **, int);
+static int libaio_submit(void *, struct iotest_io_t *);
+static int libaio_reap(void *, struct iotest_io_t **, int, int);
+static void libaio_teardown(void *);
+static int aioring_setup(void **, int);
+static int aioring_submit(void *, struct iotest_io_t *);
+static int aioring_flush(void *);
+static int aioring_reap(void *, struct iotest_io_t **, int, int);
+static void aioring_teardown(void *);
+#endif
+static void pipe_setup(void);
+static void pipe_teardown(void);
+static void pipe_submit(int);
+static void pipe_complete(int);
+static void logtest(int);
+static void oltp_read(int);
+static void copytest(int);
+static void metatest(int);
+static void meta_path(char *, int);
+static int copy_chunk(int, int, int *, unsigned long long, int);
+static void copy(void);
+static void trial(void);
+static void oltp_ckpt(int);
+static void log_commit(struct iotest_thr_t *, int, unsigned long long, unsigned long long);
+static void log_sync(struct iotest_thr_t *, int, unsigned long long, unsigned long long);
+
+static void prepare(void);
+static void prepare_pass(int);
+static void *prepare_handler(void *);
+static unsigned long long parse_size(char *);
+
+static void open_devices(void);
+static void cache_setup(void);
+static void cache_restore(void);
+static void cache_evict(void);
+static double cache_residency(void);
+static int cache_ra(int, int);
+static void stat_open(void);
+static void stat_close(void);
+static void stat_unlink(void);
+static void coord_open(void);
+static void coord_close(void);
+static void coord_start(void);
+static void coord_stat(void);
+static int coord_send(int);
+static int coord_recv(struct iotest_coord_msg_t *, int);
+static void coord_lost(void);
+static int coord_write(void *, size_t);
+static void *stat_publisher(void *);
+static void stat_publish(void);
+static void iotest_exit(int);
+#ifndef IOTEST_LIBRARY
+static void on_signal(int);
+#endif
+static void parse_options(int, char **);
+static void check_options(void);
+static void prof_load(void);
+static void prof_check(void);
+static void setup(void);
+static void cleanup(void);
+static void *shm_alloc(size_t);
+static void shm_free(void *, size_t);
+static void run_worker_proc(struct iotest_thr_t *);
+
+static void run_test(void);
+static void steady_state(void);
+static void reset_result(void);
+static void sweep(void);
+static void sweep_adapt(int, int);
+static double sweep_point(int, int, int);
+static struct iotest_point_t *sweep_knee(int, double *);
+static void point_record(struct iotest_point_t *);
+static void point_result(struct iotest_point_t *, struct iotest_result_t *);
+static int parse_list(int, char *, int *, int, int);
 
 static void print_version(void);
 static void print_usage(void);
@@ -181,8 +841,69 @@ static void print_config(void);
 static void print_result(void);
 static void print_result_child(int);
 static void print_result_dev(int);
+static void print_result_sweep(void);
+static void print_result_trial(void);
+static double median(double *, int);
+static int cmp_double(const void *, const void *);
+static void print_result_log(void);
+static void print_result_oltp(void);
+static void print_result_copy(void);
+static void print_result_meta(void);
+static void dump_events(void);
+static void heat_start(void);
+static void heat_stop(void);
+static void chk_write(void);
+static void chk_save(int);
+static void tick_start(struct iotest_tick_t *, int, void (*)(void));
+static void tick_stop(struct iotest_tick_t *);
+static void *tick_handler(void *);
+static void heat_sample(void);
+static void dump_heat(void);
+static int cmp_rec(const void *, const void *);
+static void print_hist(char *, struct iotest_hist_t *, unsigned long long);
+static void perf_probe(void);
+static int perf_open(int);
+static void perf_start(struct iotest_thr_t *);
+static void perf_stop(struct iotest_thr_t *);
 static unsigned long long getsize(char *);
+static void timer_init(void);
+
+/*
+ * Engines, selected by -i; the library may register more
+ */
+
+static struct iotest_engine_t iotest_engine[MAX_NENGINE] = {
+    { "sync", "pread and pwrite", 0,
+      sync_setup, sync_submit, sync_reap, sync_teardown },
+    { "null", "no I/O, completing at the next reap", 1,
+      null_setup, null_submit, null_reap, null_teardown },
+#ifdef __linux__
+    { "libaio", "Linux native aio, a context per io in flight", 1,
+      libaio_setup, libaio_submit, libaio_reap, libaio_teardown },
+    { "aioring", "Linux native aio, a context per thread reaped from its ring", 1,
+      aioring_setup, aioring_submit, aioring_reap, aioring_teardown },
+#endif
+};
+#ifdef __linux__
+static int iotest_nengine = 4;
+#else
+static int iotest_nengine = 2;
+#endif
+
+#ifdef __linux__
+static struct iotest_perf_t iotest_perf[NPERF] = {
+    { "cycles", PERF_TYPE_HARDWARE, PERF_COUNT_HW_CPU_CYCLES },
+    { "instructions", PERF_TYPE_HARDWARE, PERF_COUNT_HW_INSTRUCTIONS },
+    { "LLC misses", PERF_TYPE_HARDWARE, PERF_COUNT_HW_CACHE_MISSES },
+    { "branch misses", PERF_TYPE_HARDWARE, PERF_COUNT_HW_BRANCH_MISSES },
+    { "context switches", PERF_TYPE_SOFTWARE, PERF_COUNT_SW_CONTEXT_SWITCHES },
+    { "page faults", PERF_TYPE_SOFTWARE, PERF_COUNT_SW_PAGE_FAULTS },
+};
+#endif
 
+static char *meta_name[NMETA] = {
+    "Create", "Open", "Write", "Fsync", "Stat", "Rename", "Unlink"
+};
 
 /*
  *
@@ -190,18 +911,328 @@ static unsigned long long getsize(char *);
  *
  */
 
-#define TIMEVAL_SUB(dest, base)             \
-{                                           \
-    (dest).tv_usec -= (base).tv_usec;       \
-    (dest).tv_sec  -= (base).tv_sec;        \
-    while((dest).tv_usec < 0){              \
-        (dest).tv_usec += MEGA;             \
-        (dest).tv_sec--;                    \
-    }                                       \
+/*
+ * iotest_now(): monotonic time stamp in nanoseconds
+ */
+
+#if defined(__x86_64__) || defined(__i386__)
+static inline unsigned long long iotest_rdtsc(void)
+{
+    unsigned int aux;
+
+    return(__rdtscp(&aux));
+}
+
+/* (a * b) >> 32 in 64 bits; i386 has no 128-bit integer type */
+static inline unsigned long long iotest_mulshift(unsigned long long a, unsigned long long b)
+{
+#ifdef __SIZEOF_INT128__
+    return((unsigned long long)(((unsigned __int128)a * b) >> 32));
+#else
+    unsigned long long ah = a >> 32, al = a & 0xffffffffULL;
+    unsigned long long bh = b >> 32, bl = b & 0xffffffffULL;
+
+    return(((ah * bh) << 32) + ah * bl + al * bh + ((al * bl) >> 32));
+#endif
+}
+#endif
+
+static inline unsigned long long iotest_clock(void)
+{
+    struct timespec ts;
+
+#ifdef CLOCK_MONOTONIC_RAW
+    clock_gettime(CLOCK_MONOTONIC_RAW, &ts);
+#else
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+#endif
+    return((unsigned long long)ts.tv_sec * GIGA + ts.tv_nsec);
+}
+
+static inline unsigned long long iotest_now(void)
+{
+#if defined(__x86_64__) || defined(__i386__)
+    if(iotest.timer == TIMER_TSC)
+	return(iotest.tsc_nsec + iotest_mulshift(iotest_rdtsc() - iotest.tsc_base, iotest.tsc_mult));
+#endif
+    return(iotest_clock());
+}
+
+/*
+ * hist_add(): adds a sample [ns] to a histogram
+ */
+
+static inline void hist_add(struct iotest_hist_t *h, unsigned long long v)
+{
+    h->cnt[iotest_hist_index(v)]++;
+}
+
+static inline void hist_merge(struct iotest_hist_t *dst, struct iotest_hist_t *src)
+{
+    int i;
+
+    for(i=0; i<HIST_NBUCKET; i++)
+	dst->cnt[i] += src->cnt[i];
+}
+
+/*
+ * iotest_pace(): sleeps until the next issue time of a rate-limited stream
+ */
+
+static inline void iotest_pace(unsigned long long *next, int rate)
+{
+    unsigned long long now;
+
+    if(!rate)
+	return;
+
+    now = iotest_now();
+    if(*next == 0)
+	*next = now;
+    if(*next > now){
+	struct timespec req;
+	req.tv_sec = (*next - now) / GIGA;
+	req.tv_nsec = (*next - now) % GIGA;
+	nanosleep(&req, NULL);
+    }
+    *next += GIGA / rate;
+}
+
+/*
+ * iotest_dist(): a sample [ns] of a distribution given in us; pareto is
+ * given by its mean and shape
+ */
+
+static inline unsigned long long iotest_dist(struct iotest_thr_t *thr, int dist, double a, double b)
+{
+    double u = rand_r(&(thr->seed)) / (RAND_MAX + 1.0), us;
+
+    switch(dist){
+    case DIST_CONST:
+	us = a;
+	break;
+    case DIST_EXP:
+	us = - a * log(1 - u);
+	break;
+    case DIST_UNIFORM:
+	us = a + (b - a) * u;
+	break;
+    case DIST_PARETO:
+	us = a * (b - 1) / b / pow(1 - u, 1 / b);
+	break;
+    default:
+	us = 0;
+    }
+    return((unsigned long long)(us * KILO));
+}
+
+/*
+ * iotest_seed(): seed of the random numbers of a thread
+ */
+
+static inline unsigned int iotest_seed(int id)
+{
+    return((iotest.seed ? iotest.seed : (unsigned int)time(0)) + id * 13);
+}
+
+/*
+ * iotest_wait_until(): sleeps until a time [ns], spinning the last part
+ * for precision
+ */
+
+static inline void iotest_wait_until(unsigned long long t)
+{
+    unsigned long long now = iotest_now();
+    struct timespec req;
+
+    if(t > now + SPIN_NS){
+	req.tv_sec = (t - now - SPIN_NS) / GIGA;
+	req.tv_nsec = (t - now - SPIN_NS) % GIGA;
+	nanosleep(&req, NULL);
+    }
+    while(iotest_now() < t && !iotest.shm->is_stopping)
+	;
+}
+
+/*
+ * iotest_wait_slice(): sleeps toward a time [ns] for at most THINK_POLL,
+ * for a thread that has ios to reap meanwhile; the last SPIN_NS is left
+ * to its reaps
+ */
+
+static inline void iotest_wait_slice(unsigned long long t)
+{
+    unsigned long long now = iotest_now();
+    struct timespec req;
+
+    if(t <= now + SPIN_NS)
+	return;
+    t -= now + SPIN_NS;
+    if(t > THINK_POLL)
+	t = THINK_POLL;
+    req.tv_sec = 0;
+    req.tv_nsec = t;
+    nanosleep(&req, NULL);
+}
+
+/*
+ * iotest_rand_ofst(): random offset [byte] aligned to size within the
+ * access range
+ */
+
+static inline unsigned long long iotest_rand_ofst(struct iotest_thr_t *thr, int size)
+{
+    unsigned long long lo = (unsigned long long)iotest.ofst0 * iotest.blksiz;
+    unsigned long long n = ((unsigned long long)iotest.ofst1 * iotest.blksiz - lo) / size;
+
+    return(lo + (unsigned long long)(n * (rand_r(&(thr->seed)) / (RAND_MAX + 1.0))) * size);
+}
+
+/*
+ * iotest_cputime(): user and system time [ns] of the calling thread; the
+ * total is from the thread clock, since the split by getrusage() is
+ * sampled at ticks
+ */
+
+static inline void iotest_cputime(unsigned long long *cpu)
+{
+    struct timespec ts;
+    struct rusage ru;
+    unsigned long long total;
+
+    cpu[0] = cpu[1] = 0;
+    if(clock_gettime(CLOCK_THREAD_CPUTIME_ID, &ts) != 0)
+	return;
+    total = (unsigned long long)ts.tv_sec * GIGA + ts.tv_nsec;
+    if(getrusage(RUSAGE_THREAD, &ru) == 0)
+	cpu[1] = (unsigned long long)ru.ru_stime.tv_sec * GIGA + ru.ru_stime.tv_usec * KILO;
+    if(cpu[1] > total)
+	cpu[1] = total;
+    cpu[0] = total - cpu[1];
+}
+
+/*
+ * iotest_start(): waits at the start barrier with main and the others
+ */
+
+static inline void iotest_start(struct iotest_thr_t *thr)
+{
+    __sync_fetch_and_add(&(iotest.shm->nready), 1);
+    pthread_barrier_wait(&(iotest.shm->barrier));
+    thr->is_started = 1;
+    iotest_cputime(thr->cpu0);
+    if(iotest.perf_mask)
+	perf_start(thr);
+}
+
+/*
+ * iotest_cache_sample(): checks, every cache_hit-th buffered read,
+ * whether the pages to be read are in page cache; nread counts the
+ * reads of the thread so far
+ */
+
+static inline void iotest_cache_sample(struct iotest_thr_t *thr, unsigned long long nread,
+				       int devid, unsigned long long ofst, int size)
+{
+    unsigned char vec[64];
+    unsigned long long pg, a, n, i;
+
+    if(!iotest.cache_hit || nread % iotest.cache_hit)
+	return;
+
+    pg = iotest.cache_pgsiz;
+    a = ofst / pg * pg;
+    if(a >= iotest.cache_mapsiz[devid])
+	return;
+    n = (ofst + size - a + pg - 1) / pg;
+    if(n > sizeof(vec))
+	n = sizeof(vec);
+    if(a + n * pg > iotest.cache_mapsiz[devid])
+	n = (iotest.cache_mapsiz[devid] - a) / pg;
+    if(n == 0 || mincore(iotest.cache_map[devid] + a, n * pg, vec) != 0)
+	return;
+
+    for(i=0; i<n; i++)
+	thr->ncache_hit += vec[i] & 1;
+    thr->ncache_sample += n;
+}
+
+/*
+ * iotest_account(): adds one io of given latency to thread and device stats
+ */
+
+static inline void iotest_account(struct iotest_thr_t *thr, int devid, int op,
+				  unsigned long long ofst, int size,
+				  unsigned long long t0, unsigned long long t1)
+{
+    struct iotest_dev_t *dev = &(iotest.dev[devid]);
+    unsigned long long lat, mx;
+
+    lat = t1 - t0;
+    lat = (lat > iotest.timer_ovh) ? lat - iotest.timer_ovh : 0;
+
+    thr->acciotim += lat;
+    if(thr->mxiotim < lat)
+	thr->mxiotim = lat;
+    thr->nio++;
+    thr->nbyte += size;
+    hist_add(&(thr->hist), lat);
+
+    if(thr->rec && lat >= iotest.rec_thresh){
+	struct iotest_rec_t *r = &(thr->rec[thr->nrec++ & (iotest.rec_size - 1)]);
+	r->ts = t0;
+	r->lat = lat;
+	r->ofst = ofst;
+	r->size = size;
+	r->thr = thr->id;
+	r->dev = devid;
+	r->op = op;
+    }
+
+    if(thr->heat){
+	unsigned long long lo = (unsigned long long)iotest.ofst0 * iotest.blksiz;
+	unsigned long long span = (unsigned long long)(iotest.ofst1 - iotest.ofst0) * iotest.blksiz;
+	int r = ofst > lo ? (int)((double)(ofst - lo) * iotest.heat_nregion / span) : 0;
+	struct iotest_heat_t *c;
+
+	if(r >= iotest.heat_nregion)
+	    r = iotest.heat_nregion - 1;
+	c = &(thr->heat[devid * iotest.heat_nregion + r]);
+	c->nio++;
+	c->nbyte += size;
+	c->acciotim += lat;
+	/* The sampler clears it concurrently. */
+	while((mx = c->mxiotim) < lat)
+	    if(__sync_bool_compare_and_swap(&(c->mxiotim), mx, lat))
+		break;
+    }
+
+    /* Devices are shared among threads. */
+    __sync_fetch_and_add(&(dev->acciotim), lat);
+    while((mx = dev->mxiotim) < lat)
+	if(__sync_bool_compare_and_swap(&(dev->mxiotim), mx, lat))
+	    break;
+    __sync_fetch_and_add(&(dev->nio), 1);
+    __sync_fetch_and_add(&(dev->nbyte), size);
 }
 
-#define TIMEVAL2DOUBLE(a)                   \
-    ((double)(a).tv_sec + (double)(a).tv_usec / (double) MEGA)
+/*
+ * iotest_account_first(): adds one of the first ios of a burst to their
+ * own stats, as well
+ */
+
+static inline void iotest_account_first(struct iotest_thr_t *thr,
+					unsigned long long t0, unsigned long long t1)
+{
+    unsigned long long lat = t1 - t0;
+
+    lat = (lat > iotest.timer_ovh) ? lat - iotest.timer_ovh : 0;
+    thr->first_nio++;
+    thr->first_acciotim += lat;
+    if(thr->first_mxiotim < lat)
+	thr->first_mxiotim = lat;
+    hist_add(&(thr->first_hist), lat);
+}
 
 static inline ssize_t iotest_pread(int fd, void *buf, size_t count, off_t offset)
 {
@@ -214,7 +1245,7 @@ static inline ssize_t iotest_pread(int fd, void *buf, size_t count, off_t offset
     ret = pread(fd, buf, count, offset);
     if(ret < 0){
 	perror("iotest_read:pread()");
-	exit(EXIT_FAILURE);
+	iotest_exit(EXIT_FAILURE);
     }
     if(ret != count){
 	count -= ret;
@@ -240,7 +1271,7 @@ static inline ssize_t iotest_pwrite(int fd, void *buf, size_t count, off_t offse
     ret = pwrite(fd, buf, count, offset);
     if(ret < 0){
 	perror("iotest_write:pwrite()");
-	exit(EXIT_FAILURE);
+	iotest_exit(EXIT_FAILURE);
     }
     if(ret != count){
 	count -= ret;
@@ -274,12 +1305,12 @@ static void iotest_aio_pread_done(io_context_t ctx, struct iocb *iocb, long res,
     if(res < 0){
 	errno = - res;
 	perror("iotest_aio_pread_done:");
-	exit(EXIT_FAILURE);
+	iotest_exit(EXIT_FAILURE);
     }
     
     if(res != iocb->u.c.nbytes){
 	fprintf(stderr, "aio_pread_done: Read operation partially completed. %ld bytes to be read, %ld actually read.\n", iocb->u.c.nbytes, res);
-	exit(EXIT_FAILURE);
+	iotest_exit(EXIT_FAILURE);
     }
     
     return;
@@ -297,12 +1328,12 @@ static void iotest_aio_pwrite_done(io_context_t ctx, struct iocb *iocb, long res
     if(res < 0){
 	errno = - res;
 	perror("iotest_aio_pwrite_done:");
-	exit(EXIT_FAILURE);
+	iotest_exit(EXIT_FAILURE);
     }
     
     if(res != iocb->u.c.nbytes){
 	fprintf(stderr, "iotest_aio_pwrite_done: Write operation partially completed. %ld bytes to be written, %ld actually written.\n", iocb->u.c.nbytes, res);
-	exit(EXIT_FAILURE);
+	iotest_exit(EXIT_FAILURE);
     }
     
     return;
@@ -313,8 +1344,10 @@ static inline int iotest_aio_pread(struct iotest_aio_context_t *ac,
 {
     int ret;
 
-    if(IS_NONOP)
+    if(IS_NONOP){
+	ac->is_issued = 1;
 	return(count);
+    }
 
     io_prep_pread(ac->iocbs[0], fd, buf, count, offset);
     io_set_callback(ac->iocbs[0], iotest_aio_pread_done);
@@ -323,7 +1356,7 @@ static inline int iotest_aio_pread(struct iotest_aio_context_t *ac,
     if(ret != 1){
 	errno = - ret;
 	perror("iotest_aio_pread:io_submit()");
-	exit(EXIT_FAILURE);
+	iotest_exit(EXIT_FAILURE);
     }
     
     if(VERBOSE5)
@@ -340,8 +1373,10 @@ static inline int iotest_aio_pwrite(struct iotest_aio_context_t *ac,
 {
     int ret;
 
-    if(IS_NONOP)
+    if(IS_NONOP){
+	ac->is_issued = 1;
 	return(count);
+    }
 
     io_prep_pwrite(ac->iocbs[0], fd, buf, count, offset);
     io_set_callback(ac->iocbs[0], iotest_aio_pwrite_done);
@@ -350,7 +1385,7 @@ static inline int iotest_aio_pwrite(struct iotest_aio_context_t *ac,
     if(ret != 1){
 	errno = - ret;
 	perror("iotest_aio_pwrite:io_submit()");
-	exit(EXIT_FAILURE);
+	iotest_exit(EXIT_FAILURE);
     }
     
     if(VERBOSE5)
@@ -365,14 +1400,18 @@ static inline int iotest_aio_pwrite(struct iotest_aio_context_t *ac,
 static inline int iotest_aio_return(struct iotest_aio_context_t *ac)
 {
     int ret;
+
+    if(IS_NONOP){
+	ac->is_issued = 0;
+	return(1);
+    }
     
     ret = io_getevents(ac->ctx, 0, 1, ac->events, NULL);
 
-    if(ret){
+    if(ret > 0){
 	struct io_event *ev = ac->events + 0;
 	io_callback_t callback = (io_callback_t)ev->data;
 	callback(ac->ctx, ev->obj, ev->res, ev->res2);
-
 	ac->is_issued = 0;
     }else{
 #if 0
@@ -386,19 +1425,98 @@ static inline int iotest_aio_return(struct iotest_aio_context_t *ac)
 #endif
 
 /*
- *
- * Main
- *
+ * iotest_pipe_pop(), iotest_pipe_push(): takes a free slot from the ring
+ * (submitter), and returns one (completer)
  */
 
-int main(int argc, char **argv)
+static inline int iotest_pipe_pop(struct iotest_pipe_t *p)
 {
-    int i;
-    int opt;
-    
-    /*
-     * Default Settings
-     */
+    int v;
+
+    if(p->head == p->tail)
+	return(-1);
+    __sync_synchronize();
+    v = p->ring[p->head & p->mask];
+    __sync_synchronize();
+    p->head++;
+
+    return(v);
+}
+
+static inline void iotest_pipe_push(struct iotest_pipe_t *p, int v)
+{
+    p->ring[p->tail & p->mask] = v;
+    __sync_synchronize();
+    p->tail++;
+}
+
+/*
+ *
+ * Main
+ *
+ */
+
+#ifndef IOTEST_LIBRARY
+int main(int argc, char **argv)
+{
+    struct iotest_t *ctx;
+    struct sigaction sa;
+
+    if((ctx = iotest_create()) == NULL){
+	perror("main:iotest_create()");
+	exit(EXIT_FAILURE);
+    }
+
+    /* The first SIGINT or SIGTERM stops the run, and the results so far
+       are reported; a second one terminates as usual. */
+    memset(&sa, 0, sizeof(sa));
+    sa.sa_handler = on_signal;
+    sa.sa_flags = SA_RESETHAND;
+    sigemptyset(&(sa.sa_mask));
+    sigaction(SIGINT, &sa, NULL);
+    sigaction(SIGTERM, &sa, NULL);
+    if(iotest_configure(ctx, argc, argv) != 0 || iotest_run(ctx) != 0)
+	exit(EXIT_FAILURE);
+    iotest_report(ctx);
+    iotest_destroy(ctx);
+
+    return(EXIT_SUCCESS);
+}
+
+/*
+ * on_signal(): asks the workers to stop; they see the flag in shared
+ * memory, whichever process gets the signal
+ */
+
+static void on_signal(int signo)
+{
+    iotest.stop_signo = signo;
+    if(iotest.shm)
+	iotest.shm->is_stopping = 1;
+}
+#endif
+
+/*
+ *
+ * Library interface; main above is one of its users
+ *
+ */
+
+/*
+ * iotest_create(): allocates a context with the default settings
+ */
+
+struct iotest_t *iotest_create(void)
+{
+    struct iotest_t *ctx;
+
+#ifdef IOTEST_LIBRARY
+    if((ctx = (struct iotest_t *)calloc(1, sizeof(struct iotest_t))) == NULL)
+	return(NULL);
+#else
+    ctx = &iotest;
+#endif
+    IOTEST_ENTER(ctx);
 
     iotest.mode    = 0;
     iotest.nthr    = 1;
@@ -409,20 +1527,326 @@ int main(int argc, char **argv)
     iotest.nio     = 0;
 
     iotest.verbose = 0;
-    
-    /*
-     * command line
-     */
 
-    /* Options */
+    iotest.timer   = TIMER_MONOTONIC;
+
+    iotest.engine  = -1;
+    iotest.aio_batch = 1;
+
+    iotest.onoff_dist = DIST_CONST;
+    iotest.onoff_first = ONOFF_FIRST;
+
+    iotest.prep_chunk = PREP_CHUNK;
+
+    iotest.meta_files = META_FILES;
+    iotest.meta_dirs = META_DIRS;
+    iotest.meta_size = META_SIZE;
+    iotest.meta_fill = META_FILL;
+
+    iotest.stat_int = STAT_INT;
+    iotest.coord_fd = -1;
+
+    iotest.cache_advice = -1;
+    iotest.cache_ra = -1;
+
+    iotest.steady_cv  = STEADY_CV;
+    iotest.steady_win = STEADY_WIN;
+    iotest.steady_int = STEADY_INT;
+    iotest.steady_max = STEADY_MAX;
+
+    iotest.sweep   = SWEEP_NONE;
+    iotest.knee    = SWEEP_KNEE;
     
+
+    return(ctx);
+}
+
+/*
+ * iotest_configure(): sets up a context by the options of the command;
+ * argv is copied, and a context is configured once
+ */
+
+int iotest_configure(struct iotest_t *ctx, int argc, char **argv)
+{
+    int i;
+
+    IOTEST_ENTER(ctx);
+    if(iotest.argv){
+	errno = EBUSY;
+	return(-1);
+    }
+    if((iotest.argv = (char **)calloc(argc + 1, sizeof(char *))) == NULL)
+	return(-1);
+    for(i=0; i<argc; i++)
+	if((iotest.argv[i] = strdup(argv[i])) == NULL)
+	    return(-1);
+    iotest.argc = argc;
+
+    IOTEST_TRY();
+    parse_options(iotest.argc, iotest.argv);
+
+    return(0);
+}
+
+/*
+ * iotest_run(): runs the test, the sweep or the copies as configured,
+ * keeping the results until the next run or iotest_destroy()
+ */
+
+int iotest_run(struct iotest_t *ctx)
+{
+    IOTEST_ENTER(ctx);
+    IOTEST_TRY();
+
+    if(iotest.is_setup)
+	cleanup();
+    iotest.error = 0;
+    iotest.is_run = 0;
+    iotest.npoint = 0;
+
+    timer_init();
+
+    if(iotest.prep){
+	prepare();
+	if(!IS_RANDOM && !IS_SEQUENTIAL && !iotest.is_oltp && !iotest.log && !iotest.copy &&
+	   !iotest.meta)
+	    return(0);
+    }
+
+    check_options();
+    if(iotest.is_perf)
+	perf_probe();
+
+    if(VERBOSE1)
+	print_config();
+
+    setup();
+
+    if(iotest.sweep)
+	sweep();
+    else if(iotest.copy)
+	copy();
+    else if(iotest.trial_n)
+	trial();
+    else{
+	run_test();
+	point_record(&(iotest.point[iotest.npoint++]));
+    }
+    iotest.is_run = 1;
+
+    return(0);
+}
+
+/*
+ * iotest_report(): prints the report of the last run, as the command does
+ */
+
+int iotest_report(struct iotest_t *ctx)
+{
+    IOTEST_ENTER(ctx);
+    IOTEST_TRY();
+
+    if(!iotest.is_run)
+	return(0);
+
+    if(iotest.sweep)
+	print_result_sweep();
+    else if(iotest.copy)
+	print_result_copy();
+    else{
+	if(iotest.trial_n)
+	    print_result_trial();
+	else{
+	    print_result();
+	    if(iotest.is_oltp)
+		print_result_oltp();
+	    else if(iotest.log)
+		print_result_log();
+	    else if(iotest.meta)
+		print_result_meta();
+	}
+	if(iotest.rec_size)
+	    dump_events();
+	if(iotest.heat_nregion)
+	    dump_heat();
+    }
+    fflush(stdout);
+
+    return(0);
+}
+
+/*
+ * iotest_nresult(), iotest_result(): number of results of the last run,
+ * and each of them; a run gives one, a sweep one per point, and a copy
+ * one per method in the order of read/write, splice and copy_file_range
+ */
+
+int iotest_nresult(struct iotest_t *ctx)
+{
+    int m, n = 0;
+
+    IOTEST_ENTER(ctx);
+    if(!iotest.is_run)
+	return(0);
+    if(!iotest.copy)
+	return(iotest.npoint);
+    for(m=0; m<NCOPY; m++)
+	if(iotest.copy & (1 << m))
+	    n++;
+    return(n);
+}
+
+int iotest_result(struct iotest_t *ctx, int idx, struct iotest_result_t *res)
+{
+    struct iotest_point_t *pt = NULL;
+    int m;
+
+    IOTEST_ENTER(ctx);
+    if(idx < 0 || idx >= iotest_nresult(ctx)){
+	errno = EINVAL;
+	return(-1);
+    }
+    if(iotest.copy){
+	for(m=0; m<NCOPY; m++)
+	    if((iotest.copy & (1 << m)) && idx-- == 0)
+		break;
+	pt = &(iotest.copy_point[m]);
+    }else
+	pt = &(iotest.point[idx]);
+    point_result(pt, res);
+
+    return(0);
+}
+
+/*
+ * iotest_knee(): the knee of a sweep for a block size (0 for the first
+ * one), that is, the least concurrency reaching -G knee of the peak
+ */
+
+int iotest_knee(struct iotest_t *ctx, int blksiz, struct iotest_result_t *res)
+{
+    struct iotest_point_t *pt;
+
+    IOTEST_ENTER(ctx);
+    if(!iotest.is_run || !iotest.sweep ||
+       (pt = sweep_knee(blksiz ? blksiz : iotest.point[0].blksiz, NULL)) == NULL){
+	errno = EINVAL;
+	return(-1);
+    }
+    point_result(pt, res);
+
+    return(0);
+}
+
+/*
+ * iotest_destroy(): releases a context
+ */
+
+void iotest_destroy(struct iotest_t *ctx)
+{
+    int i;
+
+    IOTEST_ENTER(ctx);
+    if(iotest.is_setup)
+	cleanup();
+
+    if(iotest.dev){
+	for(i=0; i<iotest.ndev; i++)
+	    free(iotest.dev[i].fname);
+	shm_free(iotest.dev, sizeof(struct iotest_dev_t) * iotest.ndev);
+    }
+    if(iotest.shm)
+	shm_free(iotest.shm, sizeof(struct iotest_shm_t));
+    free(iotest.fd);
+    if(iotest.argv){
+	for(i=0; i<iotest.argc; i++)
+	    free(iotest.argv[i]);
+	free(iotest.argv);
+    }
+#ifdef IOTEST_LIBRARY
+    free(ctx);
+    iotest_cur = NULL;
+#endif
+}
+
+/*
+ * iotest_exit(): ends on an error (or -V). The command exits; in the
+ * library, the caller of the API unwinds to its entry and returns the
+ * error, while a worker stops the others and leaves the error to main.
+ */
+
+static void iotest_exit(int status)
+{
+#ifdef IOTEST_LIBRARY
+    if(status != EXIT_SUCCESS && !iotest.error)
+	iotest.error = errno ? errno : EINVAL;
+
+    if(iotest_worker || iotest_is_helper){
+	if(iotest.shm)
+	    iotest.shm->is_stopping = 1;
+	/* Main and the others are waiting for this worker to start. */
+	if(iotest_worker && !iotest_worker->is_started)
+	    iotest_start(iotest_worker);
+	if(getpid() != iotest.pid)
+	    _exit(status);
+	pthread_exit(NULL);
+    }
+    if(getpid() != iotest.pid)
+	_exit(status);
+
+    iotest.status = status;
+    longjmp(iotest.jmp, 1);
+#else
+    /* Main is waiting at the barrier for a worker process to start. */
+    if(iotest_worker && getpid() != iotest.pid){
+	iotest.shm->is_stopping = 1;
+	if(!iotest_worker->is_started)
+	    iotest_start(iotest_worker);
+	fflush(stdout);
+	_exit(status);
+    }
+    if(getpid() == iotest.pid){
+	/* Viewers of -Z would wait for a segment no one updates. */
+	if(iotest.stat){
+	    iotest.stat->state = IOTEST_STAT_DONE;
+	    stat_unlink();
+	}
+	/* Readahead of -C ra is of the whole device. */
+	cache_restore();
+    }
+    exit(status);
+#endif
+}
+
+/*
+ * parse_options(): command line
+ */
+
+static void parse_options(int argc, char **argv)
+{
+    int i;
+    int opt;
+
+    optind = 1;
+
     while(1){
-        if((opt = getopt(argc, argv, "RSWM:A:b:s:e:c:dpvV")) == EOF)
+        if((opt = getopt(argc, argv, "RSWM:mA:Q:i:b:s:e:c:D:k:B:dpC:Y:F:L:O:P:G:E:H:K:r:I:Z:z:w:t:x:XnvV")) == EOF)
             break;
         switch(opt){
         case 'v':
             iotest.verbose++;
             break;
+        case 'n':
+            iotest.is_nonop = 1;
+            break;
+        case 'X':
+#ifdef __linux__
+            iotest.is_perf = 1;
+#else
+	    fprintf(stderr, "Error: -X is supported only on Linux.\n");
+	    iotest_exit(EXIT_FAILURE);
+#endif
+            break;
         case 'R':
             iotest.mode |= MODE_RANDOM;
             break;
@@ -433,13 +1857,49 @@ int main(int argc, char **argv)
 	    iotest.mode |= MODE_WRITE;
             break;
         case 'M':
-            iotest.nthr = atoi(optarg);
+            iotest.nsw_nthr = parse_list(opt, optarg, iotest.sw_nthr, MAX_NSWEEP, 1);
+            iotest.nthr = iotest.sw_nthr[0];
+            break;
+        case 'm':
+            iotest.is_proc = 1;
             break;
         case 'A':
-            iotest.naio = atoi(optarg);
+            iotest.nsw_naio = parse_list(opt, optarg, iotest.sw_naio, MAX_NSWEEP, 0);
+            iotest.naio = iotest.sw_naio[0];
+            break;
+        case 'i':
+	{
+	    char *opts = strchr(optarg, ','), *val;
+	    char *const tokens[] = { "batch", NULL };
+
+	    if(opts)
+		*opts++ = '\0';
+            if((iotest.engine = engine_find(optarg)) < 0){
+		fprintf(stderr, "Error: Unknown engine %s; one of", optarg);
+		for(i=0; i<iotest_nengine; i++)
+		    fprintf(stderr, " %s", iotest_engine[i].name);
+		fprintf(stderr, ".\n");
+		iotest_exit(EXIT_FAILURE);
+	    }
+	    while(opts && *opts != '\0'){
+		switch(getsubopt(&opts, tokens, &val)){
+		case 0:
+		    if(val == NULL || (iotest.aio_batch = atoi(val)) <= 0){
+			fprintf(stderr, "Error: batch must be a positive integer.\n");
+			iotest_exit(EXIT_FAILURE);
+		    }
+		    break;
+		default:
+		    fprintf(stderr, "Error: Unknown engine option, %s.\n", val);
+		    print_usage();
+		    iotest_exit(EXIT_FAILURE);
+		}
+	    }
+	}
             break;
         case 'b':
-            iotest.blksiz = atoi(optarg);
+            iotest.nsw_blksiz = parse_list(opt, optarg, iotest.sw_blksiz, MAX_NSWEEP, 1);
+            iotest.blksiz = iotest.sw_blksiz[0];
             break;
         case 's':
 	    iotest.ofst0 = atol(optarg);
@@ -448,7 +1908,75 @@ int main(int argc, char **argv)
 	    iotest.ofst1 = atol(optarg);
             break;
         case 'c':
-	    iotest.nio = atof(optarg);
+	{
+	    char *end;
+
+	    /* Exact up to 2^64-1; a float such as 1e9 is still taken. */
+	    errno = 0;
+	    iotest.nio = strtoull(optarg, &end, 10);
+	    if(*end != '\0' && !errno){
+		double d = strtod(optarg, &end);
+		iotest.nio = d < 1.8e19 ? (unsigned long long)d : 0;
+		if(d >= 1.8e19)
+		    errno = ERANGE;
+	    }
+	    if(errno || *end != '\0' || optarg[0] == '-'){
+		fprintf(stderr, "Error: Number of I/Os must be a non-negative integer.\n");
+		iotest_exit(EXIT_FAILURE);
+	    }
+	}
+            break;
+        case 'D':
+	    if((iotest.duration = atoi(optarg)) <= 0){
+		fprintf(stderr, "Error: Duration must be a positive integer.\n");
+		iotest_exit(EXIT_FAILURE);
+	    }
+            break;
+        case 'O':
+	{
+	    char *opts = optarg, *val;
+	    char *const tokens[] = { "log", "read", "ckpt", NULL };
+	    int n, v[4];
+
+	    iotest.is_oltp = 1;
+	    while(*opts != '\0'){
+		switch(n = getsubopt(&opts, tokens, &val)){
+		case ROLE_LOG:
+		    v[0] = 1; v[1] = OLTP_LOG_BLKSIZ; v[2] = 0;
+		    break;
+		case ROLE_READ:
+		    v[0] = OLTP_READ_NTHR; v[1] = OLTP_READ_BLKSIZ; v[2] = 0;
+		    break;
+		case ROLE_CKPT:
+		    v[0] = OLTP_CKPT_PERIOD; v[1] = OLTP_CKPT_PAGES; v[2] = OLTP_READ_BLKSIZ; v[3] = 1;
+		    break;
+		default:
+		    fprintf(stderr, "Error: Unknown stream, %s.\n", val);
+		    print_usage();
+		    iotest_exit(EXIT_FAILURE);
+		}
+		if(val && sscanf(val, "%d:%d:%d:%d", &v[0], &v[1], &v[2], &v[3]) < 1){
+		    fprintf(stderr, "Error: Stream %s is not correctly set.\n", tokens[n]);
+		    iotest_exit(EXIT_FAILURE);
+		}
+		if(n == ROLE_CKPT){
+		    iotest.ckpt_period = v[0];
+		    iotest.ckpt_pages = v[1];
+		    iotest.oltp[n][0] = v[3];
+		    iotest.oltp[n][1] = v[2];
+		    iotest.oltp[n][2] = 0;
+		}else{
+		    iotest.oltp[n][0] = v[0];
+		    iotest.oltp[n][1] = v[1];
+		    iotest.oltp[n][2] = v[2];
+		}
+		if(iotest.oltp[n][0] < 0 || iotest.oltp[n][1] <= 0 || iotest.oltp[n][2] < 0 ||
+		   (n == ROLE_CKPT && (iotest.ckpt_period <= 0 || iotest.ckpt_pages <= 0))){
+		    fprintf(stderr, "Error: Stream %s is not correctly set.\n", tokens[n]);
+		    iotest_exit(EXIT_FAILURE);
+		}
+	    }
+	}
             break;
         case 'd':
 	    iotest.mode |= MODE_DIRECTIO;
@@ -456,13 +1984,575 @@ int main(int argc, char **argv)
         case 'p':
 	    iotest.mode |= MODE_SYNC;
             break;
+        case 'Q':
+	    if(sscanf(optarg, "%d:%d", &iotest.pipe_s, &iotest.pipe_c) != 2 ||
+	       iotest.pipe_s <= 0 || iotest.pipe_c <= 0){
+		fprintf(stderr, "Error: Pipeline ratio must be given as <submitters>:<completers>.\n");
+		iotest_exit(EXIT_FAILURE);
+	    }
+            break;
+        case 'Y':
+	{
+	    char *opts = optarg, *val;
+	    char *const tokens[] = { "rw", "splice", "cfr", "all", NULL };
+	    int n;
+
+	    while(*opts != '\0'){
+		if((n = getsubopt(&opts, tokens, &val)) < 0){
+		    fprintf(stderr, "Error: Unknown copy method, %s.\n", val);
+		    print_usage();
+		    iotest_exit(EXIT_FAILURE);
+		}
+		iotest.copy |= n < NCOPY ? 1 << n : (1 << NCOPY) - 1;
+	    }
+	}
+            break;
+        case 'F':
+	{
+	    char *opts = optarg, *val;
+	    char *const tokens[] = { "create", "open", "write", "fsync", "stat", "rename",
+				     "unlink", "files", "dirs", "size", "fill", "keep", NULL };
+	    unsigned long long size;
+	    int n;
+
+	    iotest.meta = 1;
+	    while(*opts != '\0'){
+		switch(n = getsubopt(&opts, tokens, &val)){
+		case META_CREATE: case META_OPEN: case META_WRITE: case META_FSYNC:
+		case META_STAT: case META_RENAME: case META_UNLINK:
+		    if(val == NULL || (iotest.meta_mix[n] = atoi(val)) < 0){
+			fprintf(stderr, "Error: Weight of %s must be a non-negative integer.\n",
+				tokens[n]);
+			iotest_exit(EXIT_FAILURE);
+		    }
+		    break;
+		case NMETA:
+		    if(val == NULL || (iotest.meta_files = atoi(val)) <= 0){
+			fprintf(stderr, "Error: files must be a positive integer.\n");
+			iotest_exit(EXIT_FAILURE);
+		    }
+		    break;
+		case NMETA + 1:
+		    if(val == NULL || (iotest.meta_dirs = atoi(val)) <= 0){
+			fprintf(stderr, "Error: dirs must be a positive integer.\n");
+			iotest_exit(EXIT_FAILURE);
+		    }
+		    break;
+		case NMETA + 2:
+		    if(val == NULL || (size = parse_size(val)) == 0 || size > INT_MAX){
+			fprintf(stderr, "Error: size must be a positive size.\n");
+			iotest_exit(EXIT_FAILURE);
+		    }
+		    iotest.meta_size = size;
+		    break;
+		case NMETA + 3:
+		    if(val == NULL || (iotest.meta_fill = atoi(val)) < 0 || iotest.meta_fill > 100){
+			fprintf(stderr, "Error: fill must be 0 to 100.\n");
+			iotest_exit(EXIT_FAILURE);
+		    }
+		    break;
+		case NMETA + 4:
+		    iotest.meta_keep = 1;
+		    break;
+		default:
+		    fprintf(stderr, "Error: Unknown metadata option, %s.\n", val);
+		    print_usage();
+		    iotest_exit(EXIT_FAILURE);
+		}
+	    }
+	}
+            break;
+        case 'C':
+	{
+	    char *opts = optarg, *val;
+	    char *const tokens[] = { "drop", "dropall", "normal", "random", "sequential",
+				     "willneed", "noreuse", "ra", "hit", NULL };
+	    int advice[] = { POSIX_FADV_NORMAL, POSIX_FADV_RANDOM, POSIX_FADV_SEQUENTIAL,
+			     POSIX_FADV_WILLNEED, POSIX_FADV_NOREUSE };
+	    int n;
+
+	    while(*opts != '\0'){
+		switch(n = getsubopt(&opts, tokens, &val)){
+		case 0:
+		    iotest.cache_drop = CACHE_DROP_FILE;
+		    break;
+		case 1:
+		    iotest.cache_drop = CACHE_DROP_ALL;
+		    break;
+		case 2: case 3: case 4: case 5: case 6:
+		    iotest.cache_advice = advice[n - 2];
+		    break;
+		case 7:
+		    if(val == NULL || (iotest.cache_ra = atoi(val)) < 0){
+			fprintf(stderr, "Error: ra must be a non-negative integer.\n");
+			iotest_exit(EXIT_FAILURE);
+		    }
+		    break;
+		case 8:
+		    if(val == NULL || (iotest.cache_hit = atoi(val)) <= 0){
+			fprintf(stderr, "Error: hit must be a positive integer.\n");
+			iotest_exit(EXIT_FAILURE);
+		    }
+		    break;
+		default:
+		    fprintf(stderr, "Error: Unknown page cache option, %s.\n", val);
+		    print_usage();
+		    iotest_exit(EXIT_FAILURE);
+		}
+	    }
+	}
+            break;
+        case 'L':
+	{
+	    char *opts = optarg, *val;
+	    char *const tokens[] = { "fsync", "fdatasync", "sfr", "n", "us", "group", NULL };
+
+	    while(*opts != '\0'){
+		switch(getsubopt(&opts, tokens, &val)){
+		case 0:
+		    iotest.log = LOG_FSYNC;
+		    break;
+		case 1:
+		    iotest.log = LOG_FDATASYNC;
+		    break;
+		case 2:
+		    iotest.log = LOG_SFR;
+		    break;
+		case 3:
+		    if(val == NULL || (iotest.log_n = atoi(val)) <= 0){
+			fprintf(stderr, "Error: n must be a positive integer.\n");
+			iotest_exit(EXIT_FAILURE);
+		    }
+		    break;
+		case 4:
+		    if(val == NULL || (iotest.log_us = atoi(val)) <= 0){
+			fprintf(stderr, "Error: us must be a positive integer.\n");
+			iotest_exit(EXIT_FAILURE);
+		    }
+		    break;
+		case 5:
+		    iotest.log_group = 1;
+		    break;
+		default:
+		    fprintf(stderr, "Error: Unknown log option, %s.\n", val);
+		    print_usage();
+		    iotest_exit(EXIT_FAILURE);
+		}
+	    }
+	    if(iotest.log == LOG_NONE){
+		fprintf(stderr, "Error: Sync method, fsync, fdatasync or sfr, must be specified.\n");
+		iotest_exit(EXIT_FAILURE);
+	    }
+	}
+            break;
+        case 'P':
+	{
+	    char *opts = optarg, *val;
+	    char *const tokens[] = { "alloc", "fill", "full", "size", "chunk", NULL };
+
+	    while(*opts != '\0'){
+		switch(getsubopt(&opts, tokens, &val)){
+		case 0:
+		    iotest.prep = PREP_ALLOC;
+		    break;
+		case 1:
+		    iotest.prep = PREP_FILL;
+		    break;
+		case 2:
+		    iotest.prep = PREP_FULL;
+		    break;
+		case 3:
+		    if(val == NULL || (iotest.prep_size = parse_size(val)) == 0){
+			fprintf(stderr, "Error: size must be a positive size.\n");
+			iotest_exit(EXIT_FAILURE);
+		    }
+		    break;
+		case 4:
+		    if(val == NULL || (iotest.prep_chunk = (int)parse_size(val)) <= 0){
+			fprintf(stderr, "Error: chunk must be a positive size.\n");
+			iotest_exit(EXIT_FAILURE);
+		    }
+		    break;
+		default:
+		    fprintf(stderr, "Error: Unknown prepare option, %s.\n", val);
+		    print_usage();
+		    iotest_exit(EXIT_FAILURE);
+		}
+	    }
+	    if(iotest.prep == PREP_NONE){
+		fprintf(stderr, "Error: Prepare level, alloc, fill or full, must be specified.\n");
+		iotest_exit(EXIT_FAILURE);
+	    }
+	}
+            break;
+        case 'E':
+	{
+	    char *opts = optarg, *val;
+	    char *const tokens[] = { "n", "thresh", "file", NULL };
+	    int n;
+
+	    while(*opts != '\0'){
+		switch(getsubopt(&opts, tokens, &val)){
+		case 0:
+		    if(val == NULL || (n = atoi(val)) <= 0){
+			fprintf(stderr, "Error: n must be a positive integer.\n");
+			iotest_exit(EXIT_FAILURE);
+		    }
+		    for(iotest.rec_size = 1; iotest.rec_size < n; iotest.rec_size <<= 1)
+			;
+		    break;
+		case 1:
+		    if(val == NULL){
+			fprintf(stderr, "Error: thresh requires a value.\n");
+			iotest_exit(EXIT_FAILURE);
+		    }
+		    iotest.rec_thresh = strtoull(val, NULL, 10) * KILO;
+		    break;
+		case 2:
+		    if(val == NULL){
+			fprintf(stderr, "Error: file requires a value.\n");
+			iotest_exit(EXIT_FAILURE);
+		    }
+		    iotest.rec_file = val;
+		    break;
+		default:
+		    fprintf(stderr, "Error: Unknown event log option, %s.\n", val);
+		    print_usage();
+		    iotest_exit(EXIT_FAILURE);
+		}
+	    }
+	    if(!iotest.rec_size)
+		iotest.rec_size = REC_SIZE;
+	}
+            break;
+        case 'I':
+	    iotest.prof_file = optarg;
+            break;
+        case 'r':
+	{
+	    char *opts = optarg, *val;
+	    char *const tokens[] = { "n", "cool", "drop", NULL };
+
+	    while(*opts != '\0'){
+		switch(getsubopt(&opts, tokens, &val)){
+		case 0:
+		    if(val == NULL || (iotest.trial_n = atoi(val)) <= 0 || iotest.trial_n > MAX_NPOINT){
+			fprintf(stderr, "Error: n must be 1 to %d.\n", MAX_NPOINT);
+			iotest_exit(EXIT_FAILURE);
+		    }
+		    break;
+		case 1:
+		    if(val == NULL || (iotest.trial_cool = atoi(val)) < 0){
+			fprintf(stderr, "Error: cool must be a non-negative integer.\n");
+			iotest_exit(EXIT_FAILURE);
+		    }
+		    break;
+		case 2:
+		    if(!iotest.cache_drop)
+			iotest.cache_drop = CACHE_DROP_FILE;
+		    break;
+		default:
+		    fprintf(stderr, "Error: Unknown trial option, %s.\n", val);
+		    print_usage();
+		    iotest_exit(EXIT_FAILURE);
+		}
+	    }
+	    if(!iotest.trial_n){
+		fprintf(stderr, "Error: -r requires n.\n");
+		iotest_exit(EXIT_FAILURE);
+	    }
+	}
+            break;
+        case 'K':
+	{
+	    char *opts = optarg, *val;
+	    char *const tokens[] = { "file", "int", NULL };
+
+	    iotest.chk_int = CHK_INT;
+	    while(*opts != '\0'){
+		switch(getsubopt(&opts, tokens, &val)){
+		case 0:
+		    if(val == NULL){
+			fprintf(stderr, "Error: file requires a value.\n");
+			iotest_exit(EXIT_FAILURE);
+		    }
+		    iotest.chk_file = val;
+		    break;
+		case 1:
+		    if(val == NULL || (iotest.chk_int = atoi(val)) <= 0){
+			fprintf(stderr, "Error: int must be a positive integer.\n");
+			iotest_exit(EXIT_FAILURE);
+		    }
+		    break;
+		default:
+		    fprintf(stderr, "Error: Unknown checkpoint option, %s.\n", val);
+		    print_usage();
+		    iotest_exit(EXIT_FAILURE);
+		}
+	    }
+	    if(iotest.chk_file == NULL){
+		fprintf(stderr, "Error: -K requires file.\n");
+		iotest_exit(EXIT_FAILURE);
+	    }
+	}
+            break;
+        case 'H':
+	{
+	    char *opts = optarg, *val;
+	    char *const tokens[] = { "regions", "int", "file", NULL };
+
+	    iotest.heat_nregion = HEAT_NREGION;
+	    iotest.heat_int = HEAT_INT;
+	    while(*opts != '\0'){
+		switch(getsubopt(&opts, tokens, &val)){
+		case 0:
+		    if(val == NULL || (iotest.heat_nregion = atoi(val)) <= 0 ||
+		       iotest.heat_nregion > MAX_NREGION){
+			fprintf(stderr, "Error: regions must be 1 to %d.\n", MAX_NREGION);
+			iotest_exit(EXIT_FAILURE);
+		    }
+		    break;
+		case 1:
+		    if(val == NULL || (iotest.heat_int = atoi(val)) <= 0){
+			fprintf(stderr, "Error: int must be a positive integer.\n");
+			iotest_exit(EXIT_FAILURE);
+		    }
+		    break;
+		case 2:
+		    if(val == NULL){
+			fprintf(stderr, "Error: file requires a value.\n");
+			iotest_exit(EXIT_FAILURE);
+		    }
+		    iotest.heat_file = val;
+		    break;
+		default:
+		    fprintf(stderr, "Error: Unknown heatmap option, %s.\n", val);
+		    print_usage();
+		    iotest_exit(EXIT_FAILURE);
+		}
+	    }
+	}
+            break;
+        case 'G':
+	{
+	    char *opts = optarg, *val;
+	    char *const tokens[] = { "grid", "adapt", "knee", NULL };
+
+	    while(*opts != '\0'){
+		switch(getsubopt(&opts, tokens, &val)){
+		case 0:
+		    iotest.sweep = SWEEP_GRID;
+		    break;
+		case 1:
+		    iotest.sweep = SWEEP_ADAPT;
+		    break;
+		case 2:
+		    if(val == NULL || (iotest.knee = atoi(val)) <= 0 || iotest.knee > 100){
+			fprintf(stderr, "Error: knee must be a percentage.\n");
+			iotest_exit(EXIT_FAILURE);
+		    }
+		    break;
+		default:
+		    fprintf(stderr, "Error: Unknown sweep option, %s.\n", val);
+		    print_usage();
+		    iotest_exit(EXIT_FAILURE);
+		}
+	    }
+	    if(iotest.sweep == SWEEP_NONE){
+		fprintf(stderr, "Error: Sweep method, grid or adapt, must be specified.\n");
+		iotest_exit(EXIT_FAILURE);
+	    }
+	}
+            break;
+        case 'Z':
+	{
+	    char *opts = optarg, *val;
+	    char *const tokens[] = { "name", "int", NULL };
+
+	    while(*opts != '\0'){
+		switch(getsubopt(&opts, tokens, &val)){
+		case 0:
+		    if(val == NULL || *val == '\0'){
+			fprintf(stderr, "Error: name requires a value.\n");
+			iotest_exit(EXIT_FAILURE);
+		    }
+		    iotest.stat_name = val;
+		    break;
+		case 1:
+		    if(val == NULL || (iotest.stat_int = atoi(val)) <= 0){
+			fprintf(stderr, "Error: int must be a positive integer.\n");
+			iotest_exit(EXIT_FAILURE);
+		    }
+		    break;
+		default:
+		    fprintf(stderr, "Error: Unknown live statistics option, %s.\n", val);
+		    print_usage();
+		    iotest_exit(EXIT_FAILURE);
+		}
+	    }
+	    if(iotest.stat_name == NULL){
+		fprintf(stderr, "Error: name of the live statistics must be specified.\n");
+		iotest_exit(EXIT_FAILURE);
+	    }
+	}
+            break;
+        case 'z':
+	{
+	    char *opts = optarg, *val;
+	    char *const tokens[] = { "path", "port", "name", NULL };
+
+	    while(*opts != '\0'){
+		switch(getsubopt(&opts, tokens, &val)){
+		case 0:
+		    if(val == NULL || *val == '\0'){
+			fprintf(stderr, "Error: path requires a value.\n");
+			iotest_exit(EXIT_FAILURE);
+		    }
+		    iotest.coord_path = val;
+		    break;
+		case 1:
+		    if(val == NULL || (iotest.coord_port = atoi(val)) <= 0 || iotest.coord_port > 65535){
+			fprintf(stderr, "Error: port must be between 1 and 65535.\n");
+			iotest_exit(EXIT_FAILURE);
+		    }
+		    break;
+		case 2:
+		    if(val == NULL || *val == '\0'){
+			fprintf(stderr, "Error: name requires a value.\n");
+			iotest_exit(EXIT_FAILURE);
+		    }
+		    iotest.coord_name = val;
+		    break;
+		default:
+		    fprintf(stderr, "Error: Unknown coordinator option, %s.\n", val);
+		    print_usage();
+		    iotest_exit(EXIT_FAILURE);
+		}
+	    }
+	    if((iotest.coord_path == NULL) == (iotest.coord_port == 0)){
+		fprintf(stderr, "Error: Either path or port of the coordinator must be specified.\n");
+		iotest_exit(EXIT_FAILURE);
+	    }
+	}
+            break;
+        case 'k':
+	{
+	    char *val;
+	    char *const tokens[] = { "", "const", "exp", "uniform", "pareto", NULL };
+	    int n;
+
+	    if((val = strchr(optarg, '=')) != NULL)
+		*val++ = '\0';
+	    for(n=1; tokens[n]; n++)
+		if(strcmp(optarg, tokens[n]) == 0)
+		    break;
+	    if(tokens[n] == NULL || val == NULL){
+		fprintf(stderr, "Error: Unknown think time, %s.\n", optarg);
+		print_usage();
+		iotest_exit(EXIT_FAILURE);
+	    }
+	    iotest.think = n;
+	    iotest.think_b = 0;
+	    if(sscanf(val, "%lf:%lf", &(iotest.think_a), &(iotest.think_b)) < 1 ||
+	       iotest.think_a < 0 ||
+	       (n == DIST_UNIFORM && iotest.think_b < iotest.think_a) ||
+	       (n == DIST_PARETO && iotest.think_b <= 1)){
+		fprintf(stderr, "Error: Invalid parameters of think time, %s.\n", val);
+		iotest_exit(EXIT_FAILURE);
+	    }
+	}
+            break;
+        case 'B':
+	{
+	    char *opts = optarg, *val;
+	    char *const tokens[] = { "n", "idle", "exp", "first", NULL };
+	    int n;
+
+	    while(*opts != '\0'){
+		switch(n = getsubopt(&opts, tokens, &val)){
+		case 0: case 1: case 3:
+		    if(val == NULL || atoi(val) < (n == 0 ? 1 : 0)){
+			fprintf(stderr, "Error: %s must be a %s integer.\n",
+				tokens[n], n == 0 ? "positive" : "non-negative");
+			iotest_exit(EXIT_FAILURE);
+		    }
+		    if(n == 0) iotest.onoff_n = atoi(val);
+		    if(n == 1) iotest.onoff_idle = atoi(val);
+		    if(n == 3) iotest.onoff_first = atoi(val);
+		    break;
+		case 2:
+		    iotest.onoff_dist = DIST_EXP;
+		    break;
+		default:
+		    fprintf(stderr, "Error: Unknown burst option, %s.\n", val);
+		    print_usage();
+		    iotest_exit(EXIT_FAILURE);
+		}
+	    }
+	    if(!iotest.onoff_n){
+		fprintf(stderr, "Error: -B requires n.\n");
+		iotest_exit(EXIT_FAILURE);
+	    }
+	}
+            break;
+        case 'w':
+	{
+	    char *opts = optarg, *val;
+	    char *const tokens[] = { "on", "cv", "win", "int", "max", NULL };
+	    int n;
+
+	    iotest.is_steady = 1;
+	    while(*opts != '\0'){
+		switch(n = getsubopt(&opts, tokens, &val)){
+		case 0:
+		    break;
+		case 1: case 2: case 3: case 4:
+		    if(val == NULL || atoi(val) <= 0){
+			fprintf(stderr, "Error: %s must be a positive integer.\n", tokens[n]);
+			iotest_exit(EXIT_FAILURE);
+		    }
+		    if(n == 1) iotest.steady_cv = atoi(val);
+		    if(n == 2) iotest.steady_win = atoi(val);
+		    if(n == 3) iotest.steady_int = atoi(val);
+		    if(n == 4) iotest.steady_max = atoi(val);
+		    break;
+		default:
+		    fprintf(stderr, "Error: Unknown steady state option, %s.\n", val);
+		    print_usage();
+		    iotest_exit(EXIT_FAILURE);
+		}
+	    }
+	    if(iotest.steady_win < 2){
+		fprintf(stderr, "Error: win must be 2 or more.\n");
+		iotest_exit(EXIT_FAILURE);
+	    }
+	}
+            break;
+        case 't':
+	    iotest.is_timer_set = 1;
+	    if(strcmp(optarg, "mono") == 0)
+		iotest.timer = TIMER_MONOTONIC;
+	    else if(strcmp(optarg, "tsc") == 0)
+		iotest.timer = TIMER_TSC;
+	    else{
+		fprintf(stderr, "Error: Unknown timer source, %s.\n", optarg);
+		print_usage();
+		iotest_exit(EXIT_FAILURE);
+	    }
+            break;
+        case 'x':
+	    if((iotest.seed = (unsigned int)strtoul(optarg, NULL, 0)) == 0){
+		fprintf(stderr, "Error: Seed must be a positive integer.\n");
+		iotest_exit(EXIT_FAILURE);
+	    }
+            break;
         case 'V':
 	    print_version();
-            exit(EXIT_SUCCESS);	    
+            iotest_exit(EXIT_SUCCESS);	    
             break;
         default:
             print_usage();
-            exit(EXIT_FAILURE);
+            iotest_exit(EXIT_FAILURE);
         }
     }
 
@@ -471,617 +2561,5006 @@ int main(int argc, char **argv)
     if(argc <= optind){
 	fprintf(stderr, "Error: device_or_file is not specified.\n");
 	print_usage();
-	exit(EXIT_FAILURE);
+	iotest_exit(EXIT_FAILURE);
     }
     iotest.ndev = argc - optind;
+    if(iotest.ndev > MAX_NDEV){
+	fprintf(stderr, "Error: Number of specified devices exceeds system limits.\n");
+	iotest_exit(EXIT_FAILURE);
+    }
 
-    iotest.dev = (struct iotest_dev_t *)malloc(sizeof(struct iotest_dev_t) * iotest.ndev);
-    memset(iotest.dev, 0, sizeof(struct iotest_dev_t) * iotest.ndev);
-    if(iotest.dev == NULL){
-	perror("main:malloc()");
-	exit(EXIT_FAILURE);
+    iotest.dev = (struct iotest_dev_t *)shm_alloc(sizeof(struct iotest_dev_t) * iotest.ndev);
+    iotest.shm = (struct iotest_shm_t *)shm_alloc(sizeof(struct iotest_shm_t));
+    if((iotest.fd = (int *)malloc(sizeof(int) * iotest.ndev)) == NULL){
+	perror("parse_options:malloc()");
+	iotest_exit(EXIT_FAILURE);
     }
     
     for(i=0; i<iotest.ndev; i++){
 	iotest.dev[i].fname = (char *)strdup(argv[optind + i]);
+	iotest.fd[i] = -1;
     }
 
-    /*
-     * Check the correctness of options
-     */
+    if(iotest.prof_file)
+	prof_load();
+}
+
+/*
+ * check_options(): checks the correctness of options, and derives the
+ * access range and the upper bounds of resources
+ */
+
+static void check_options(void)
+{
+    int i;
+
+    if(iotest.is_oltp){
+	if(!iotest.duration){
+	    fprintf(stderr, "Error: -O requires -D.\n");
+	    iotest_exit(EXIT_FAILURE);
+	}
+	if(iotest.naio || iotest.sweep || IS_SEQUENTIAL){
+	    fprintf(stderr, "Error: -O cannot be specified with -A, -G or -S.\n");
+	    iotest_exit(EXIT_FAILURE);
+	}
+	iotest.mode |= MODE_RANDOM;
+	iotest.nthr = 0;
+	for(i=0; i<NROLE; i++)
+	    iotest.nthr += iotest.oltp[i][0];
+	if(iotest.nthr == 0){
+	    fprintf(stderr, "Error: No stream is specified.\n");
+	    iotest_exit(EXIT_FAILURE);
+	}
+	if(!iotest.log)
+	    iotest.log = LOG_FDATASYNC;
+	if(!iotest.log_n && !iotest.log_us)
+	    iotest.log_n = 1;
+    }
+
+    if(iotest.log && !iotest.is_oltp){
+	if(IS_RANDOM){
+	    fprintf(stderr, "Error: -L and -R cannot be specified simultaneously.\n");
+	    iotest_exit(EXIT_FAILURE);
+	}
+	if(iotest.naio){
+	    fprintf(stderr, "Error: -L and -A cannot be specified simultaneously.\n");
+	    iotest_exit(EXIT_FAILURE);
+	}
+	iotest.mode |= MODE_SEQUENTIAL | MODE_WRITE;
+	if(!iotest.log_n && !iotest.log_us)
+	    iotest.log_n = 1;
+    }
+
+    if(iotest.copy){
+	if(iotest.ndev != 2){
+	    fprintf(stderr, "Error: -Y requires a source and a destination.\n");
+	    iotest_exit(EXIT_FAILURE);
+	}
+	if(IS_RANDOM || IS_WRITE || iotest.naio || iotest.log || iotest.is_oltp || iotest.sweep){
+	    fprintf(stderr, "Error: -Y cannot be specified with -R, -W, -A, -L, -O or -G.\n");
+	    iotest_exit(EXIT_FAILURE);
+	}
+	iotest.mode |= MODE_SEQUENTIAL;
+    }
+
+    if(iotest.meta){
+	int mix[NMETA] = { 20, 10, 10, 5, 40, 5, 10 };
+
+	if(IS_RANDOM || IS_SEQUENTIAL || IS_WRITE || iotest.naio || iotest.log ||
+	   iotest.is_oltp || iotest.copy || iotest.sweep || iotest.pipe_s || iotest.prep ||
+	   iotest.engine >= 0 || IS_NONOP){
+	    fprintf(stderr, "Error: -F cannot be specified with -R, -S, -W, -A, -L, -O, -Y, -G, -Q, -P, -i or -n.\n");
+	    iotest_exit(EXIT_FAILURE);
+	}
+	if(iotest.cache_drop || iotest.cache_advice >= 0 || iotest.cache_ra >= 0 ||
+	   iotest.cache_hit || iotest.heat_nregion || iotest.think || iotest.onoff_n){
+	    fprintf(stderr, "Error: -F cannot be specified with -C, -H, -k, -B or -r drop.\n");
+	    iotest_exit(EXIT_FAILURE);
+	}
+	for(i=0; i<NMETA && !iotest.meta_mix[i]; i++)
+	    ;
+	if(i == NMETA)
+	    memcpy(iotest.meta_mix, mix, sizeof(mix));
+	iotest.mode |= MODE_RANDOM;
+	iotest.blksiz = iotest.meta_size;
+    }
 
     if((IS_RANDOM & IS_SEQUENTIAL)){
 	fprintf(stderr, "Error: -R and -S cannot be specified simultaneously.\n");
 	print_usage();
-	exit(EXIT_FAILURE);
+	iotest_exit(EXIT_FAILURE);
     }
     if(!IS_RANDOM && !IS_SEQUENTIAL){
 	fprintf(stderr, "Error: Access mode must be specified.\n");
 	print_usage();
-	exit(EXIT_FAILURE);
+	iotest_exit(EXIT_FAILURE);
+    }
+    if(iotest.pipe_s){
+	if(!iotest.naio){
+	    fprintf(stderr, "Error: -Q requires -A.\n");
+	    iotest_exit(EXIT_FAILURE);
+	}
+	if(iotest.is_proc || iotest.log || iotest.is_oltp || IS_NONOP){
+	    fprintf(stderr, "Error: -Q cannot be specified with -m, -L, -O or -n.\n");
+	    iotest_exit(EXIT_FAILURE);
+	}
+    }
+    if(iotest.cache_hit && (IS_DIRECTIO || IS_WRITE)){
+	fprintf(stderr, "Error: Page cache hits can be sampled only with buffered reads.\n");
+	iotest_exit(EXIT_FAILURE);
+    }
+    if(iotest.rec_size && iotest.sweep){
+	fprintf(stderr, "Error: -E and -G cannot be specified simultaneously.\n");
+	iotest_exit(EXIT_FAILURE);
     }
-    if(iotest.nthr > MAX_NTHR){
+    if(iotest.heat_nregion && (iotest.sweep || iotest.copy)){
+	fprintf(stderr, "Error: -H cannot be specified with -G or -Y.\n");
+	iotest_exit(EXIT_FAILURE);
+    }
+    if(iotest.trial_n && (iotest.sweep || iotest.copy)){
+	fprintf(stderr, "Error: -r cannot be specified with -G or -Y.\n");
+	iotest_exit(EXIT_FAILURE);
+    }
+    if(iotest.chk_file && (iotest.sweep || iotest.copy)){
+	fprintf(stderr, "Error: -K cannot be specified with -G or -Y.\n");
+	iotest_exit(EXIT_FAILURE);
+    }
+    if((iotest.coord_path || iotest.coord_port) && (iotest.sweep || iotest.copy || iotest.trial_n)){
+	fprintf(stderr, "Error: -z cannot be specified with -G, -Y or -r.\n");
+	iotest_exit(EXIT_FAILURE);
+    }
+    if(!iotest.sweep &&
+       (iotest.nsw_nthr > 1 || iotest.nsw_naio > 1 || iotest.nsw_blksiz > 1)){
+	fprintf(stderr, "Error: Lists of parameters are only allowed with -G.\n");
+	print_usage();
+	iotest_exit(EXIT_FAILURE);
+    }
+
+    iotest.mxnthr = iotest.nthr;
+    for(i=0; i<iotest.nsw_nthr; i++)
+	if(iotest.mxnthr < iotest.sw_nthr[i])
+	    iotest.mxnthr = iotest.sw_nthr[i];
+    iotest.mxnaio = iotest.naio;
+    for(i=0; i<iotest.nsw_naio; i++)
+	if(iotest.mxnaio < iotest.sw_naio[i])
+	    iotest.mxnaio = iotest.sw_naio[i];
+    iotest.mxblksiz = iotest.blksiz;
+    for(i=0; i<iotest.nsw_blksiz; i++)
+	if(iotest.mxblksiz < iotest.sw_blksiz[i])
+	    iotest.mxblksiz = iotest.sw_blksiz[i];
+    for(i=0; i<NROLE; i++)
+	if(iotest.oltp[i][0] && iotest.mxblksiz < iotest.oltp[i][1])
+	    iotest.mxblksiz = iotest.oltp[i][1];
+
+    if(iotest.mxnthr > MAX_NTHR){
 	fprintf(stderr, "Error: Multiplex degree exceeds system limit.\n");
-	exit(EXIT_FAILURE);
+	iotest_exit(EXIT_FAILURE);
     }
-    if(iotest.naio > MAX_NAIO){
+    if(iotest.mxnaio > MAX_NAIO){
 	fprintf(stderr, "Error: Number of aio contexts exceeds system limit.\n");
-	exit(EXIT_FAILURE);
+	iotest_exit(EXIT_FAILURE);
     }
-    if(iotest.ndev > MAX_NDEV){
-	fprintf(stderr, "Error: Number of specified devices exceeds system limits.\n");
-	exit(EXIT_FAILURE);
+    if((iotest.think || iotest.onoff_n) &&
+       (iotest.log || iotest.is_oltp || iotest.copy || iotest.pipe_s)){
+	fprintf(stderr, "Error: -k and -B cannot be specified with -L, -O, -Y or -Q.\n");
+	iotest_exit(EXIT_FAILURE);
+    }
+    if(iotest.engine >= 0){
+	if(iotest.log || iotest.is_oltp || iotest.copy || iotest.pipe_s){
+	    fprintf(stderr, "Error: -i cannot be specified with -L, -O, -Y or -Q.\n");
+	    iotest_exit(EXIT_FAILURE);
+	}
+	if(iotest.mxnaio && !iotest_engine[iotest.engine].is_async){
+	    fprintf(stderr, "Error: -A cannot be specified with the %s engine.\n",
+		    iotest_engine[iotest.engine].name);
+	    iotest_exit(EXIT_FAILURE);
+	}
+	/* A think time would hold the ios not yet submitted. */
+	if(iotest.aio_batch > 1 && iotest.think){
+	    fprintf(stderr, "Error: -k cannot be specified with batch.\n");
+	    iotest_exit(EXIT_FAILURE);
+	}
+    }
+
+    /* The tree is made by the threads; there is no access range. */
+    if(iotest.meta){
+	if(iotest.duration && !iotest.nio)
+	    iotest.nio = NIO_INF;
+	if(!iotest.nio)
+	    iotest.nio = iotest.meta_files;
+	if(iotest.prof_file)
+	    prof_check();
+	return;
     }
 
     if(!iotest.ofst1){
 	unsigned long long size;
         if((size = getsize(iotest.dev[0].fname))){
+	    iotest.devsiz = size;
+	    iotest.is_auto_ofst1 = 1;
 	    iotest.ofst1 = size / iotest.blksiz;
 	}else{
 	    fprintf(stderr, "Error: iotest cannot check the size of %s. Please specify explicitly the access range by the use of options, -s and -e.\n", iotest.dev[0].fname);
-	    exit(EXIT_FAILURE);
+	    iotest_exit(EXIT_FAILURE);
 	}
 
-	for(i=1; i<iotest.ndev; i++){
+	/* A copy destination is extended as it is written. */
+	for(i=1; i<iotest.ndev && !iotest.copy; i++){
 	    if(size != getsize(iotest.dev[i].fname)){
 		fprintf(stderr, "Error: devices of different sizes are specified.\n");
-		exit(EXIT_FAILURE);
+		iotest_exit(EXIT_FAILURE);
 	    }
 	}
     }
 
-    if(iotest.ofst0 > iotest.ofst1){
+    if(iotest.ofst0 >= iotest.ofst1){
 	fprintf(stderr, "Error: Access range is not correctly set. (%lu %lu)", iotest.ofst0, iotest.ofst1);
-	exit(EXIT_FAILURE);
+	iotest_exit(EXIT_FAILURE);
     }
 
+    if(iotest.duration && !iotest.nio)
+	iotest.nio = NIO_INF;
+
     if(IS_SEQUENTIAL)
-	if(!iotest.nio)
+	if(!iotest.nio){
+	    iotest.is_auto_nio = 1;
 	    iotest.nio = iotest.ofst1 - iotest.ofst0;
+	}
 
-    /*
-     * Show the configuration
-     */
-    
-    if(VERBOSE1)
-	print_config();
+    if(iotest.prof_file)
+	prof_check();
+}
 
-    /*
-     * Thread invokation
-     */
+/*
+ * prof_load(): reads the capability profile of checksize -p; keys after
+ * a target= line are of that target, taken for the device of the same
+ * path. Unknown keys are ignored.
+ */
 
-    /* Memory allocation and file open*/
+static void prof_load(void)
+{
+    char line[PATH_MAX + 64], *val;
+    struct iotest_dev_t *dev = NULL;
+    int i, is_target = 0;
+    long long aio_max = -1, aio_nr = 0;
+    FILE *fp;
+
+    iotest.prof_tsc = iotest.prof_ncpu = iotest.prof_io_uring = -1;
+    iotest.prof_aio = -1;
+    for(i=0; i<iotest.ndev; i++){
+	iotest.dev[i].dio_align = iotest.dev[i].dio_mem_align = -1;
+	iotest.dev[i].numa_node = iotest.dev[i].nr_requests = -1;
+    }
 
-    iotest.child = (struct iotest_thr_t *)malloc(sizeof(struct iotest_thr_t) * iotest.nthr);
-    memset(iotest.child, 0, sizeof(struct iotest_thr_t) * iotest.nthr);
-    if(iotest.child == NULL){
-	perror("main:malloc()");
-	exit(EXIT_FAILURE);
+    if((fp = fopen(iotest.prof_file, "r")) == NULL){
+	perror("prof_load:fopen()");
+	iotest_exit(EXIT_FAILURE);
+    }
+    while(fgets(line, sizeof(line), fp)){
+	line[strcspn(line, "\n")] = '\0';
+	if(line[0] == '#' || (val = strchr(line, '=')) == NULL)
+	    continue;
+	*val++ = '\0';
+
+	if(strcmp(line, "target") == 0){
+	    is_target = 1;
+	    dev = NULL;
+	    for(i=0; i<iotest.ndev; i++)
+		if(strcmp(iotest.dev[i].fname, val) == 0)
+		    dev = &(iotest.dev[i]);
+	}else if(is_target){
+	    if(dev == NULL)
+		continue;
+	    if(strcmp(line, "dio") == 0 && atoi(val) == 0)
+		dev->dio_align = 0;
+	    else if(strcmp(line, "dio_offset_align") == 0)
+		dev->dio_align = atoi(val);
+	    else if(strcmp(line, "dio_mem_align") == 0)
+		dev->dio_mem_align = atoi(val);
+	    else if(strcmp(line, "numa_node") == 0)
+		dev->numa_node = atoi(val);
+	    else if(strcmp(line, "nr_requests") == 0)
+		dev->nr_requests = atoi(val);
+	}else{
+	    if(strcmp(line, "tsc_invariant") == 0)
+		iotest.prof_tsc = atoi(val);
+	    else if(strcmp(line, "ncpu") == 0)
+		iotest.prof_ncpu = atoi(val);
+	    else if(strcmp(line, "io_uring") == 0)
+		iotest.prof_io_uring = atoi(val);
+	    else if(strcmp(line, "aio_max_nr") == 0)
+		aio_max = atoll(val);
+	    else if(strcmp(line, "aio_nr") == 0)
+		aio_nr = atoll(val);
+	}
+    }
+    fclose(fp);
+
+    if(aio_max >= 0)
+	iotest.prof_aio = aio_max > aio_nr ? aio_max - aio_nr : 0;
+
+    /* The TSC is taken where it is invariant, unless -t says otherwise. */
+#if defined(__x86_64__) || defined(__i386__)
+    if(!iotest.is_timer_set && iotest.prof_tsc == 1)
+	iotest.timer = TIMER_TSC;
+#endif
+}
+
+/*
+ * prof_check(): checks the run against the profile before it starts;
+ * block sizes must be aligned for O_DIRECT, and -A is lowered to what
+ * aio-max-nr leaves, as io_setup() would fail with EAGAIN partway
+ */
+
+static void prof_check(void)
+{
+    int i, j, page = sysconf(_SC_PAGESIZE);
+
+    for(i=0; IS_DIRECTIO && i<iotest.ndev; i++){
+	struct iotest_dev_t *dev = &(iotest.dev[i]);
+	int size[MAX_NSWEEP + NROLE + 1], n = 0;
+
+	if(dev->dio_align < 0)
+	    continue;
+	if(dev->dio_align == 0){
+	    fprintf(stderr, "Error: %s does not support O_DIRECT (-d).\n", dev->fname);
+	    iotest_exit(EXIT_FAILURE);
+	}
+	if(dev->dio_mem_align > page){
+	    fprintf(stderr, "Error: O_DIRECT of %s requires buffers aligned to %d bytes, over a page.\n",
+		    dev->fname, dev->dio_mem_align);
+	    iotest_exit(EXIT_FAILURE);
+	}
+	size[n++] = iotest.blksiz;
+	for(j=0; j<iotest.nsw_blksiz; j++)
+	    size[n++] = iotest.sw_blksiz[j];
+	for(j=0; iotest.is_oltp && j<NROLE; j++)
+	    if(iotest.oltp[j][0])
+		size[n++] = iotest.oltp[j][1];
+	for(j=0; j<n; j++)
+	    if(size[j] % dev->dio_align){
+		fprintf(stderr, "Error: Block size %d is not a multiple of %d, the O_DIRECT alignment of %s.\n",
+			size[j], dev->dio_align, dev->fname);
+		iotest_exit(EXIT_FAILURE);
+	    }
+    }
+
+    /* A context of n events takes max(n, 4 x cpus) x 2 of aio-max-nr;
+       the libaio engine sets up one of 1 event per io in flight, and a
+       pipeline submitter or the aioring engine one of -A events. */
+    if(iotest.prof_aio >= 0 && iotest.mxnaio &&
+       (iotest.pipe_s || engine_of_run() == ENGINE_LIBAIO || engine_of_run() == ENGINE_AIORING)){
+	int is_shared = iotest.pipe_s || engine_of_run() == ENGINE_AIORING;
+	long long ncpu = iotest.prof_ncpu > 0 ? iotest.prof_ncpu : 1;
+	long long nr = is_shared ? iotest.mxnaio : 1;
+	long long cost = 2 * (nr > 4 * ncpu ? nr : 4 * ncpu);
+	long long nctx = is_shared ? iotest.mxnthr : (long long)iotest.mxnthr * iotest.mxnaio;
+	int naio;
+
+	if(nctx * cost > iotest.prof_aio){
+	    if(is_shared)
+		naio = iotest.mxnthr * 8 * ncpu > iotest.prof_aio ? 0 :
+		    iotest.prof_aio / 2 / iotest.mxnthr;
+	    else
+		naio = iotest.prof_aio / cost / iotest.mxnthr;
+	    if(iotest.sweep || iotest.pipe_s || naio < 1){
+		fprintf(stderr, "Error: %lld aio events are required, but aio-max-nr leaves %lld.\n",
+			nctx * cost, iotest.prof_aio);
+		iotest_exit(EXIT_FAILURE);
+	    }
+	    fprintf(stderr, "Warning: -A is lowered from %d to %d, as aio-max-nr leaves %lld events.\n",
+		    iotest.naio, naio, iotest.prof_aio);
+	    iotest.naio = iotest.mxnaio = naio;
+	}
+    }
+
+    for(i=0; i<iotest.ndev; i++){
+	int depth = iotest.mxnthr * (iotest.mxnaio ? iotest.mxnaio : 1) / iotest.ndev;
+	if(iotest.dev[i].nr_requests > 0 && depth > iotest.dev[i].nr_requests)
+	    fprintf(stderr, "Warning: %d ios in flight on %s exceed its nr_requests, %d.\n",
+		    depth, iotest.dev[i].fname, iotest.dev[i].nr_requests);
     }
+}
+
+/*
+ * setup(): allocates thread buffers and opens the devices for runs
+ */
+
+static void setup(void)
+{
+    int i;
+
+    iotest.is_setup = 1;
+
+    iotest.child = (struct iotest_thr_t *)shm_alloc(sizeof(struct iotest_thr_t) * iotest.mxnthr);
     
-    for(i=0; i<iotest.nthr; i++){
-	iotest.child[i].buf = (char *)valloc(iotest.blksiz);
+    for(i=0; i<iotest.mxnthr; i++){
+	iotest.child[i].buf = (char *)valloc(iotest.mxblksiz);
 	if(iotest.child[i].buf == NULL){
-	    perror("main:valloc()");
-	    exit(EXIT_FAILURE);
+	    perror("setup:valloc()");
+	    iotest_exit(EXIT_FAILURE);
+	}
+	memset(iotest.child[i].buf, 0, iotest.mxblksiz);
+    }
+
+    /* Event rings are shared, so that worker processes leave them to main. */
+    if(iotest.rec_size)
+	for(i=0; i<iotest.mxnthr; i++)
+	    iotest.child[i].rec = (struct iotest_rec_t *)
+		shm_alloc(sizeof(struct iotest_rec_t) * iotest.rec_size);
+    if(iotest.heat_nregion)
+	for(i=0; i<iotest.mxnthr; i++)
+	    iotest.child[i].heat = (struct iotest_heat_t *)
+		shm_alloc(sizeof(struct iotest_heat_t) * iotest.ndev * iotest.heat_nregion);
+    if(iotest.meta)
+	for(i=0; i<iotest.mxnthr; i++)
+	    iotest.child[i].meta_hist = (struct iotest_hist_t *)
+		shm_alloc(sizeof(struct iotest_hist_t) * NMETA);
+
+    open_devices();
+    cache_setup();
+    if(iotest.stat_name)
+	stat_open();
+    if(iotest.coord_path || iotest.coord_port)
+	coord_open();
+
+    for(i=0; i<iotest.ndev; i++){
+	pthread_mutexattr_t mattr;
+	pthread_condattr_t cattr;
+
+	pthread_mutexattr_init(&mattr);
+	pthread_mutexattr_setpshared(&mattr, PTHREAD_PROCESS_SHARED);
+	pthread_mutex_init(&(iotest.dev[i].mtx), &mattr);
+	pthread_mutexattr_destroy(&mattr);
+	pthread_condattr_init(&cattr);
+	pthread_condattr_setpshared(&cattr, PTHREAD_PROCESS_SHARED);
+	pthread_cond_init(&(iotest.dev[i].cond), &cattr);
+	pthread_condattr_destroy(&cattr);
+    }
+}
+
+/*
+ * cleanup(): releases the resources of setup(), some of which may not be
+ * there after an error
+ */
+
+static void cleanup(void)
+{
+    int i;
+
+    if(iotest.stat)
+	stat_close();
+    if(iotest.coord_fd >= 0)
+	coord_close();
+
+    cache_restore();
+    for(i=0; i<iotest.ndev; i++)
+	if(iotest.fd[i] >= 0){
+	    close(iotest.fd[i]);
+	    iotest.fd[i] = -1;
 	}
-	memset(iotest.child[i].buf, 0, iotest.blksiz);
+    for(i=0; iotest.child && i<iotest.mxnthr; i++){
+	struct iotest_thr_t *thr = &(iotest.child[i]);
+	/* Engine states of worker processes have gone with them. */
+	if(!iotest.is_proc)
+	    engine_detach(thr);
+	if(thr->rec)
+	    shm_free(thr->rec, sizeof(struct iotest_rec_t) * iotest.rec_size);
+	if(thr->heat)
+	    shm_free(thr->heat, sizeof(struct iotest_heat_t) * iotest.ndev * iotest.heat_nregion);
+	if(thr->meta_hist)
+	    shm_free(thr->meta_hist, sizeof(struct iotest_hist_t) * NMETA);
+	free(thr->buf);
     }
+    free(iotest.heat);
+    free(iotest.heat_ts);
+    iotest.heat = NULL;
+    iotest.heat_ts = NULL;
+    iotest.heat_mxsnap = 0;
+    if(iotest.child)
+	shm_free(iotest.child, sizeof(struct iotest_thr_t) * iotest.mxnthr);
+    iotest.child = NULL;
+    iotest.is_setup = 0;
+}
+
+/*
+ * open_devices(): opens devices into iotest.fd of the calling process
+ */
+
+static void open_devices(void)
+{
+    int i;
 
     for(i=0; i<iotest.ndev; i++){
 	mode_t mode = 0;
 	int flags;
-	if(IS_WRITE)
+	if(iotest.meta)
+	  flags = O_RDONLY | O_DIRECTORY;
+	else if(iotest.is_oltp)
+	  flags = O_RDWR;
+	else if(iotest.copy && i == 1){
+	  flags = O_WRONLY | O_CREAT;
+	  mode = 0644;
+	}else if(IS_WRITE)
 	  flags = O_WRONLY;
 	else
 	  flags = O_RDONLY;
 #ifdef __linux__
-	if(IS_DIRECTIO)
+	if(IS_DIRECTIO && !iotest.meta)
 	    flags |= O_DIRECT;
-	if(IS_SYNCHRONOUS)
+	if(IS_SYNCHRONOUS && !iotest.meta)
 	    flags |= O_SYNC;
 #endif
-	iotest.dev[i].fd = open(iotest.dev[i].fname, flags, mode);
+	iotest.fd[i] = open(iotest.dev[i].fname, flags, mode);
 	
-	if(iotest.dev[i].fd < 0){
-	    perror("main:open()");
-	    exit(EXIT_FAILURE);
+	if(iotest.fd[i] < 0){
+	    perror("open_devices:open()");
+	    iotest_exit(EXIT_FAILURE);
 	}
+
+	/* Access pattern hints are per open file. */
+	if(iotest.cache_advice >= 0 &&
+	   (errno = posix_fadvise(iotest.fd[i], 0, 0, iotest.cache_advice)) != 0)
+	    perror("open_devices:posix_fadvise()");
     }
+}
 
-    /* Invocation */
+/*
+ * cache_setup(): sets readahead and maps devices for residency sampling
+ */
 
-    gettimeofday(&(iotest.tv[0]), NULL);
-    for(i=0; i<iotest.nthr; i++){
-	
-        if(VERBOSE4)
-            printf("Invoking child thread[%d].\n", i);
+static void cache_setup(void)
+{
+    int i;
 
-	iotest.child[i].id = i;
-        if(pthread_create(&(iotest.child[i].thr_id), NULL, thread_handler, (void *)&(iotest.child[i])) != 0){
-            perror("main:pthread_create()");
-            exit(EXIT_FAILURE);
-        }
+    if(iotest.cache_ra >= 0){
+	if((iotest.cache_ra_saved = (int *)malloc(sizeof(int) * iotest.ndev)) == NULL){
+	    perror("cache_setup:malloc()");
+	    iotest_exit(EXIT_FAILURE);
+	}
+	for(i=0; i<iotest.ndev; i++)
+	    iotest.cache_ra_saved[i] = cache_ra(i, iotest.cache_ra);
     }
-    
-    /*
-     * Thread termination
-     */
 
-    /* Wait for thread termination */
-    
-    for(i=0; i<iotest.nthr; i++){
-	if(VERBOSE4)
-	    printf("Waiting child thread[%d] to terminate.\n", i);
+    if(!iotest.cache_hit)
+	return;
 
-        pthread_join(iotest.child[i].thr_id, NULL);
+    iotest.cache_pgsiz = sysconf(_SC_PAGESIZE);
+    iotest.cache_map = (char **)malloc(sizeof(char *) * iotest.ndev);
+    iotest.cache_mapsiz = (unsigned long long *)malloc(sizeof(unsigned long long) * iotest.ndev);
+    if(iotest.cache_map == NULL || iotest.cache_mapsiz == NULL){
+	perror("cache_setup:malloc()");
+	iotest_exit(EXIT_FAILURE);
     }
-    gettimeofday(&(iotest.tv[1]), NULL);
-    
-    /* Show result */
-    
-    print_result();
+    for(i=0; i<iotest.ndev; i++){
+	iotest.cache_mapsiz[i] = getsize(iotest.dev[i].fname);
+	iotest.cache_map[i] = mmap(NULL, iotest.cache_mapsiz[i], PROT_READ, MAP_SHARED, iotest.fd[i], 0);
+	if(iotest.cache_map[i] == MAP_FAILED){
+	    perror("cache_setup:mmap()");
+	    iotest_exit(EXIT_FAILURE);
+	}
+    }
+}
 
+/*
+ * cache_restore(): restores readahead and unmaps devices
+ */
 
-    /* File close and meory release */
+static void cache_restore(void)
+{
+    int i;
 
-    for(i=0; i<iotest.ndev; i++)
-	close(iotest.dev[i].fd);
-    for(i=0; i<iotest.nthr; i++)
-	free(iotest.child[i].buf);
-    free(iotest.child);
+    /* In reverse, for targets on one block device: the first saved the
+       value before the run, and the others what it had set. */
+    if(iotest.cache_ra_saved){
+	for(i=iotest.ndev-1; i>=0; i--)
+	    if(iotest.cache_ra_saved[i] >= 0)
+		cache_ra(i, iotest.cache_ra_saved[i]);
+	free(iotest.cache_ra_saved);
+	iotest.cache_ra_saved = NULL;
+    }
+    if(iotest.cache_map){
+	for(i=0; i<iotest.ndev; i++)
+	    munmap(iotest.cache_map[i], iotest.cache_mapsiz[i]);
+	free(iotest.cache_map);
+	free(iotest.cache_mapsiz);
+	iotest.cache_map = NULL;
+    }
+}
 
-    return(EXIT_SUCCESS);
+/*
+ * cache_ra(): sets readahead [KiB] of a device, or of the device under a
+ * file, and returns the previous value, or -1 if it cannot be set. Linux
+ * has no per-fd readahead size; it is set on the block device.
+ */
+
+static int cache_ra(int devid, int kb)
+{
+    int old = -1;
+#ifdef __linux__
+    struct stat st;
+    char path[PATH_MAX];
+    FILE *fp;
+
+    if(fstat(iotest.fd[devid], &st) != 0)
+	return(-1);
+
+    if(S_ISBLK(st.st_mode)){
+	unsigned long sectors;
+	if(ioctl(iotest.fd[devid], BLKRAGET, &sectors) == 0)
+	    old = sectors / 2;
+	if(ioctl(iotest.fd[devid], BLKRASET, (unsigned long)kb * 2) != 0){
+	    perror("cache_ra:ioctl(BLKRASET)");
+	    return(-1);
+	}
+	return(old);
+    }
+
+    snprintf(path, sizeof(path), "/sys/dev/block/%u:%u/queue/read_ahead_kb",
+	     major(st.st_dev), minor(st.st_dev));
+    if(access(path, F_OK) != 0)
+	snprintf(path, sizeof(path), "/sys/dev/block/%u:%u/../queue/read_ahead_kb",
+		 major(st.st_dev), minor(st.st_dev));
+    if((fp = fopen(path, "r")) != NULL){
+	if(fscanf(fp, "%d", &old) != 1)
+	    old = -1;
+	fclose(fp);
+    }
+    if((fp = fopen(path, "w")) == NULL || fprintf(fp, "%d\n", kb) < 0 || fclose(fp) != 0){
+	fprintf(stderr, "Warning: Readahead of the device under %s cannot be set.\n",
+		iotest.dev[devid].fname);
+	return(-1);
+    }
+#endif
+    return(old);
 }
 
 /*
- *
- * Subroutines
- *
+ * cache_evict(): evicts cached pages of the devices before a run
  */
 
-static void *thread_handler(void *arg)
+static void cache_evict(void)
 {
-    struct iotest_thr_t *thr = (struct iotest_thr_t *)arg;
-    int id = thr->id;
+    int i;
 
-    if(iotest.naio)
-	disktest_libaio(id);
-    else
-	disktest(id);
+    for(i=0; i<iotest.ndev; i++){
+	int fd = iotest.fd[i];
+	struct stat st;
 
-    
-    return(NULL);
+	/* Dirty pages are not dropped; write them back first. */
+	fdatasync(fd);
+	if((errno = posix_fadvise(fd, 0, 0, POSIX_FADV_DONTNEED)) != 0)
+	    perror("cache_evict:posix_fadvise()");
+#ifdef __linux__
+	if(fstat(fd, &st) == 0 && S_ISBLK(st.st_mode) && ioctl(fd, BLKFLSBUF, 0) != 0)
+	    perror("cache_evict:ioctl(BLKFLSBUF)");
+#endif
+    }
+
+    if(iotest.cache_drop == CACHE_DROP_ALL){
+	FILE *fp;
+	sync();
+	if((fp = fopen("/proc/sys/vm/drop_caches", "w")) == NULL ||
+	   fputs("1\n", fp) < 0 || fclose(fp) != 0)
+	    fprintf(stderr, "Warning: Page cache cannot be dropped system-wide. Dropped per file.\n");
+    }
 }
 
-static void disktest(int id)
+/*
+ * cache_residency(): returns the percentage of the access range resident
+ * in page cache
+ */
+
+static double cache_residency(void)
 {
     int i;
-    struct iotest_thr_t *thr;
+    unsigned long long pg = sysconf(_SC_PAGESIZE), n = 0, hit = 0;
+    unsigned long long chunk = (unsigned long long)GIBI;
+    unsigned char *vec;
 
-    thr = &(iotest.child[id]);
-    
-    /*
-     * Begin
-     */
-    
-    if(VERBOSE4)
-	printf("TH[%d] starts.\n", id);
+    if((vec = (unsigned char *)malloc(chunk / pg)) == NULL){
+	perror("cache_residency:malloc()");
+	iotest_exit(EXIT_FAILURE);
+    }
+    for(i=0; i<iotest.ndev; i++){
+	unsigned long long a = (unsigned long long)iotest.ofst0 * iotest.blksiz / pg * pg;
+	unsigned long long e = (unsigned long long)iotest.ofst1 * iotest.blksiz;
+	if(e > iotest.cache_mapsiz[i])
+	    e = iotest.cache_mapsiz[i];
+	for(; a < e; a += chunk){
+	    unsigned long long len = e - a < chunk ? e - a : chunk, k;
+	    if(mincore(iotest.cache_map[i] + a, len, vec) != 0)
+		break;
+	    for(k=0; k<(len + pg - 1) / pg; k++)
+		hit += vec[k] & 1;
+	    n += (len + pg - 1) / pg;
+	}
+    }
+    free(vec);
 
-    gettimeofday(&(thr->tv[0]), NULL);
+    return(n ? (double)hit * 100 / n : 0);
+}
 
-    /*
-     * Loop
-     */
+/*
+ * stat_open(): creates the live statistics segment and starts publishing
+ */
 
-    for(i=0; i<iotest.nio; i++){
-	int nread;
-	int devid;
-	unsigned long long ofst;
-	struct timeval tv[2];
-	
-	if(i==0){
-	    if(IS_RANDOM)
-		srand(time(0) + id * 13);
-	}
-	
-	if(IS_RANDOM){
-	    ofst = (unsigned long long)iotest.ofst0;
-	    ofst += (unsigned long long)((unsigned long long)iotest.ofst1-(unsigned long long)iotest.ofst0)*rand()/(RAND_MAX+1.0);
-	    ofst *=  iotest.blksiz;
-	}else{
-	    ofst = (iotest.ofst0 + i) * iotest.blksiz;
-	}
+static void stat_open(void)
+{
+    struct iotest_stat_hdr_t *h;
+    char name[NAME_MAX];
+    size_t size = IOTEST_STAT_SIZE(iotest.mxnthr, iotest.ndev);
+    int fd, i;
+
+    snprintf(name, sizeof(name), "%s%s", iotest.stat_name[0] == '/' ? "" : "/", iotest.stat_name);
+    if((fd = shm_open(name, O_CREAT | O_RDWR | O_TRUNC, 0644)) < 0){
+	perror("stat_open:shm_open()");
+	iotest_exit(EXIT_FAILURE);
+    }
+    if(ftruncate(fd, size) != 0){
+	perror("stat_open:ftruncate()");
+	iotest_exit(EXIT_FAILURE);
+    }
+    if((h = mmap(NULL, size, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0)) == MAP_FAILED){
+	perror("stat_open:mmap()");
+	iotest_exit(EXIT_FAILURE);
+    }
+    close(fd);
 
-	if(IS_RANDOM)
-	    devid = (int)(((double)iotest.ndev)*rand()/(RAND_MAX+1.0));
-	else
-	    devid = thr->id % iotest.ndev;
-
-	gettimeofday(&tv[0], NULL);
-	    nread = iotest_pread(iotest.dev[devid].fd, thr->buf, 4096, (unsigned long long)1024*1000*1000*1000*1);
-	    nread = iotest_pread(iotest.dev[devid].fd, thr->buf, 4096, (unsigned long long)1024*1000*1000*1000*2);
-	    nread = iotest_pread(iotest.dev[devid].fd, thr->buf, 4096, (unsigned long long)1024*1000*1000*1000*3);
-	    nread = iotest_pread(iotest.dev[devid].fd, thr->buf, 4096, (unsigned long long)1024*1000*1000*1000*4);
-	    nread = iotest_pread(iotest.dev[devid].fd, thr->buf, 4096, (unsigned long long)1024*1000*1000*1000*5);
-	exit(0);
-	if(IS_READ)
-	    nread = iotest_pread(iotest.dev[devid].fd, thr->buf, iotest.blksiz, ofst);
-	else
-	    nread = iotest_pwrite(iotest.dev[devid].fd, thr->buf, iotest.blksiz, ofst);
-	gettimeofday(&tv[1], NULL);
-
-	TIMEVAL_SUB(tv[1], tv[0]);
-	thr->acciotim += TIMEVAL2DOUBLE(tv[1]);
-	if(thr->mxiotim < TIMEVAL2DOUBLE(tv[1]))
-	    thr->mxiotim = TIMEVAL2DOUBLE(tv[1]);
-	thr->nio++;
-	iotest.dev[devid].acciotim += TIMEVAL2DOUBLE(tv[1]);
-	if(iotest.dev[devid].mxiotim < TIMEVAL2DOUBLE(tv[1]))
-	    iotest.dev[devid].mxiotim = TIMEVAL2DOUBLE(tv[1]);
-	iotest.dev[devid].nio++;
-	
-    } /* for(i) */
-    
-    /*
-     * Finish
-     */
+    h->size = size;
+    h->nthr = iotest.mxnthr;
+    h->ndev = iotest.ndev;
+    h->hist_nbucket = HIST_NBUCKET;
+    h->interval = iotest.stat_int;
+    h->pid = getpid();
+    for(i=0; i<iotest.mxnthr; i++)
+	snprintf(IOTEST_STAT_THR(h, i)->name, sizeof(IOTEST_STAT_THR(h, i)->name), "thread %d", i);
+    for(i=0; i<iotest.ndev; i++)
+	snprintf(IOTEST_STAT_DEV(h, i)->name, sizeof(IOTEST_STAT_DEV(h, i)->name), "%s", iotest.dev[i].fname);
+    h->state = IOTEST_STAT_RUNNING;
+    h->version = IOTEST_STAT_VERSION;
+    __sync_synchronize();
+    /* Viewers take the segment as valid once the magic is set. */
+    h->magic = IOTEST_STAT_MAGIC;
+
+    iotest.stat = h;
+    stat_publish();
+    if((i = pthread_create(&(iotest.stat_thr), NULL, stat_publisher, (void *)&iotest)) != 0){
+	errno = i;
+	perror("stat_open:pthread_create()");
+	iotest_exit(EXIT_FAILURE);
+    }
+}
 
-    gettimeofday(&(thr->tv[1]), NULL);
+/*
+ * stat_close(): publishes the final counters and removes the segment;
+ * attached viewers keep their mapping and see it done
+ */
 
-    if(VERBOSE4)
-	printf("TH[%d] ends.\n", id);
+static void stat_close(void)
+{
+    iotest.stat_quit = 1;
+    pthread_join(iotest.stat_thr, NULL);
+    stat_publish();
+    iotest.stat->state = IOTEST_STAT_DONE;
+
+    stat_unlink();
+    munmap(iotest.stat, iotest.stat->size);
+    iotest.stat = NULL;
+}
+
+/*
+ * stat_unlink(): removes the name of the segment
+ */
+
+static void stat_unlink(void)
+{
+    char name[NAME_MAX];
+
+    snprintf(name, sizeof(name), "%s%s", iotest.stat_name[0] == '/' ? "" : "/", iotest.stat_name);
+    shm_unlink(name);
+}
+
+/*
+ * stat_publisher(): publishes the counters every stat_int ms, and stops
+ * the run when a viewer asks to
+ */
+
+static void *stat_publisher(void *arg)
+{
+    struct timespec req;
+
+    IOTEST_ENTER((struct iotest_t *)arg);
+    IOTEST_HELPER();
+
+    req.tv_sec = iotest.stat_int / 1000;
+    req.tv_nsec = (long)(iotest.stat_int % 1000) * MEGA;
+
+    while(!iotest.stat_quit){
+	nanosleep(&req, NULL);
+	stat_publish();
+	if(iotest.stat->stop)
+	    iotest.shm->is_stopping = 1;
+    }
+
+    return(NULL);
+}
+
+/*
+ * stat_publish(): copies the counters into the segment; readers retry
+ * while the sequence counter is odd or has moved
+ */
+
+static void stat_publish(void)
+{
+    struct iotest_stat_hdr_t *h = iotest.stat;
+    int i;
+
+    h->seq++;
+    __sync_synchronize();
+
+    h->run = iotest.nrun;
+    h->ts = iotest_clock();
+    for(i=0; i<iotest.mxnthr; i++){
+	struct iotest_thr_t *thr = &(iotest.child[i]);
+	struct iotest_stat_ent_t *e = IOTEST_STAT_THR(h, i);
+	e->nio = thr->nio;
+	e->nbyte = thr->nbyte;
+	e->acciotim = thr->acciotim;
+	e->mxiotim = thr->mxiotim;
+	memcpy(IOTEST_STAT_HIST(h, i), thr->hist.cnt, sizeof(uint64_t) * HIST_NBUCKET);
+    }
+    for(i=0; i<iotest.ndev; i++){
+	struct iotest_dev_t *dev = &(iotest.dev[i]);
+	struct iotest_stat_ent_t *e = IOTEST_STAT_DEV(h, i);
+	e->nio = dev->nio;
+	e->nbyte = dev->nbyte;
+	e->acciotim = dev->acciotim;
+	e->mxiotim = dev->mxiotim;
+    }
+
+    __sync_synchronize();
+    h->seq++;
+}
+
+/*
+ * coord_open(): connects to the coordinator (-z) and introduces the run
+ */
+
+static void coord_open(void)
+{
+    int fd;
+
+    if(iotest.coord_path){
+	struct sockaddr_un sa;
+
+	memset(&sa, 0, sizeof(sa));
+	sa.sun_family = AF_UNIX;
+	if(strlen(iotest.coord_path) >= sizeof(sa.sun_path)){
+	    fprintf(stderr, "Error: Path of the coordinator is too long, %s.\n", iotest.coord_path);
+	    iotest_exit(EXIT_FAILURE);
+	}
+	strcpy(sa.sun_path, iotest.coord_path);
+	if((fd = socket(AF_UNIX, SOCK_STREAM, 0)) < 0){
+	    perror("coord_open:socket()");
+	    iotest_exit(EXIT_FAILURE);
+	}
+	if(connect(fd, (struct sockaddr *)&sa, sizeof(sa)) != 0){
+	    perror("coord_open:connect()");
+	    close(fd);
+	    iotest_exit(EXIT_FAILURE);
+	}
+    }else{
+	struct sockaddr_in sa;
+	int one = 1;
+
+	memset(&sa, 0, sizeof(sa));
+	sa.sin_family = AF_INET;
+	sa.sin_port = htons(iotest.coord_port);
+	sa.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+	if((fd = socket(AF_INET, SOCK_STREAM, 0)) < 0){
+	    perror("coord_open:socket()");
+	    iotest_exit(EXIT_FAILURE);
+	}
+	if(connect(fd, (struct sockaddr *)&sa, sizeof(sa)) != 0){
+	    perror("coord_open:connect()");
+	    close(fd);
+	    iotest_exit(EXIT_FAILURE);
+	}
+	setsockopt(fd, IPPROTO_TCP, TCP_NODELAY, &one, sizeof(one));
+    }
+    iotest.coord_fd = fd;
+
+    if((iotest.coord_hist = (uint64_t *)malloc(sizeof(uint64_t) * HIST_NBUCKET)) == NULL){
+	perror("coord_open:malloc()");
+	iotest_exit(EXIT_FAILURE);
+    }
+    if(coord_send(IOTEST_COORD_HELLO) != 0){
+	perror("coord_open:send()");
+	iotest_exit(EXIT_FAILURE);
+    }
+}
+
+/*
+ * coord_close(): disconnects from the coordinator
+ */
+
+static void coord_close(void)
+{
+    close(iotest.coord_fd);
+    iotest.coord_fd = -1;
+    free(iotest.coord_hist);
+    iotest.coord_hist = NULL;
+}
+
+/*
+ * coord_start(): tells the coordinator that the workers are at the start
+ * barrier, and waits for the start time it sends back
+ */
+
+static void coord_start(void)
+{
+    struct iotest_coord_msg_t msg;
+    int type;
+
+    iotest.coord_int = 0;
+    while(iotest.shm->nready < iotest.nthr && !iotest.shm->is_stopping)
+	usleep(100);
+    if(coord_send(IOTEST_COORD_READY) != 0){
+	coord_lost();
+	return;
+    }
+
+    while((type = coord_recv(&msg, 100)) != IOTEST_COORD_START){
+	if(type < 0){
+	    coord_lost();
+	    return;
+	}
+	if(type == IOTEST_COORD_STOP)
+	    iotest.shm->is_stopping = 1;
+	if(iotest.shm->is_stopping)
+	    return;
+    }
+    iotest.coord_int = msg.interval;
+
+    /* The start time is of the raw clock, which iotest_now() may not be. */
+    iotest_wait_until(msg.ts - (iotest_clock() - iotest_now()));
+    iotest.coord_go = iotest_clock();
+}
+
+/*
+ * coord_stat(): sends the counters so far to the coordinator, and stops
+ * the run when it asks to
+ */
+
+static void coord_stat(void)
+{
+    struct iotest_coord_msg_t msg;
+    int type;
+
+    if(iotest.coord_fd < 0)
+	return;
+    if(coord_send(IOTEST_COORD_STAT) != 0){
+	coord_lost();
+	return;
+    }
+    while((type = coord_recv(&msg, 0)) > 0)
+	if(type == IOTEST_COORD_STOP)
+	    iotest.shm->is_stopping = 1;
+    if(type < 0)
+	coord_lost();
+}
+
+/*
+ * coord_send(): sends a message of the type to the coordinator, with the
+ * counters and histogram of all the threads for STAT and FINAL
+ */
+
+static int coord_send(int type)
+{
+    struct iotest_coord_msg_t msg;
+    unsigned long long off = iotest_clock() - iotest_now();
+    int i, k, is_stat = type == IOTEST_COORD_STAT || type == IOTEST_COORD_FINAL;
+
+    memset(&msg, 0, sizeof(msg));
+    msg.magic = IOTEST_COORD_MAGIC;
+    msg.type = type;
+    msg.pid = getpid();
+    msg.nthr = iotest.nthr;
+    msg.ndev = iotest.ndev;
+    msg.interval = iotest.coord_int;
+    msg.ts = iotest_clock();
+    msg.go = iotest.coord_go;
+    if(iotest.coord_name)
+	snprintf(msg.tot.name, sizeof(msg.tot.name), "%s", iotest.coord_name);
+    else
+	snprintf(msg.tot.name, sizeof(msg.tot.name), "iotest.%d", (int)getpid());
+
+    if(is_stat){
+	memset(iotest.coord_hist, 0, sizeof(uint64_t) * HIST_NBUCKET);
+	for(i=0; i<iotest.nthr; i++){
+	    struct iotest_thr_t *thr = &(iotest.child[i]);
+	    msg.tot.nio += thr->nio;
+	    msg.tot.nbyte += thr->nbyte;
+	    msg.tot.acciotim += thr->acciotim;
+	    if(msg.tot.mxiotim < thr->mxiotim)
+		msg.tot.mxiotim = thr->mxiotim;
+	    for(k=0; k<HIST_NBUCKET; k++)
+		iotest.coord_hist[k] += thr->hist.cnt[k];
+	}
+    }
+    if(type == IOTEST_COORD_FINAL){
+	msg.ts0 = iotest.ts[0] + off;
+	msg.ts1 = iotest.ts[1] + off;
+    }
+
+    if(coord_write(&msg, sizeof(msg)) != 0)
+	return(-1);
+    if(is_stat && coord_write(iotest.coord_hist, sizeof(uint64_t) * HIST_NBUCKET) != 0)
+	return(-1);
+    return(0);
+}
+
+/*
+ * coord_write(): writes all of a buffer to the coordinator
+ */
+
+static int coord_write(void *buf, size_t len)
+{
+    char *p = (char *)buf;
+    ssize_t n;
+
+    while(len > 0){
+	if((n = send(iotest.coord_fd, p, len, MSG_NOSIGNAL)) < 0){
+	    if(errno == EINTR)
+		continue;
+	    return(-1);
+	}
+	p += n;
+	len -= n;
+    }
+    return(0);
+}
+
+/*
+ * coord_recv(): reads a message from the coordinator, waiting up to ms
+ * (or not at all); returns its type, 0 if none, or -1 if it is gone
+ */
+
+static int coord_recv(struct iotest_coord_msg_t *msg, int ms)
+{
+    struct pollfd pfd;
+
+    pfd.fd = iotest.coord_fd;
+    pfd.events = POLLIN;
+    if(poll(&pfd, 1, ms) <= 0)
+	return(0);
+    if(recv(iotest.coord_fd, msg, sizeof(*msg), MSG_WAITALL) != sizeof(*msg) ||
+       msg->magic != IOTEST_COORD_MAGIC)
+	return(-1);
+    return(msg->type);
+}
+
+/*
+ * coord_lost(): goes on without the coordinator
+ */
+
+static void coord_lost(void)
+{
+    fprintf(stderr, "Warning: Coordinator is gone. The run goes on by itself.\n");
+    close(iotest.coord_fd);
+    iotest.coord_fd = -1;
+}
+
+/*
+ * tick_start(): starts a helper thread calling fn every ms during a run
+ */
+
+static void tick_start(struct iotest_tick_t *t, int ms, void (*fn)(void))
+{
+    pthread_condattr_t attr;
+    int i;
+
+    pthread_mutex_init(&(t->mtx), NULL);
+    pthread_condattr_init(&attr);
+    pthread_condattr_setclock(&attr, CLOCK_MONOTONIC);
+    pthread_cond_init(&(t->cond), &attr);
+    pthread_condattr_destroy(&attr);
+
+    t->ctx = &iotest;
+    t->ms = ms;
+    t->fn = fn;
+    t->quit = 0;
+    if((i = pthread_create(&(t->thr), NULL, tick_handler, (void *)t)) != 0){
+	errno = i;
+	perror("tick_start:pthread_create()");
+	iotest_exit(EXIT_FAILURE);
+    }
+}
+
+/*
+ * tick_stop(): wakes the helper thread up and joins it
+ */
+
+static void tick_stop(struct iotest_tick_t *t)
+{
+    pthread_mutex_lock(&(t->mtx));
+    t->quit = 1;
+    pthread_cond_signal(&(t->cond));
+    pthread_mutex_unlock(&(t->mtx));
+    pthread_join(t->thr, NULL);
+    pthread_cond_destroy(&(t->cond));
+    pthread_mutex_destroy(&(t->mtx));
+}
+
+/*
+ * tick_handler(): body of the helper thread, which calls fn on a fixed
+ * schedule rather than sleeping a fixed time after each call
+ */
+
+static void *tick_handler(void *arg)
+{
+    struct iotest_tick_t *t = (struct iotest_tick_t *)arg;
+    struct timespec ts;
+
+    IOTEST_ENTER(t->ctx);
+    IOTEST_HELPER();
+
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    pthread_mutex_lock(&(t->mtx));
+    while(!t->quit){
+	ts.tv_sec += t->ms / 1000;
+	ts.tv_nsec += (long)(t->ms % 1000) * MEGA;
+	if(ts.tv_nsec >= GIGA){
+	    ts.tv_sec++;
+	    ts.tv_nsec -= GIGA;
+	}
+	if(pthread_cond_timedwait(&(t->cond), &(t->mtx), &ts) == ETIMEDOUT)
+	    t->fn();
+    }
+    pthread_mutex_unlock(&(t->mtx));
+
+    return(NULL);
+}
+
+/*
+ * heat_start(): takes the first heatmap sample at the start of the run,
+ * and starts sampling every heat_int ms
+ */
+
+static void heat_start(void)
+{
+    heat_sample();
+    tick_start(&(iotest.heat_tick), iotest.heat_int, heat_sample);
+}
+
+/*
+ * heat_stop(): stops sampling, and takes the last sample at the end of
+ * the run; a last interval shorter than half of heat_int is merged into
+ * the previous one
+ */
+
+static void heat_stop(void)
+{
+    int ncell = iotest.ndev * iotest.heat_nregion, n, k;
+
+    tick_stop(&(iotest.heat_tick));
+    heat_sample();
+
+    n = iotest.heat_nsnap;
+    if(n > 2 && (iotest.heat_ts[n-1] - iotest.heat_ts[n-2]) * 2 <
+       (unsigned long long)iotest.heat_int * MEGA){
+	struct iotest_heat_t *c = iotest.heat + (size_t)(n - 1) * ncell, *p = c - ncell;
+	for(k=0; k<ncell; k++){
+	    if(c[k].mxiotim < p[k].mxiotim)
+		c[k].mxiotim = p[k].mxiotim;
+	    p[k] = c[k];
+	}
+	iotest.heat_ts[n-2] = iotest.heat_ts[n-1];
+	iotest.heat_nsnap--;
+    }
+}
+
+/*
+ * heat_sample(): appends the sums of the cells of all threads; the
+ * maximum response time is that of the interval, taken and cleared
+ */
+
+static void heat_sample(void)
+{
+    int ncell = iotest.ndev * iotest.heat_nregion, i, k;
+    struct iotest_heat_t *s;
+
+    if(iotest.heat_nsnap == iotest.heat_mxsnap){
+	int n = iotest.heat_mxsnap ? iotest.heat_mxsnap * 2 : 64;
+	struct iotest_heat_t *heat;
+	unsigned long long *ts;
+
+	if((heat = (struct iotest_heat_t *)
+	    realloc(iotest.heat, sizeof(struct iotest_heat_t) * ncell * n)) == NULL){
+	    perror("heat_sample:realloc()");
+	    iotest_exit(EXIT_FAILURE);
+	}
+	iotest.heat = heat;
+	if((ts = (unsigned long long *)
+	    realloc(iotest.heat_ts, sizeof(unsigned long long) * n)) == NULL){
+	    perror("heat_sample:realloc()");
+	    iotest_exit(EXIT_FAILURE);
+	}
+	iotest.heat_ts = ts;
+	iotest.heat_mxsnap = n;
+    }
+
+    s = iotest.heat + (size_t)iotest.heat_nsnap * ncell;
+    memset(s, 0, sizeof(struct iotest_heat_t) * ncell);
+    for(i=0; i<iotest.nthr; i++){
+	struct iotest_heat_t *c = iotest.child[i].heat;
+	for(k=0; k<ncell; k++){
+	    unsigned long long mx = __sync_lock_test_and_set(&(c[k].mxiotim), 0);
+	    s[k].nio += c[k].nio;
+	    s[k].nbyte += c[k].nbyte;
+	    s[k].acciotim += c[k].acciotim;
+	    if(s[k].mxiotim < mx)
+		s[k].mxiotim = mx;
+	}
+    }
+    iotest.heat_ts[iotest.heat_nsnap++] = iotest_now();
+}
+
+/*
+ * chk_write(): saves a checkpoint during the run
+ */
+
+static void chk_write(void)
+{
+    chk_save(0);
+}
+
+/*
+ * chk_save(): writes the cumulative stats and the non-empty buckets of
+ * the histograms of the threads to a temporary file, and renames it to
+ * the checkpoint file, so that a crash leaves the previous one intact
+ */
+
+static void chk_save(int is_final)
+{
+    char tmp[PATH_MAX], wall[64];
+    unsigned long long nio = 0, nbyte = 0, acciotim = 0, mxiotim = 0, t1;
+    struct iotest_hist_t *h;
+    struct timespec rt;
+    double elapsed;
+    FILE *fp;
+    int i, k;
+
+    if((h = (struct iotest_hist_t *)calloc(1, sizeof(struct iotest_hist_t))) == NULL){
+	perror("chk_save:calloc()");
+	iotest_exit(EXIT_FAILURE);
+    }
+    for(i=0; i<iotest.nthr; i++){
+	struct iotest_thr_t *thr = &(iotest.child[i]);
+	nio += thr->nio;
+	nbyte += thr->nbyte;
+	acciotim += thr->acciotim;
+	if(mxiotim < thr->mxiotim)
+	    mxiotim = thr->mxiotim;
+	hist_merge(h, &(thr->hist));
+    }
+    t1 = is_final ? iotest.ts[1] : iotest_now();
+    elapsed = t1 > iotest.ts[0] ? NSEC2DOUBLE(t1 - iotest.ts[0]) : 0;
+    clock_gettime(CLOCK_REALTIME, &rt);
+    strftime(wall, sizeof(wall), "%Y-%m-%d %H:%M:%S", localtime(&(rt.tv_sec)));
+
+    snprintf(tmp, sizeof(tmp), "%s.tmp", iotest.chk_file);
+    if((fp = fopen(tmp, "w")) == NULL){
+	perror("chk_save:fopen()");
+	iotest_exit(EXIT_FAILURE);
+    }
+    fprintf(fp, "# iotest checkpoint\n");
+    fprintf(fp, "  Run                  : %d (%s%s)\n", iotest.nrun,
+	    !is_final ? "running" : iotest.stop_signo ? "stopped by " : "done",
+	    is_final && iotest.stop_signo ? strsignal(iotest.stop_signo) : "");
+    fprintf(fp, "  Saved at             : %s\n", wall);
+    fprintf(fp, "  Exec. time           : %12.3f [s]\n", elapsed);
+    fprintf(fp, "  Number of I/Os       : %12llu [block] %12llu [byte]\n", nio, nbyte);
+    fprintf(fp, "  Total throughput     : %12.3f [block/s] %12.3f [MB/s]\n",
+	    elapsed > 0 ? nio / elapsed : 0.0, elapsed > 0 ? nbyte / elapsed / MEGA : 0.0);
+    fprintf(fp, "  Avg. Resp. time      : %12.6f [ms/block]\n",
+	    nio ? NSEC2MSEC(acciotim) / nio : 0.0);
+    fprintf(fp, "  Max. Resp. time      : %12.6f [ms/block]\n", NSEC2MSEC(mxiotim));
+    fprintf(fp, "  Resp. time pctl.     : %12.6f %12.6f %12.6f [ms/block] (50%%, 99%%, 99.9%%)\n",
+	    NSEC2MSEC(iotest_hist_percentile(h->cnt, NULL, 50)),
+	    NSEC2MSEC(iotest_hist_percentile(h->cnt, NULL, 99)),
+	    NSEC2MSEC(iotest_hist_percentile(h->cnt, NULL, 99.9)));
+
+    fprintf(fp, "# %-6s %-24s %20s %20s %20s %20s\n",
+	    "", "", "nio", "nbyte", "acciotim [ns]", "mxiotim [ns]");
+    for(i=0; i<iotest.nthr; i++){
+	struct iotest_thr_t *thr = &(iotest.child[i]);
+	fprintf(fp, "  thread %-24d %20llu %20llu %20llu %20llu\n",
+		i, thr->nio, thr->nbyte, thr->acciotim, thr->mxiotim);
+    }
+    for(i=0; i<iotest.ndev; i++){
+	struct iotest_dev_t *dev = &(iotest.dev[i]);
+	fprintf(fp, "  device %-24.24s %20llu %20llu %20llu %20llu\n",
+		dev->fname, dev->nio, dev->nbyte, dev->acciotim, dev->mxiotim);
+    }
+    fprintf(fp, "# %-6s %-24s %20s %20s\n", "", "", "bucket [ns]", "count");
+    for(i=0; i<iotest.nthr; i++)
+	for(k=0; k<HIST_NBUCKET; k++)
+	    if(iotest.child[i].hist.cnt[k])
+		fprintf(fp, "  hist   %-24d %20llu %20llu\n",
+			i, iotest_hist_value(k), (unsigned long long)iotest.child[i].hist.cnt[k]);
+    free(h);
+
+    if(fflush(fp) != 0 || fsync(fileno(fp)) != 0){
+	perror("chk_save:fsync()");
+	iotest_exit(EXIT_FAILURE);
+    }
+    fclose(fp);
+    if(rename(tmp, iotest.chk_file) != 0){
+	perror("chk_save:rename()");
+	iotest_exit(EXIT_FAILURE);
+    }
+}
+
+/*
+ * shm_alloc(): allocates zero-filled memory shared with worker processes
+ */
+
+static void *shm_alloc(size_t size)
+{
+    void *p;
+
+    p = mmap(NULL, size, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_ANONYMOUS, -1, 0);
+    if(p == MAP_FAILED){
+	perror("shm_alloc:mmap()");
+	iotest_exit(EXIT_FAILURE);
+    }
+
+    return(p);
+}
+
+static void shm_free(void *p, size_t size)
+{
+    munmap(p, size);
+}
+
+/*
+ * prepare(): creates and preallocates target files, and fills them with
+ * large sequential writes in parallel, optionally followed by a random
+ * overwrite pass of -b blocks for SSD preconditioning
+ */
+
+static void prepare(void)
+{
+    int i;
+
+    if((iotest.prep_fd = (int *)malloc(sizeof(int) * iotest.ndev)) == NULL ||
+       (iotest.prep_bfd = (int *)malloc(sizeof(int) * iotest.ndev)) == NULL ||
+       (iotest.prep_devsiz = (unsigned long long *)malloc(sizeof(unsigned long long) * iotest.ndev)) == NULL ||
+       (iotest.prep_first = (unsigned long long *)malloc(sizeof(unsigned long long) * (iotest.ndev + 1))) == NULL){
+	perror("prepare:malloc()");
+	iotest_exit(EXIT_FAILURE);
+    }
+
+    /* Each target has its own size, unless given by size= or -e. */
+    for(i=0; i<iotest.ndev; i++){
+	struct stat st;
+	int fd;
+	unsigned long long size = iotest.prep_size;
+
+	if(!size && iotest.ofst1)
+	    size = (unsigned long long)iotest.ofst1 * iotest.blksiz;
+
+	if((fd = open(iotest.dev[i].fname, O_RDWR | O_CREAT, 0644)) < 0){
+	    perror("prepare:open()");
+	    iotest_exit(EXIT_FAILURE);
+	}
+	if(fstat(fd, &st) != 0){
+	    perror("prepare:fstat()");
+	    iotest_exit(EXIT_FAILURE);
+	}
+
+	if(S_ISREG(st.st_mode)){
+	    if(!size)
+		size = st.st_size;
+	    if(!size){
+		fprintf(stderr, "Error: Size of %s is unknown. Please specify it by -P size=<n> or -e.\n",
+			iotest.dev[i].fname);
+		iotest_exit(EXIT_FAILURE);
+	    }
+	    if((errno = posix_fallocate(fd, 0, size)) != 0){
+		perror("prepare:posix_fallocate()");
+		iotest_exit(EXIT_FAILURE);
+	    }
+	    if(VERBOSE1)
+		printf("Prepare: %s allocated, %llu [Byte]\n", iotest.dev[i].fname, size);
+	}
+	close(fd);
+
+	if(!size)
+	    size = getsize(iotest.dev[i].fname);
+	iotest.prep_devsiz[i] = size;
+
+	/* Fill with O_DIRECT, unless the file system refuses it; writes
+	   it cannot take, such as the tail of an odd size, are buffered. */
+	if((fd = open(iotest.dev[i].fname, O_WRONLY)) < 0){
+	    perror("prepare:open()");
+	    iotest_exit(EXIT_FAILURE);
+	}
+	iotest.prep_bfd[i] = fd;
+#ifdef __linux__
+	fd = open(iotest.dev[i].fname, O_WRONLY | O_DIRECT);
+#else
+	fd = -1;
+#endif
+	iotest.prep_fd[i] = fd >= 0 ? fd : iotest.prep_bfd[i];
+    }
+
+    if(iotest.prep >= PREP_FILL)
+	prepare_pass(PREP_PASS_FILL);
+    if(iotest.prep >= PREP_FULL)
+	prepare_pass(PREP_PASS_RAND);
+
+    for(i=0; i<iotest.ndev; i++){
+	if(iotest.prep >= PREP_FILL && !IS_NONOP && fsync(iotest.prep_bfd[i]) != 0){
+	    perror("prepare:fsync()");
+	    iotest_exit(EXIT_FAILURE);
+	}
+	if(iotest.prep_fd[i] != iotest.prep_bfd[i])
+	    close(iotest.prep_fd[i]);
+	close(iotest.prep_bfd[i]);
+    }
+    free(iotest.prep_fd);
+    free(iotest.prep_bfd);
+    free(iotest.prep_devsiz);
+    free(iotest.prep_first);
+}
+
+/*
+ * prepare_pass(): runs one pass with iotest.nthr threads, showing progress
+ */
+
+static void prepare_pass(int pass)
+{
+    int i, n, nthr = iotest.nthr;
+    pthread_t *thr;
+    unsigned long long t0, t1;
+    struct timespec req = { 0, 100 * MEGA };
+    unsigned long long nbyte = 0;
+
+    /* Chunks of the devices are numbered one after another. */
+    iotest.prep_first[0] = 0;
+    for(i=0; i<iotest.ndev; i++){
+	unsigned long long size = iotest.prep_devsiz[i];
+	if(pass == PREP_PASS_FILL){
+	    iotest.prep_first[i+1] = iotest.prep_first[i] + (size + iotest.prep_chunk - 1) / iotest.prep_chunk;
+	    nbyte += size;
+	}else{
+	    iotest.prep_first[i+1] = iotest.prep_first[i] + size / iotest.blksiz;
+	    nbyte += size / iotest.blksiz * iotest.blksiz;
+	}
+    }
+    iotest.prep_total = iotest.prep_first[iotest.ndev];
+    iotest.prep_pass = pass;
+    iotest.prep_next = 0;
+    iotest.prep_done = 0;
+    iotest.prep_id = 0;
+
+    if((thr = (pthread_t *)malloc(sizeof(pthread_t) * nthr)) == NULL){
+	perror("prepare_pass:malloc()");
+	iotest_exit(EXIT_FAILURE);
+    }
+
+    t0 = iotest_now();
+    for(i=0; i<nthr; i++)
+	if(pthread_create(&thr[i], NULL, prepare_handler, (void *)&iotest) != 0){
+	    perror("prepare_pass:pthread_create()");
+	    iotest_exit(EXIT_FAILURE);
+	}
+
+    /* Progress every second */
+    for(n=1; iotest.prep_next < iotest.prep_total; n++){
+	nanosleep(&req, NULL);
+	if(n % 10)
+	    continue;
+	fprintf(stderr, "\rPrepare: %s %5.1f%% %9.3f [MB/s]",
+		pass == PREP_PASS_FILL ? "fill     " : "overwrite",
+		(double)iotest.prep_done * 100 / (double)nbyte,
+		(double)iotest.prep_done / NSEC2DOUBLE(iotest_now() - t0) / MEGA);
+    }
+
+    for(i=0; i<nthr; i++)
+	pthread_join(thr[i], NULL);
+    t1 = iotest_now();
+    free(thr);
+    if(iotest.error)
+	iotest_exit(EXIT_FAILURE);
+
+    fprintf(stderr, "\rPrepare: %s %llu [MiB] in %.3f [s], %9.3f [MB/s]        \n",
+	    pass == PREP_PASS_FILL ? "fill     " : "overwrite",
+	    iotest.prep_done / MEBI, NSEC2DOUBLE(t1 - t0),
+	    (double)iotest.prep_done / NSEC2DOUBLE(t1 - t0) / MEGA);
+}
+
+static void *prepare_handler(void *arg)
+{
+    int id, size, devid = 0;
+    unsigned long long n, k, ofst;
+    unsigned int seed;
+    char *buf;
+    int i;
+
+    IOTEST_ENTER((struct iotest_t *)arg);
+    IOTEST_HELPER();
+    id = __sync_fetch_and_add(&(iotest.prep_id), 1);
+    size = iotest.prep_pass == PREP_PASS_FILL ? iotest.prep_chunk : iotest.blksiz;
+    seed = iotest_seed(id);
+
+    if((buf = (char *)valloc(size)) == NULL){
+	perror("prepare_handler:valloc()");
+	iotest_exit(EXIT_FAILURE);
+    }
+    /* Incompressible data */
+    for(i=0; i<size; i++)
+	buf[i] = (char)rand_r(&seed);
+
+    while((k = __sync_fetch_and_add(&(iotest.prep_next), 1)) < iotest.prep_total && !iotest.error){
+	int len = size;
+
+	/* Chunks are taken in order, so the device only moves forward. */
+	while(k >= iotest.prep_first[devid + 1])
+	    devid++;
+	n = iotest.prep_first[devid + 1] - iotest.prep_first[devid];
+	if(iotest.prep_pass == PREP_PASS_FILL){
+	    ofst = (k - iotest.prep_first[devid]) * size;
+	    if(ofst + len > iotest.prep_devsiz[devid])
+		len = iotest.prep_devsiz[devid] - ofst;
+	}else{
+	    ofst = (unsigned long long)(n * (rand_r(&seed) / (RAND_MAX + 1.0))) * size;
+	}
+	iotest_pwrite((ofst | len) & (PREP_ALIGN - 1) ? iotest.prep_bfd[devid] : iotest.prep_fd[devid],
+		      buf, len, ofst);
+	__sync_fetch_and_add(&(iotest.prep_done), len);
+    }
+
+    free(buf);
+    return(NULL);
+}
+
+/*
+ * parse_size(): parses a size with an optional suffix, k, m or g (in 1024)
+ */
+
+static unsigned long long parse_size(char *arg)
+{
+    char *end;
+    unsigned long long size = strtoull(arg, &end, 10);
+
+    switch(*end){
+    case 'k': case 'K':
+	return(size * KIBI);
+    case 'm': case 'M':
+	return(size * MEBI);
+    case 'g': case 'G':
+	return(size * GIBI);
+    case '\0':
+	return(size);
+    }
+    return(0);
+}
+
+/*
+ * run_test(): runs the configured workload once with iotest.nthr threads
+ */
+
+static void run_test(void)
+{
+    int i, is_coord = 0;
+
+    reset_result();
+    iotest.nrun++;
+
+    if(iotest.cache_drop)
+	cache_evict();
+    if(iotest.cache_hit)
+	iotest.cache_resident = cache_residency();
+
+    /* Workers are released together once all of them are set up. */
+    {
+	pthread_barrierattr_t attr;
+
+	pthread_barrierattr_init(&attr);
+	pthread_barrierattr_setpshared(&attr, PTHREAD_PROCESS_SHARED);
+	if((i = pthread_barrier_init(&(iotest.shm->barrier), &attr, iotest.nthr + 1)) != 0){
+	    errno = i;
+	    perror("run_test:pthread_barrier_init()");
+	    iotest_exit(EXIT_FAILURE);
+	}
+	pthread_barrierattr_destroy(&attr);
+    }
+    iotest.shm->is_measuring = !iotest.is_steady;
+    {
+	struct timespec rt;
+	clock_gettime(CLOCK_REALTIME, &rt);
+	iotest.rt0 = (unsigned long long)rt.tv_sec * GIGA + rt.tv_nsec - iotest_now();
+    }
+    /* A signal may have come in between runs. */
+    iotest.shm->is_stopping = iotest.stop_signo != 0;
+    iotest.shm->ckpt_active = 0;
+    iotest.shm->nready = 0;
+
+    if(iotest.pipe_s)
+	pipe_setup();
+
+    for(i=0; i<iotest.nthr; i++){
+	struct iotest_thr_t *thr = &(iotest.child[i]);
+	int r, n;
+
+	thr->ctx = &iotest;
+	thr->is_started = 0;
+	thr->blksiz = iotest.blksiz;
+	thr->rate = 0;
+	if(iotest.is_oltp)
+	    for(r=0, n=0; r<NROLE; r++){
+		n += iotest.oltp[r][0];
+		if(i < n){
+		    thr->role = r;
+		    thr->blksiz = iotest.oltp[r][1];
+		    thr->rate = iotest.oltp[r][2];
+		    break;
+		}
+	    }
+    }
+
+    for(i=0; i<iotest.nthr; i++){
+	
+        if(VERBOSE4)
+            printf("Invoking child thread[%d].\n", i);
+
+	iotest.child[i].id = i;
+	if(iotest.is_proc){
+	    pid_t pid;
+
+	    /* The slot is shared; only the parent may store the pid. */
+	    fflush(stdout);
+	    if((pid = fork()) < 0){
+		perror("run_test:fork()");
+		iotest_exit(EXIT_FAILURE);
+	    }
+	    if(pid == 0)
+		run_worker_proc(&(iotest.child[i]));
+	    iotest.child[i].pid = pid;
+	    continue;
+	}
+        if(pthread_create(&(iotest.child[i].thr_id), NULL, thread_handler, (void *)&(iotest.child[i])) != 0){
+            perror("run_test:pthread_create()");
+            iotest_exit(EXIT_FAILURE);
+        }
+    }
+
+    /* Under a coordinator, the workers at the barrier wait for its start. */
+    if(iotest.coord_fd >= 0)
+	coord_start();
+    pthread_barrier_wait(&(iotest.shm->barrier));
+    iotest.ts[0] = iotest_now();
+    if(iotest.coord_fd >= 0 && iotest.coord_int){
+	tick_start(&(iotest.coord_tick), iotest.coord_int, coord_stat);
+	is_coord = 1;
+    }
+    if(iotest.heat_nregion)
+	heat_start();
+    if(iotest.chk_file)
+	tick_start(&(iotest.chk_tick), iotest.chk_int * KILO, chk_write);
+
+    if(iotest.is_steady)
+	steady_state();
+
+    if(iotest.duration){
+	unsigned long long end = iotest.ts[0] + (unsigned long long)iotest.duration * GIGA;
+	unsigned long long now;
+	struct timespec req;
+	/* Wakes up at times to notice a stop asked by a viewer or the
+	   coordinator. */
+	while((now = iotest_now()) < end && !iotest.shm->is_stopping){
+	    if(end - now > DURATION_POLL){
+		req.tv_sec = DURATION_POLL / GIGA;
+		req.tv_nsec = DURATION_POLL % GIGA;
+	    }else{
+		req.tv_sec = (end - now) / GIGA;
+		req.tv_nsec = (end - now) % GIGA;
+	    }
+	    nanosleep(&req, NULL);
+	}
+	iotest.shm->is_stopping = 1;
+    }
+    
+    /* Wait for thread termination */
+    
+    for(i=0; i<iotest.nthr; i++){
+	if(VERBOSE4)
+	    printf("Waiting child thread[%d] to terminate.\n", i);
+
+	if(iotest.is_proc){
+	    int status;
+	    if(waitpid(iotest.child[i].pid, &status, 0) < 0){
+		perror("run_test:waitpid()");
+		iotest_exit(EXIT_FAILURE);
+	    }
+	    if((!WIFEXITED(status) || WEXITSTATUS(status) != EXIT_SUCCESS) && !iotest.error){
+		/* Kill the others, which may be blocked, and reap them
+		   before failing; SIGTERM only stops them at their next io. */
+		int j;
+		fprintf(stderr, "Error: Worker process[%d] failed.\n", i);
+		iotest.shm->is_stopping = 1;
+		for(j=i+1; j<iotest.nthr; j++)
+		    kill(iotest.child[j].pid, SIGKILL);
+		iotest.error = ECHILD;
+	    }
+	    continue;
+	}
+        pthread_join(iotest.child[i].thr_id, NULL);
+    }
+    iotest.ts[1] = iotest_now();
+
+    /* Main may not get a CPU until the workers are done, so the run spans
+       at least their first measured io to the end of the last one. */
+    {
+	unsigned long long ts1 = 0;
+	for(i=0; i<iotest.nthr; i++){
+	    if(iotest.child[i].ts[0] && iotest.child[i].ts[0] < iotest.ts[0])
+		iotest.ts[0] = iotest.child[i].ts[0];
+	    if(ts1 < iotest.child[i].ts[1])
+		ts1 = iotest.child[i].ts[1];
+	}
+	if(ts1 > iotest.ts[0])
+	    iotest.ts[1] = ts1;
+    }
+    if(iotest.heat_nregion)
+	heat_stop();
+    if(iotest.chk_file){
+	tick_stop(&(iotest.chk_tick));
+	chk_save(1);
+    }
+    if(is_coord)
+	tick_stop(&(iotest.coord_tick));
+    if(iotest.coord_fd >= 0 && !iotest.error && coord_send(IOTEST_COORD_FINAL) != 0)
+	coord_lost();
+
+    if(iotest.pipe_s)
+	pipe_teardown();
+
+    /* A killed worker may never leave the barrier, which destroy would
+       wait for. */
+    if(!iotest.error)
+	pthread_barrier_destroy(&(iotest.shm->barrier));
+
+    /* A worker failed; its error is reported here. */
+    if(iotest.error)
+	iotest_exit(EXIT_FAILURE);
+}
+
+/*
+ * run_worker_proc(): body of a worker process, which opens devices by
+ * itself; stats are left in the shared iotest.child
+ */
+
+static void run_worker_proc(struct iotest_thr_t *thr)
+{
+    int i;
+
+    /* Set before anything may fail; see iotest_exit(). */
+    iotest_worker = thr;
+
+    for(i=0; i<iotest.ndev; i++)
+	close(iotest.fd[i]);
+    open_devices();
+
+    /* Engine states are per process; never reuse those of a previous worker. */
+    thr->eng_data = NULL;
+    thr->slot = NULL;
+
+    thread_handler(thr);
+
+    fflush(stdout);
+    _exit(EXIT_SUCCESS);
+}
+
+/*
+ * steady_state(): waits until the coefficient of variation of the
+ * throughput over the last samples falls under the threshold, then
+ * starts the measurement
+ */
+
+static void steady_state(void)
+{
+    int i, n = 0;
+    unsigned long long prev = 0, now, t0 = iotest.ts[0];
+    double *rate, mean, var, cv = 0;
+    struct timespec req;
+
+    if((rate = (double *)malloc(sizeof(double) * iotest.steady_win)) == NULL){
+	perror("steady_state:malloc()");
+	iotest_exit(EXIT_FAILURE);
+    }
+    req.tv_sec = iotest.steady_int / KILO;
+    req.tv_nsec = (long)(iotest.steady_int % KILO) * MEGA;
+
+    while(1){
+	nanosleep(&req, NULL);
+
+	for(now=0, i=0; i<iotest.nthr; i++)
+	    now += iotest.child[i].ndone;
+	rate[n++ % iotest.steady_win] = (double)(now - prev);
+	prev = now;
+
+	if(n >= iotest.steady_win){
+	    mean = var = 0;
+	    for(i=0; i<iotest.steady_win; i++)
+		mean += rate[i];
+	    mean /= iotest.steady_win;
+	    for(i=0; i<iotest.steady_win; i++)
+		var += (rate[i] - mean) * (rate[i] - mean);
+	    var /= iotest.steady_win - 1;
+	    cv = mean > 0 ? sqrt(var) / mean * 100 : 100;
+	    if(VERBOSE3)
+		printf("Steady state: %d samples, cv %.2f%%\n", n, cv);
+	    if(cv <= iotest.steady_cv)
+		break;
+	}
+	if(iotest.shm->is_stopping)
+	    break;
+	if(iotest_now() - t0 >= (unsigned long long)iotest.steady_max * GIGA){
+	    fprintf(stderr, "Warning: Steady state was not reached in %d [s] (cv %.2f%%). Measurement begins anyway.\n",
+		    iotest.steady_max, cv);
+	    break;
+	}
+    }
+    free(rate);
+
+    iotest.ts[0] = iotest_now();
+    iotest.warmup = iotest.ts[0] - t0;
+    __sync_synchronize();
+    iotest.shm->is_measuring = 1;
+}
+
+/*
+ * reset_result(): clears thread and device stats before a run
+ */
+
+static void reset_result(void)
+{
+    int i;
+
+    for(i=0; i<iotest.mxnthr; i++){
+	struct iotest_thr_t *thr = &(iotest.child[i]);
+	thr->ts[0] = thr->ts[1] = 0;
+	thr->acciotim = 0;
+	thr->mxiotim = 0;
+	thr->nio = 0;
+	thr->nbyte = 0;
+	thr->ncache_sample = 0;
+	thr->ncache_hit = 0;
+	thr->nrec = 0;
+	thr->ndone = 0;
+	thr->cpu[0] = thr->cpu[1] = 0;
+	memset(thr->perf, 0, sizeof(thr->perf));
+	thr->nburst = 0;
+	thr->burstim = 0;
+	thr->nonoff = 0;
+	thr->first_nio = 0;
+	thr->first_acciotim = 0;
+	thr->first_mxiotim = 0;
+	memset(&(thr->first_hist), 0, sizeof(struct iotest_hist_t));
+	memset(&(thr->ckpt_hist), 0, sizeof(struct iotest_hist_t));
+	thr->ncommit = 0;
+	thr->nsync = 0;
+	thr->nbatch = 0;
+	thr->nstall = 0;
+	thr->nwake = 0;
+	memset(&(thr->hist), 0, sizeof(struct iotest_hist_t));
+	memset(&(thr->commit_hist), 0, sizeof(struct iotest_hist_t));
+	memset(&(thr->sync_hist), 0, sizeof(struct iotest_hist_t));
+	if(thr->heat)
+	    memset(thr->heat, 0, sizeof(struct iotest_heat_t) * iotest.ndev * iotest.heat_nregion);
+	if(thr->meta_hist)
+	    memset(thr->meta_hist, 0, sizeof(struct iotest_hist_t) * NMETA);
+    }
+    iotest.heat_nsnap = 0;
+    for(i=0; i<iotest.ndev; i++){
+	struct iotest_dev_t *dev = &(iotest.dev[i]);
+	dev->acciotim = 0;
+	dev->mxiotim = 0;
+	dev->nio = 0;
+	dev->nbyte = 0;
+	dev->lsn = 0;
+    }
+}
+
+/*
+ * sweep(): walks the parameter space given by -M, -A and -b lists
+ */
+
+static void sweep(void)
+{
+    int b, a, m;
+    int nthr[] = { iotest.nthr }, naio[] = { iotest.naio }, blksiz[] = { iotest.blksiz };
+    int *sw_nthr = iotest.nsw_nthr ? iotest.sw_nthr : nthr;
+    int *sw_naio = iotest.nsw_naio ? iotest.sw_naio : naio;
+    int *sw_blksiz = iotest.nsw_blksiz ? iotest.sw_blksiz : blksiz;
+    int nsw_nthr = iotest.nsw_nthr ? iotest.nsw_nthr : 1;
+    int nsw_naio = iotest.nsw_naio ? iotest.nsw_naio : 1;
+    int nsw_blksiz = iotest.nsw_blksiz ? iotest.nsw_blksiz : 1;
+
+    for(b=0; b<nsw_blksiz; b++)
+	for(a=0; a<nsw_naio; a++){
+	    if(iotest.sweep == SWEEP_ADAPT){
+		sweep_adapt(sw_naio[a], sw_blksiz[b]);
+		continue;
+	    }
+	    for(m=0; m<nsw_nthr; m++)
+		sweep_point(sw_nthr[m], sw_naio[a], sw_blksiz[b]);
+	}
+}
+
+/*
+ * sweep_adapt(): doubles the thread count, up to and including the
+ * maximum, until throughput saturates, then bisects for the lowest count
+ * reaching the knee
+ */
+
+static void sweep_adapt(int naio, int blksiz)
+{
+    int m, k, n = 0, lo, hi, mn = MAX_NTHR, mx = 0;
+    int step[SWEEP_NSTEP];
+    double iops[SWEEP_NSTEP], peak = 0;
+
+    for(m=0; m<iotest.nsw_nthr; m++){
+	if(mn > iotest.sw_nthr[m])
+	    mn = iotest.sw_nthr[m];
+	if(mx < iotest.sw_nthr[m])
+	    mx = iotest.sw_nthr[m];
+    }
+    if(iotest.nsw_nthr <= 1)
+	mn = 1;
+
+    /* Doubling; the maximum is always the last step. */
+    for(m=mn; ; m = m * 2 < mx ? m * 2 : mx){
+	step[n] = m;
+	iops[n] = sweep_point(m, naio, blksiz);
+	if(peak < iops[n])
+	    peak = iops[n];
+	n++;
+	if(m >= mx || n >= SWEEP_NSTEP ||
+	   (n > 1 && iops[n-1] < iops[n-2] * (100 + SWEEP_PLATEAU) / 100))
+	    break;
+    }
+
+    /* Bisection between the first step reaching the knee and the one
+       before it */
+    for(k=0; k<n-1 && iops[k] < peak * iotest.knee / 100; k++)
+	;
+    hi = step[k];
+    lo = k ? step[k-1] : hi;
+    while(hi - lo > 1){
+	int mid = (lo + hi) / 2;
+	if(sweep_point(mid, naio, blksiz) >= peak * iotest.knee / 100)
+	    hi = mid;
+	else
+	    lo = mid;
+    }
+}
+
+/*
+ * sweep_point(): runs one point of the sweep and returns its throughput
+ */
+
+static double sweep_point(int nthr, int naio, int blksiz)
+{
+    struct iotest_point_t *pt;
+
+    /* Stopped by a signal; the points so far are reported. */
+    if(iotest.stop_signo)
+	return(0);
+    if(iotest.npoint >= MAX_NPOINT){
+	fprintf(stderr, "Error: Number of sweep points exceeds system limit.\n");
+	iotest_exit(EXIT_FAILURE);
+    }
+    pt = &(iotest.point[iotest.npoint++]);
+
+    iotest.nthr = nthr;
+    iotest.naio = naio;
+    iotest.blksiz = blksiz;
+    if(iotest.is_auto_ofst1)
+	iotest.ofst1 = iotest.devsiz / blksiz;
+    if(iotest.is_auto_nio)
+	iotest.nio = iotest.ofst1 - iotest.ofst0;
+
+    run_test();
+    point_record(pt);
+
+    if(VERBOSE1){
+	printf("  Sweep point          : threads %d, aio contexts %d, block size %d [Byte]\n",
+	       nthr, naio, blksiz);
+	print_result();
+    }
+
+    return((double)pt->nio * GIGA / pt->elapsed);
+}
+
+/*
+ * trial(): runs the workload -r times, each trial being a point, with a
+ * cooldown in between
+ */
+
+static void trial(void)
+{
+    int i;
+
+    for(i=0; i<iotest.trial_n && !iotest.stop_signo; i++){
+	if(i && iotest.trial_cool){
+	    unsigned long long end = iotest_now() + (unsigned long long)iotest.trial_cool * GIGA;
+	    unsigned long long now;
+	    struct timespec req;
+	    while((now = iotest_now()) < end && !iotest.stop_signo){
+		req.tv_sec = (end - now) / GIGA;
+		req.tv_nsec = (end - now) % GIGA;
+		nanosleep(&req, NULL);
+	    }
+	    if(iotest.stop_signo)
+		break;
+	}
+	run_test();
+	point_record(&(iotest.point[iotest.npoint++]));
+	if(VERBOSE2){
+	    struct iotest_point_t *pt = &(iotest.point[iotest.npoint - 1]);
+	    printf("Trial %d: %.3f [block/s]\n", i + 1, (double)pt->nio * GIGA / pt->elapsed);
+	    fflush(stdout);
+	}
+    }
+}
+
+/*
+ * copy(): runs the copy with each of the methods to compare
+ */
+
+static void copy(void)
+{
+    char *name[] = { "read/write", "splice", "copy_file_range" };
+    int m;
+
+    for(m=0; m<NCOPY; m++){
+	struct iotest_point_t *pt = &(iotest.copy_point[m]);
+	int pfd[2] = { -1, -1 };
+
+	if(!(iotest.copy & (1 << m)))
+	    continue;
+	/* Stopped by a signal; the methods not run are not reported. */
+	if(iotest.stop_signo){
+	    iotest.copy &= (1 << m) - 1;
+	    break;
+	}
+
+	/* Cross-device copy_file_range and splice to O_DIRECT files may not be
+	   supported; such a method is skipped rather than failing the run. */
+	if(m == COPY_SPLICE && pipe(pfd) != 0){
+	    perror("copy:pipe()");
+	    iotest_exit(EXIT_FAILURE);
+	}
+	if(!IS_NONOP && copy_chunk(m, 0, pfd, (unsigned long long)iotest.ofst0 * iotest.blksiz, iotest.blksiz) != 0){
+	    fprintf(stderr, "Warning: %s is not available between %s and %s (%s); skipped.\n",
+		    name[m], iotest.dev[0].fname, iotest.dev[1].fname, strerror(errno));
+	    iotest.copy &= ~(1 << m);
+	}
+	if(pfd[0] >= 0){
+	    close(pfd[0]);
+	    close(pfd[1]);
+	}
+	if(!(iotest.copy & (1 << m)))
+	    continue;
+
+	iotest.copy_method = m;
+	run_test();
+	point_record(pt);
+
+	if(VERBOSE1){
+	    printf("  Copy method          : %s\n", name[m]);
+	    print_result();
+	}
+    }
+}
+
+/*
+ * parse_list(): parses a comma-separated list of integers of option opt,
+ * each of which must be lo or more
+ */
+
+static int parse_list(int opt, char *arg, int *vals, int max, int lo)
+{
+    int n = 0;
+    char *p, *save;
+
+    for(p = strtok_r(arg, ",", &save); p; p = strtok_r(NULL, ",", &save)){
+	if(n >= max){
+	    fprintf(stderr, "Error: Too many values in the list.\n");
+	    iotest_exit(EXIT_FAILURE);
+	}
+	if((vals[n++] = atoi(p)) < lo){
+	    fprintf(stderr, "Error: Values of -%c must be %d or more.\n", opt, lo);
+	    iotest_exit(EXIT_FAILURE);
+	}
+    }
+    if(n == 0){
+	fprintf(stderr, "Error: Empty list.\n");
+	iotest_exit(EXIT_FAILURE);
+    }
+
+    return(n);
+}
+
+/*
+ *
+ * Subroutines
+ *
+ */
+
+static void *thread_handler(void *arg)
+{
+    struct iotest_thr_t *thr = (struct iotest_thr_t *)arg;
+    int id;
+
+    IOTEST_ENTER(thr->ctx);
+    IOTEST_WORKER(thr);
+    id = thr->id;
+
+    if(iotest.is_oltp && thr->role == ROLE_READ)
+	oltp_read(id);
+    else if(iotest.is_oltp && thr->role == ROLE_CKPT)
+	oltp_ckpt(id);
+    else if(iotest.log)
+	logtest(id);
+    else if(iotest.copy)
+	copytest(id);
+    else if(iotest.meta)
+	metatest(id);
+    else if(iotest.pipe_s && id < iotest.pipe_nsub)
+	pipe_submit(id);
+    else if(iotest.pipe_s)
+	pipe_complete(id);
+    else
+	disktest(id);
+
+    if(thr->is_started){
+	unsigned long long cpu[2];
+	iotest_cputime(cpu);
+	thr->cpu[0] = cpu[0] - thr->cpu0[0];
+	thr->cpu[1] = cpu[1] - thr->cpu0[1];
+	if(iotest.perf_mask)
+	    perf_stop(thr);
+    }
+    
+    return(NULL);
+}
+
+/*
+ * disktest(): random or sequential ios of a thread through the engine;
+ * the engine keeps up to -A of them in flight
+ */
+
+static void disktest(int id)
+{
+    struct iotest_thr_t *thr;
+    struct iotest_engine_t *eng;
+    void *data;
+    unsigned long long i, nio_issued = 0;
+    unsigned long long think_end = 0, idle_end = 0;     /* [ns] */
+    int e, depth, nfree, nio_inflight = 0;
+    int onoff_pos = 0, is_draining = 0;
+
+    thr = &(iotest.child[id]);
+    
+    /*
+     * Begin
+     */
+    
+    if(VERBOSE4)
+	printf("TH[%d] starts.\n", id);
+
+    e = engine_of_run();
+    eng = &(iotest_engine[e]);
+    engine_attach(thr, e);
+    data = thr->eng_data[e];
+    depth = iotest.naio ? iotest.naio : 1;
+    for(nfree=0; nfree<depth; nfree++)
+	thr->slot_free[nfree] = depth - 1 - nfree;
+
+    thr->seed = iotest_seed(id);
+
+    iotest_start(thr);
+
+    /*
+     * Loop
+     */
+
+    for(i=0; ; ){
+	int n, k, is_issuing = nio_issued < iotest.nio && !iotest.shm->is_stopping;
+	unsigned long long ts;
+
+	/* A burst is over when all its ios complete; the idle gap follows. */
+	if(is_draining && nio_inflight == 0){
+	    is_draining = 0;
+	    idle_end = iotest_now() + (unsigned long long)iotest.onoff_idle * MEGA;
+	    if(iotest.onoff_dist == DIST_EXP)
+		idle_end = iotest_now() + iotest_dist(thr, DIST_EXP, (double)iotest.onoff_idle * KILO, 0);
+	}
+	if(is_issuing && nio_inflight == 0 && !is_draining){
+	    if(iotest_now() < idle_end)
+		iotest_wait_until(idle_end);
+	    if(iotest_now() < think_end)
+		iotest_wait_until(think_end);
+	    is_issuing = !iotest.shm->is_stopping;
+	}
+
+	/* An io is issued at a time between reaps, as they complete. */
+	if(nfree > 0 && is_issuing && !is_draining &&
+	   ((!think_end && !idle_end) || 
+	    ((ts = iotest_now()) >= think_end && ts >= idle_end))){
+	    struct iotest_slot_t *sl = &(thr->slot[thr->slot_free[--nfree]]);
+	    int devid;
+	    unsigned long long ofst;
+
+	    if(IS_RANDOM){
+		ofst = (unsigned long long)iotest.ofst0;
+		ofst += (unsigned long long)((unsigned long long)iotest.ofst1-(unsigned long long)iotest.ofst0)*rand_r(&(thr->seed))/(RAND_MAX+1.0);
+		ofst *=  iotest.blksiz;
+	    }else{
+		ofst = (iotest.ofst0 + i % (iotest.ofst1 - iotest.ofst0)) * iotest.blksiz;
+	    }
+
+	    if(IS_RANDOM)
+		devid = (int)(((double)iotest.ndev)*rand_r(&(thr->seed))/(RAND_MAX+1.0));
+	    else
+		devid = thr->id % iotest.ndev;
+
+	    if(IS_READ)
+		iotest_cache_sample(thr, thr->ndone, devid, ofst, iotest.blksiz);
+
+	    sl->io.fd = iotest.fd[devid];
+	    sl->io.op = IS_READ ? OP_READ : OP_WRITE;
+	    sl->io.size = iotest.blksiz;
+	    sl->io.ofst = ofst;
+	    sl->devid = devid;
+
+	    /* Response time is accounted on completion. */
+	    sl->is_measured = iotest.shm->is_measuring;
+	    sl->ts = iotest_now();
+	    if(sl->is_measured && !thr->ts[0])
+		thr->ts[0] = sl->ts;
+
+	    if(iotest.onoff_n){
+		sl->is_first = onoff_pos < iotest.onoff_first;
+		if(onoff_pos == 0 && sl->is_measured)
+		    thr->nonoff++;
+		if(++onoff_pos >= iotest.onoff_n){
+		    onoff_pos = 0;
+		    is_draining = 1;
+		}
+	    }
+	    if(eng->submit(data, &(sl->io)) != 0)
+		engine_fail(e, "submit");
+
+	    if(sl->is_measured)
+		nio_issued++;
+	    nio_inflight++;
+	    i++;
+	}
+
+	/* Warm-up ios are drained as well, since slots are reused. */
+	if(nio_inflight == 0)
+	    break;
+
+	/* Waits only when no more io can be issued. */
+	n = eng->reap(data, thr->reaped, nio_inflight,
+		      nfree == 0 || !is_issuing || is_draining);
+	if(n < 0)
+	    engine_fail(e, "reap");
+	ts = iotest_now();
+
+	/* The next io waits for think or idle time with ios in flight; the
+	   reap above cannot block until then, so sleep in slices. */
+	if(n == 0 && nfree > 0 && is_issuing && !is_draining &&
+	   (ts < think_end || ts < idle_end)){
+	    iotest_wait_slice(think_end > idle_end ? think_end : idle_end);
+	    continue;
+	}
+
+	for(k=0; k<n; k++){
+	    struct iotest_slot_t *sl = &(thr->slot[thr->reaped[k]->slot]);
+	    thr->ndone++;
+	    if(sl->is_measured){
+		iotest_account(thr, sl->devid, sl->io.op, sl->io.ofst, sl->io.size, sl->ts, ts);
+		if(sl->is_first)
+		    iotest_account_first(thr, sl->ts, ts);
+	    }
+	    thr->slot_free[nfree++] = sl->io.slot;
+	}
+	nio_inflight -= n;
+	if(n > 0 && iotest.think)
+	    think_end = ts + iotest_dist(thr, iotest.think, iotest.think_a, iotest.think_b);
+    }
+    
+    /*
+     * Finish
+     */
+
+    thr->ts[1] = iotest_now();
+
+    if(VERBOSE4)
+	printf("TH[%d] ends.\n", id);
+}
+
+/*
+ * engine_of_run(): engine of the run; unless set by -i, null with -n, or
+ * libaio with -A
+ */
+
+static int engine_of_run(void)
+{
+    if(iotest.engine >= 0)
+	return(iotest.engine);
+    if(IS_NONOP)
+	return(ENGINE_NULL);
+    return(iotest.naio ? ENGINE_LIBAIO : ENGINE_SYNC);
+}
+
+/*
+ * engine_find(): index of the engine of the name, or -1
+ */
+
+static int engine_find(char *name)
+{
+    int i;
+
+    for(i=0; i<iotest_nengine; i++)
+	if(strcmp(iotest_engine[i].name, name) == 0)
+	    return(i);
+    return(-1);
+}
+
+/*
+ * iotest_engine_register(): adds an engine to those of -i; the engine is
+ * copied, while its name is referred to
+ */
+
+int iotest_engine_register(const struct iotest_engine_t *eng)
+{
+    if(eng->name == NULL || eng->setup == NULL || eng->submit == NULL ||
+       eng->reap == NULL || eng->teardown == NULL){
+	errno = EINVAL;
+	return(-1);
+    }
+    if(engine_find((char *)eng->name) >= 0){
+	errno = EEXIST;
+	return(-1);
+    }
+    if(iotest_nengine >= MAX_NENGINE){
+	errno = ENOSPC;
+	return(-1);
+    }
+    iotest_engine[iotest_nengine++] = *eng;
+    return(0);
+}
+
+/*
+ * engine_attach(): sets up the slots of a thread, and the state of the
+ * engine, for the largest -A of the runs
+ */
+
+static void engine_attach(struct iotest_thr_t *thr, int e)
+{
+    int depth = iotest.mxnaio ? iotest.mxnaio : 1;
+    int i;
+
+    if(thr->slot == NULL){
+	thr->eng_data = (void **)calloc(MAX_NENGINE, sizeof(void *));
+	thr->slot = (struct iotest_slot_t *)calloc(depth, sizeof(struct iotest_slot_t));
+	thr->slot_free = (int *)calloc(depth, sizeof(int));
+	thr->reaped = (struct iotest_io_t **)calloc(depth, sizeof(struct iotest_io_t *));
+	thr->slot_buf = (char *)valloc((size_t)depth * iotest.mxblksiz);
+	if(thr->eng_data == NULL || thr->slot == NULL || thr->slot_free == NULL ||
+	   thr->reaped == NULL || thr->slot_buf == NULL){
+	    perror("engine_attach:malloc()");
+	    iotest_exit(EXIT_FAILURE);
+	}
+	memset(thr->slot_buf, 0, (size_t)depth * iotest.mxblksiz);
+	for(i=0; i<depth; i++){
+	    thr->slot[i].io.slot = i;
+	    thr->slot[i].io.buf = thr->slot_buf + (size_t)i * iotest.mxblksiz;
+	}
+    }
+
+    if(thr->eng_data[e] == NULL && iotest_engine[e].setup(&(thr->eng_data[e]), depth) != 0)
+	engine_fail(e, "setup");
+}
+
+/*
+ * engine_detach(): releases the engine states and slots of a thread
+ */
+
+static void engine_detach(struct iotest_thr_t *thr)
+{
+    int e;
+
+    if(thr->slot == NULL)
+	return;
+
+    for(e=0; e<iotest_nengine; e++)
+	if(thr->eng_data[e])
+	    iotest_engine[e].teardown(thr->eng_data[e]);
+    free(thr->eng_data);
+    free(thr->slot);
+    free(thr->slot_free);
+    free(thr->reaped);
+    free(thr->slot_buf);
+    thr->eng_data = NULL;
+    thr->slot = NULL;
+}
+
+/*
+ * engine_fail(): reports an error returned by an engine
+ */
+
+static void engine_fail(int e, char *func)
+{
+    char label[64];
+
+    snprintf(label, sizeof(label), "disktest:%s:%s()", iotest_engine[e].name, func);
+    perror(label);
+    iotest_exit(EXIT_FAILURE);
+}
+
+/*
+ * sync_setup(), sync_submit(), sync_reap(), sync_teardown(): sync engine;
+ * an io completes in submit(), and is returned by the next reap()
+ */
+
+static int sync_setup(void **data, int depth)
+{
+    return((*data = calloc(1, sizeof(struct iotest_io_t *))) == NULL ? -1 : 0);
+}
+
+static int sync_submit(void *data, struct iotest_io_t *io)
+{
+    if(io->op == OP_READ)
+	iotest_pread(io->fd, io->buf, io->size, io->ofst);
+    else
+	iotest_pwrite(io->fd, io->buf, io->size, io->ofst);
+    *(struct iotest_io_t **)data = io;
+
+    return(0);
+}
+
+static int sync_reap(void *data, struct iotest_io_t **done, int max, int min)
+{
+    struct iotest_io_t **last = (struct iotest_io_t **)data;
+
+    if(*last == NULL)
+	return(0);
+    done[0] = *last;
+    *last = NULL;
+
+    return(1);
+}
+
+static void sync_teardown(void *data)
+{
+    free(data);
+}
+
+/*
+ * null_setup(), null_submit(), null_reap(), null_teardown(): null engine;
+ * ios complete at the next reap without touching devices, so that the
+ * throughput and CPU time are those of iotest itself (-n)
+ */
+
+struct iotest_null_t {
+    int n;
+    struct iotest_io_t *io[1];      /* depth of them */
+};
+
+static int null_setup(void **data, int depth)
+{
+    size_t size = sizeof(struct iotest_null_t) + sizeof(struct iotest_io_t *) * (depth - 1);
+
+    return((*data = calloc(1, size)) == NULL ? -1 : 0);
+}
+
+static int null_submit(void *data, struct iotest_io_t *io)
+{
+    struct iotest_null_t *q = (struct iotest_null_t *)data;
+
+    q->io[q->n++] = io;
+
+    return(0);
+}
+
+static int null_reap(void *data, struct iotest_io_t **done, int max, int min)
+{
+    struct iotest_null_t *q = (struct iotest_null_t *)data;
+    int n = q->n < max ? q->n : max;
+
+    q->n -= n;
+    memcpy(done, q->io + q->n, sizeof(struct iotest_io_t *) * n);
+
+    return(n);
+}
+
+static void null_teardown(void *data)
+{
+    free(data);
+}
+
+
+#ifdef __linux__
+
+/*
+ * libaio_setup(), libaio_submit(), libaio_reap(), libaio_teardown():
+ * libaio engine; an io is issued on a context of its own, and contexts
+ * are polled for completions
+ */
+
+struct iotest_libaio_t {
+    int depth;
+    int next;                       /* context to poll first */
+    struct iotest_aio_context_t *acs;
+};
+
+static int libaio_setup(void **data, int depth)
+{
+    struct iotest_libaio_t *la;
+    int i;
+
+    if((la = (struct iotest_libaio_t *)calloc(1, sizeof(struct iotest_libaio_t))) == NULL ||
+       (la->acs = (struct iotest_aio_context_t *)calloc(depth, sizeof(struct iotest_aio_context_t))) == NULL){
+	free(la);
+	return(-1);
+    }
+    la->depth = depth;
+
+    for(i=0; i<depth; i++){
+
+	struct iotest_aio_context_t *ac = &(la->acs[i]);
+	int r;
+	
+	ac->id = i;
+	
+	if((r = io_setup(1, &(ac->ctx))) != 0)
+	    errno = - r;
+	if(r != 0 || (ac->iocbs[0] = (struct iocb *)malloc(sizeof(struct iocb))) == NULL){
+	    la->depth = i + 1;
+	    libaio_teardown(la);
+	    return(-1);
+	}
+    }
+
+    *data = la;
+    return(0);
+}
+
+static int libaio_submit(void *data, struct iotest_io_t *io)
+{
+    struct iotest_libaio_t *la = (struct iotest_libaio_t *)data;
+    struct iotest_aio_context_t *ac = &(la->acs[io->slot]);
+
+    ac->io = io;
+    if(io->op == OP_READ)
+	iotest_aio_pread(ac, io->fd, io->buf, io->size, io->ofst);
+    else
+	iotest_aio_pwrite(ac, io->fd, io->buf, io->size, io->ofst);
+
+    return(0);
+}
+
+static int libaio_reap(void *data, struct iotest_io_t **done, int max, int min)
+{
+    struct iotest_libaio_t *la = (struct iotest_libaio_t *)data;
+    int n = 0, k;
+
+    do{
+	for(k=0; k<la->depth && n<max; k++){
+	    struct iotest_aio_context_t *ac = &(la->acs[(la->next + k) % la->depth]);
+	    if(iotest_aio_check_io_ongoing(ac) && iotest_aio_return(ac))
+		done[n++] = ac->io;
+	}
+	la->next = (la->next + k) % la->depth;
+    }while(n < min);
+
+    return(n);
+}
+
+static void libaio_teardown(void *data)
+{
+    struct iotest_libaio_t *la = (struct iotest_libaio_t *)data;
+    int i;
+
+    for(i=0; i<la->depth; i++){
+	if(la->acs[i].ctx)
+	    io_destroy(la->acs[i].ctx);
+	free(la->acs[i].iocbs[0]);
+    }
+    free(la->acs);
+    free(la);
+}
+
+/*
+ * aioring_setup(), aioring_submit(), aioring_reap(), aioring_teardown():
+ * aioring engine; ios of a thread share one context, and are submitted
+ * aio_batch at a time, or all pending ones when the thread is to wait.
+ * Completions are taken from the ring the kernel maps at the address of
+ * the context, so that io_getevents() is called only to block.
+ */
+
+struct iotest_aio_ring_t {
+    unsigned int id;
+    unsigned int nr;                /* number of io_events */
+    volatile unsigned int head;
+    volatile unsigned int tail;
+    unsigned int magic;
+    unsigned int compat_features;
+    unsigned int incompat_features;
+    unsigned int header_length;
+    struct io_event io_events[0];
+};
+
+#define AIO_RING_MAGIC 0xa10a10a1
+
+struct iotest_aioring_t {
+    io_context_t ctx;
+    struct iotest_aio_ring_t *ring; /* or NULL if not of a known layout */
+    struct iocb *iocbs;             /* by slot */
+    struct iocb **pend;
+    int npend;
+    struct io_event *events;
+    int depth;
+};
+
+static int aioring_setup(void **data, int depth)
+{
+    struct iotest_aioring_t *ar;
+    struct iotest_aio_ring_t *ring;
+    int r;
+
+    if((ar = (struct iotest_aioring_t *)calloc(1, sizeof(struct iotest_aioring_t))) == NULL)
+	return(-1);
+    ar->depth = depth;
+    if((ar->iocbs = (struct iocb *)calloc(depth, sizeof(struct iocb))) == NULL ||
+       (ar->pend = (struct iocb **)calloc(depth, sizeof(struct iocb *))) == NULL ||
+       (ar->events = (struct io_event *)calloc(depth, sizeof(struct io_event))) == NULL){
+	aioring_teardown(ar);
+	return(-1);
+    }
+    if((r = io_setup(depth, &(ar->ctx))) != 0){
+	errno = - r;
+	ar->ctx = 0;
+	aioring_teardown(ar);
+	return(-1);
+    }
+
+    ring = (struct iotest_aio_ring_t *)ar->ctx;
+    if(ring->magic == AIO_RING_MAGIC && ring->incompat_features == 0 &&
+       ring->header_length == sizeof(struct iotest_aio_ring_t))
+	ar->ring = ring;
+    else if(VERBOSE1)
+	fprintf(stderr, "Warning: Unknown aio ring layout; completions are reaped by io_getevents().\n");
+
+    *data = ar;
+    return(0);
+}
+
+static int aioring_submit(void *data, struct iotest_io_t *io)
+{
+    struct iotest_aioring_t *ar = (struct iotest_aioring_t *)data;
+    struct iocb *cb = &(ar->iocbs[io->slot]);
+
+    if(io->op == OP_READ)
+	io_prep_pread(cb, io->fd, io->buf, io->size, io->ofst);
+    else
+	io_prep_pwrite(cb, io->fd, io->buf, io->size, io->ofst);
+    cb->data = io;
+    ar->pend[ar->npend++] = cb;
+
+    if(ar->npend >= iotest.aio_batch)
+	return(aioring_flush(ar));
+    return(0);
+}
+
+/*
+ * aioring_flush(): submits the pending ios
+ */
+
+static int aioring_flush(void *data)
+{
+    struct iotest_aioring_t *ar = (struct iotest_aioring_t *)data;
+    int n = 0, r;
+
+    if(IS_NONOP)
+	return(0);
+
+    while(n < ar->npend){
+	if((r = io_submit(ar->ctx, ar->npend - n, ar->pend + n)) < 0){
+	    errno = - r;
+	    return(-1);
+	}
+	n += r;
+    }
+    if(VERBOSE5)
+	printf("  io_submit(%d)\n", n);
+    ar->npend = 0;
+
+    return(0);
+}
+
+static int aioring_reap(void *data, struct iotest_io_t **done, int max, int min)
+{
+    struct iotest_aioring_t *ar = (struct iotest_aioring_t *)data;
+    struct iotest_aio_ring_t *ring = ar->ring;
+    int n = 0, k, r;
+
+    /* Without system calls, pending ios complete here. */
+    if(IS_NONOP){
+	n = ar->npend < max ? ar->npend : max;
+	for(k=0; k<n; k++)
+	    done[k] = (struct iotest_io_t *)ar->pend[--ar->npend]->data;
+	return(n);
+    }
+
+    if(min > 0 && ar->npend && aioring_flush(ar) != 0)
+	return(-1);
+
+    if(ring){
+	unsigned int head = ring->head, tail = ring->tail;
+
+	/* Events up to tail are written before it is published. */
+	__sync_synchronize();
+	while(head != tail && n < max){
+	    ar->events[n++] = ring->io_events[head];
+	    if(++head >= ring->nr)
+		head = 0;
+	}
+	__sync_synchronize();
+	ring->head = head;
+    }
+
+    if(n < min || (!ring && n < max)){
+	r = io_getevents(ar->ctx, min - n > 0 ? min - n : 0, max - n, ar->events + n, NULL);
+	if(r < 0){
+	    errno = - r;
+	    return(-1);
+	}
+	n += r;
+    }
+
+    for(k=0; k<n; k++){
+	struct io_event *ev = &(ar->events[k]);
+	struct iotest_io_t *io = (struct iotest_io_t *)ev->data;
+	if((long)ev->res < 0){
+	    errno = - (long)ev->res;
+	    return(-1);
+	}
+	if(ev->res != io->size){
+	    errno = EIO;
+	    return(-1);
+	}
+	done[k] = io;
+    }
+
+    return(n);
+}
+
+static void aioring_teardown(void *data)
+{
+    struct iotest_aioring_t *ar = (struct iotest_aioring_t *)data;
+
+    if(ar->ctx)
+	io_destroy(ar->ctx);
+    free(ar->iocbs);
+    free(ar->pend);
+    free(ar->events);
+    free(ar);
+}
+
+/*
+ * copytest(): copies a contiguous share of the range from the first
+ * device to the second at the same offsets, a block at a time
+ */
+
+static void copytest(int id)
+{
+    struct iotest_thr_t *thr = &(iotest.child[id]);
+    unsigned long long blk, b0, b1;
+    int pfd[2] = { -1, -1 };
+
+    b0 = iotest.ofst0 + (unsigned long long)(iotest.ofst1 - iotest.ofst0) * id / iotest.nthr;
+    b1 = iotest.ofst0 + (unsigned long long)(iotest.ofst1 - iotest.ofst0) * (id + 1) / iotest.nthr;
+
+    if(VERBOSE4)
+	printf("TH[%d] starts copying blocks %llu - %llu.\n", id, b0, b1);
+
+    if(iotest.copy_method == COPY_SPLICE){
+	if(pipe(pfd) != 0){
+	    perror("copytest:pipe()");
+	    iotest_exit(EXIT_FAILURE);
+	}
+#ifdef F_SETPIPE_SZ
+	if(iotest.blksiz > 65536)
+	    fcntl(pfd[0], F_SETPIPE_SZ, iotest.blksiz);
+#endif
+    }
+
+    iotest_start(thr);
+
+    for(blk=b0; blk<b1 && thr->nio<iotest.nio && !iotest.shm->is_stopping; blk++){
+	unsigned long long ofst = blk * iotest.blksiz;
+	unsigned long long ts[2];
+
+	ts[0] = iotest_now();
+	if(!IS_NONOP && copy_chunk(iotest.copy_method, id, pfd, ofst, iotest.blksiz) != 0){
+	    perror("copytest:copy_chunk()");
+	    iotest_exit(EXIT_FAILURE);
+	}
+	ts[1] = iotest_now();
+
+	thr->ndone++;
+	if(iotest.shm->is_measuring){
+	    if(!thr->ts[0])
+		thr->ts[0] = ts[0];
+	    iotest_account(thr, 1, OP_WRITE, ofst, iotest.blksiz, ts[0], ts[1]);
+	}
+    }
+
+    thr->ts[1] = iotest_now();
+    if(pfd[0] >= 0){
+	close(pfd[0]);
+	close(pfd[1]);
+    }
+
+    if(VERBOSE4)
+	printf("TH[%d] ends copying.\n", id);
+}
+
+/*
+ * copy_chunk(): copies size bytes at ofst from the first device to the
+ * second; returns -1 with errno on failure
+ */
+
+static int copy_chunk(int method, int id, int *pfd, unsigned long long ofst, int size)
+{
+    int src = iotest.fd[0], dst = iotest.fd[1];
+    loff_t in = ofst, out = ofst;
+    ssize_t r, w, n;
+    size_t left = size;
+
+    switch(method){
+    case COPY_RW:
+	/* The baseline goes through the thread's buffer. */
+	for(; left > 0; left -= r){
+	    if((r = pread(src, iotest.child[id].buf, left, in)) <= 0)
+		return(r == 0 ? (errno = EIO, -1) : -1);
+	    for(w=0; w<r; w+=n)
+		if((n = pwrite(dst, iotest.child[id].buf + w, r - w, out + w)) <= 0)
+		    return(-1);
+	    in += r;
+	    out += r;
+	}
+	break;
+    case COPY_SPLICE:
+	for(; left > 0; left -= r){
+	    if((r = splice(src, &in, pfd[1], NULL, left, SPLICE_F_MOVE)) <= 0)
+		return(r == 0 ? (errno = EIO, -1) : -1);
+	    for(w=0; w<r; w+=n)
+		if((n = splice(pfd[0], NULL, dst, &out, r - w, SPLICE_F_MOVE)) <= 0)
+		    return(-1);
+	}
+	break;
+    case COPY_CFR:
+	for(; left > 0; left -= r)
+	    if((r = copy_file_range(src, &in, dst, &out, left, 0)) <= 0)
+		return(r == 0 ? (errno = EIO, -1) : -1);
+	break;
+    }
+
+    if(VERBOSE5)
+	printf("  copy_chunk(method=%d, offset=%llu, size=%d)\n", method, ofst, size);
+
+    return(0);
+}
+
+/*
+ * pipe_submit(): issues ios through the free slots of its ring, in
+ * batches of whatever slots the completer has returned
+ */
+
+static void pipe_submit(int id)
+{
+    struct iotest_thr_t *thr = &(iotest.child[id]);
+    struct iotest_pipe_t *p = &(iotest.pipe[id]);
+    unsigned long long i, nio_issued = 0;
+    int is_stalled = 0;
+
+    if(VERBOSE4)
+	printf("TH[%d] starts submitting.\n", id);
+
+    thr->seed = iotest_seed(id);
+
+    iotest_start(thr);
+
+    for(i=0; ; ){
+	int n = 0, k, s;
+	unsigned long long ts;
+
+	while(nio_issued < iotest.nio && !iotest.shm->is_stopping &&
+	      n < iotest.naio && (s = iotest_pipe_pop(p)) >= 0){
+	    struct iocb *iocb = &(p->iocbs[s]);
+	    int devid;
+	    unsigned long long ofst;
+
+	    if(IS_RANDOM){
+		ofst = (unsigned long long)iotest.ofst0;
+		ofst += (unsigned long long)((unsigned long long)iotest.ofst1-(unsigned long long)iotest.ofst0)*rand_r(&(thr->seed))/(RAND_MAX+1.0);
+		ofst *=  iotest.blksiz;
+		devid = (int)(((double)iotest.ndev)*rand_r(&(thr->seed))/(RAND_MAX+1.0));
+	    }else{
+		ofst = (iotest.ofst0 + i % (iotest.ofst1 - iotest.ofst0)) * iotest.blksiz;
+		devid = thr->id % iotest.ndev;
+	    }
+
+	    /* Completers count ndone; the submitter samples on its own count. */
+	    if(IS_READ){
+		iotest_cache_sample(thr, i, devid, ofst, iotest.blksiz);
+		io_prep_pread(iocb, iotest.fd[devid], p->bufs + (size_t)s * iotest.blksiz, iotest.blksiz, ofst);
+	    }else
+		io_prep_pwrite(iocb, iotest.fd[devid], p->bufs + (size_t)s * iotest.blksiz, iotest.blksiz, ofst);
+	    io_set_eventfd(iocb, p->efd);
+
+	    p->slot[s].devid = devid;
+	    p->slot[s].is_measured = iotest.shm->is_measuring;
+	    if(p->slot[s].is_measured)
+		nio_issued++;
+	    p->batch[n++] = iocb;
+	    i++;
+	}
+
+	if(n == 0){
+	    if((nio_issued >= iotest.nio || iotest.shm->is_stopping) &&
+	       (p->tail - p->head == iotest.naio || iotest.error))
+		break;
+	    /* A stall is counted once per run of empty polls. */
+	    if(!is_stalled && nio_issued < iotest.nio && !iotest.shm->is_stopping)
+		thr->nstall++;
+	    is_stalled = 1;
+	    sched_yield();
+	    continue;
+	}
+	is_stalled = 0;
+
+	ts = iotest_now();
+	for(k=0; k<n; k++){
+	    p->slot[p->batch[k] - p->iocbs].ts = ts;
+	    if(p->slot[p->batch[k] - p->iocbs].is_measured && !thr->ts[0])
+		thr->ts[0] = ts;
+	}
+	for(k=0; k<n; ){
+	    int r = io_submit(p->ctx, n - k, p->batch + k);
+	    if(r <= 0){
+		errno = - r;
+		perror("pipe_submit:io_submit()");
+		iotest_exit(EXIT_FAILURE);
+	    }
+	    k += r;
+	}
+	thr->nbatch++;
+
+	if(VERBOSE5)
+	    printf("  pipe_submit(), thr=%d, n=%d\n", id, n);
+    }
+
+    thr->ts[1] = iotest_now();
+    p->is_done = 1;
+
+    if(VERBOSE4)
+	printf("TH[%d] ends submitting.\n", id);
+}
+
+/*
+ * pipe_complete(): reaps the completions of its submitters as their
+ * eventfds become readable, accounts them and returns the slots
+ */
+
+static void pipe_complete(int id)
+{
+    struct iotest_thr_t *thr = &(iotest.child[id]);
+    struct epoll_event *evs;
+    struct io_event *events;
+    int epfd, i, n, nmine = 0;
+    int comp = id - iotest.pipe_nsub;
+
+    if(VERBOSE4)
+	printf("TH[%d] starts completing.\n", id);
+
+    if((epfd = epoll_create1(0)) < 0){
+	perror("pipe_complete:epoll_create1()");
+	iotest_exit(EXIT_FAILURE);
+    }
+    for(i=comp; i<iotest.pipe_nsub; i+=iotest.pipe_ncomp){
+	struct epoll_event ev;
+	ev.events = EPOLLIN;
+	ev.data.u32 = i;
+	if(epoll_ctl(epfd, EPOLL_CTL_ADD, iotest.pipe[i].efd, &ev) != 0){
+	    perror("pipe_complete:epoll_ctl()");
+	    iotest_exit(EXIT_FAILURE);
+	}
+	nmine++;
+    }
+    evs = (struct epoll_event *)malloc(sizeof(struct epoll_event) * nmine);
+    events = (struct io_event *)malloc(sizeof(struct io_event) * iotest.naio);
+    if(evs == NULL || events == NULL){
+	perror("pipe_complete:malloc()");
+	iotest_exit(EXIT_FAILURE);
+    }
+
+    iotest_start(thr);
+
+    for(;;){
+	if((n = epoll_wait(epfd, evs, nmine, 10)) < 0){
+	    if(errno == EINTR)
+		continue;
+	    perror("pipe_complete:epoll_wait()");
+	    iotest_exit(EXIT_FAILURE);
+	}
+	if(n)
+	    thr->nwake++;
+
+	for(i=0; i<n; i++){
+	    struct iotest_pipe_t *p = &(iotest.pipe[evs[i].data.u32]);
+	    uint64_t cnt;
+
+	    if(read(p->efd, &cnt, sizeof(cnt)) != sizeof(cnt))
+		continue;
+
+	    while(cnt > 0){
+		int r, k;
+		unsigned long long ts;
+
+		r = io_getevents(p->ctx, 1, cnt < iotest.naio ? cnt : iotest.naio, events, NULL);
+		if(r < 0){
+		    if(r == -EINTR)
+			continue;
+		    errno = - r;
+		    perror("pipe_complete:io_getevents()");
+		    iotest_exit(EXIT_FAILURE);
+		}
+		ts = iotest_now();
+		for(k=0; k<r; k++){
+		    struct iocb *iocb = events[k].obj;
+		    int s = iocb - p->iocbs;
+		    int is_read = iocb->aio_lio_opcode == IO_CMD_PREAD;
+
+		    if(is_read)
+			iotest_aio_pread_done(p->ctx, iocb, events[k].res, events[k].res2);
+		    else
+			iotest_aio_pwrite_done(p->ctx, iocb, events[k].res, events[k].res2);
+
+		    thr->ndone++;
+		    if(p->slot[s].is_measured){
+			if(!thr->ts[0])
+			    thr->ts[0] = p->slot[s].ts;
+			iotest_account(thr, p->slot[s].devid, is_read ? OP_READ : OP_WRITE,
+				       iocb->u.c.offset, iocb->u.c.nbytes, p->slot[s].ts, ts);
+		    }
+		    iotest_pipe_push(p, s);
+		}
+		cnt -= r;
+	    }
+	}
+
+	/* Submitters are done only after all their slots came back. */
+	for(i=comp; i<iotest.pipe_nsub; i+=iotest.pipe_ncomp)
+	    if(!iotest.pipe[i].is_done)
+		break;
+	if(i >= iotest.pipe_nsub || iotest.error)
+	    break;
+    }
+
+    thr->ts[1] = iotest_now();
+    free(evs);
+    free(events);
+    close(epfd);
+
+    if(VERBOSE4)
+	printf("TH[%d] ends completing.\n", id);
+}
+
+/*
+ * logtest(): appends blocks to a log, and commits them by syncing every
+ * log_n appends or log_us microseconds
+ */
+
+static void logtest(int id)
+{
+    struct iotest_thr_t *thr = &(iotest.child[id]);
+    int devid = id % iotest.ndev;
+    unsigned long long range = iotest.ofst1 - iotest.ofst0;
+    unsigned long long tc = 0;              /* start of the first uncommitted append */
+    unsigned long long lo = 0, hi = 0;      /* byte range of uncommitted appends */
+    unsigned long long next = 0;
+    int npend = 0;
+
+    if(VERBOSE4)
+	printf("TH[%d] starts.\n", id);
+
+    iotest_start(thr);
+
+    /* Appends are of thr->blksiz, which differs from -b in composite workload. */
+    range = range * iotest.blksiz / thr->blksiz;
+
+    while(thr->nio < iotest.nio && !iotest.shm->is_stopping){
+	unsigned long long lsn, ofst;
+	unsigned long long ts[2];
+
+	iotest_pace(&next, thr->rate);
+
+	lsn = __sync_fetch_and_add(&(iotest.dev[devid].lsn), 1);
+	ofst = (unsigned long long)iotest.ofst0 * iotest.blksiz + (lsn % range) * thr->blksiz;
+
+	ts[0] = iotest_now();
+	iotest_pwrite(iotest.fd[devid], thr->buf, thr->blksiz, ofst);
+	ts[1] = iotest_now();
+
+	thr->ndone++;
+	if(iotest.shm->is_measuring){
+	    if(!thr->ts[0])
+		thr->ts[0] = ts[0];
+	    iotest_account(thr, devid, OP_WRITE, ofst, thr->blksiz, ts[0], ts[1]);
+	}
+
+	if(npend == 0 || ofst < lo)
+	    lo = ofst;
+	if(npend == 0 || ofst + thr->blksiz > hi)
+	    hi = ofst + thr->blksiz;
+	if(npend++ == 0)
+	    tc = ts[0];
+
+	if((iotest.log_n && npend >= iotest.log_n) ||
+	   (iotest.log_us && ts[1] - tc >= (unsigned long long)iotest.log_us * KILO)){
+	    log_commit(thr, devid, lo, hi);
+	    if(iotest.shm->is_measuring)
+		hist_add(&(thr->commit_hist), iotest_now() - tc);
+	    npend = 0;
+	}
+    }
+
+    if(npend){
+	log_commit(thr, devid, lo, hi);
+	if(iotest.shm->is_measuring)
+	    hist_add(&(thr->commit_hist), iotest_now() - tc);
+    }
+
+    thr->ts[1] = iotest_now();
+
+    if(VERBOSE4)
+	printf("TH[%d] ends.\n", id);
+}
+
+/*
+ * metatest(): metadata operations of the mix on files of the tree of a
+ * thread, made under its device, each timed as a whole; files of the
+ * tree are kept in slot[], those existing first
+ */
+
+static void metatest(int id)
+{
+    struct iotest_thr_t *thr = &(iotest.child[id]);
+    int devid = id % iotest.ndev;
+    int nfile = iotest.meta_files, nexist = 0;
+    int *slot, *pos;
+    int i, root, total = 0, is_reuse = 0, flags = 0;
+    char name[NAME_MAX], path[2][NAME_MAX];
+
+    if(VERBOSE4)
+	printf("TH[%d] starts.\n", id);
+
+    thr->seed = iotest_seed(id);
+
+    if((slot = (int *)malloc(sizeof(int) * nfile * 2)) == NULL){
+	perror("metatest:malloc()");
+	iotest_exit(EXIT_FAILURE);
+    }
+    pos = slot + nfile;
+    for(i=0; i<nfile; i++)
+	slot[i] = pos[i] = i;
+    for(i=0; i<NMETA; i++)
+	total += iotest.meta_mix[i];
+#ifdef __linux__
+    if(IS_DIRECTIO)
+	flags |= O_DIRECT;
+    if(IS_SYNCHRONOUS)
+	flags |= O_SYNC;
+#endif
+
+    /* The tree of a kept run is reused, emptied but for the fill. */
+    snprintf(name, sizeof(name), "iotest.%d", id);
+    if(mkdirat(iotest.fd[devid], name, 0755) != 0){
+	if(errno != EEXIST){
+	    perror("metatest:mkdirat()");
+	    iotest_exit(EXIT_FAILURE);
+	}
+	is_reuse = 1;
+    }
+    if((root = openat(iotest.fd[devid], name, O_RDONLY | O_DIRECTORY)) < 0){
+	perror("metatest:openat()");
+	iotest_exit(EXIT_FAILURE);
+    }
+    for(i=0; i<iotest.meta_dirs; i++){
+	snprintf(name, sizeof(name), "d%d", i);
+	if(mkdirat(root, name, 0755) != 0 && errno != EEXIST){
+	    perror("metatest:mkdirat()");
+	    iotest_exit(EXIT_FAILURE);
+	}
+    }
+    for(i=0; i<nfile; i++){
+	meta_path(path[0], i);
+	if(i < (long long)nfile * iotest.meta_fill / 100){
+	    int fd = openat(root, path[0], O_WRONLY | O_CREAT | O_TRUNC, 0644);
+	    if(fd < 0){
+		perror("metatest:openat()");
+		iotest_exit(EXIT_FAILURE);
+	    }
+	    close(fd);
+	    nexist++;
+	}else if(is_reuse && unlinkat(root, path[0], 0) != 0 && errno != ENOENT){
+	    perror("metatest:unlinkat()");
+	    iotest_exit(EXIT_FAILURE);
+	}
+    }
+
+    iotest_start(thr);
+
+    while(thr->nio < iotest.nio && !iotest.shm->is_stopping){
+	int op, r, a = -1, b = -1, fd, ret = 0, size = 0;
+	unsigned long long ts[2], lat;
+
+	for(op=0, r=rand_r(&(thr->seed))%total; r >= iotest.meta_mix[op]; op++)
+	    r -= iotest.meta_mix[op];
+
+	/* Operations on a file need one, and a new file a free name. */
+	if(op != META_CREATE && nexist == 0)
+	    op = META_CREATE;
+	else if((op == META_CREATE || op == META_RENAME) && nexist == nfile)
+	    op = META_UNLINK;
+	if(op != META_CREATE)
+	    a = slot[rand_r(&(thr->seed)) % nexist];
+	if(op == META_CREATE || op == META_RENAME)
+	    b = slot[nexist + rand_r(&(thr->seed)) % (nfile - nexist)];
+	meta_path(path[0], a >= 0 ? a : b);
+	if(b >= 0)
+	    meta_path(path[1], b);
+
+	ts[0] = iotest_now();
+	switch(op){
+	case META_CREATE:
+	    if((ret = fd = openat(root, path[0], O_WRONLY | O_CREAT | O_EXCL, 0644)) >= 0)
+		ret = close(fd);
+	    break;
+	case META_OPEN:
+	    if((ret = fd = openat(root, path[0], O_RDONLY)) >= 0)
+		ret = close(fd);
+	    break;
+	case META_WRITE:
+	case META_FSYNC:
+	    size = iotest.meta_size;
+	    if((ret = fd = openat(root, path[0], O_WRONLY | O_TRUNC | flags)) < 0)
+		break;
+	    if(pwrite(fd, thr->buf, size, 0) != size)
+		ret = -1;
+	    else if(op == META_FSYNC)
+		ret = fsync(fd);
+	    if(close(fd) != 0)
+		ret = -1;
+	    break;
+	case META_STAT:
+	{
+	    struct stat st;
+	    ret = fstatat(root, path[0], &st, 0);
+	    break;
+	}
+	case META_RENAME:
+	    ret = renameat(root, path[0], root, path[1]);
+	    break;
+	case META_UNLINK:
+	    ret = unlinkat(root, path[0], 0);
+	    break;
+	}
+	ts[1] = iotest_now();
+
+	if(ret < 0){
+	    fprintf(stderr, "Error: %s of %s failed: %s\n",
+		    meta_name[op], path[0], strerror(errno));
+	    iotest_exit(EXIT_FAILURE);
+	}
+
+	if(op == META_CREATE || op == META_RENAME){
+	    /* b becomes existing, swapped with the first free one */
+	    i = slot[nexist];
+	    slot[pos[b]] = i;
+	    pos[i] = pos[b];
+	    slot[nexist] = b;
+	    pos[b] = nexist++;
+	}
+	if(op == META_RENAME || op == META_UNLINK){
+	    /* a becomes free, swapped with the last existing one */
+	    i = slot[--nexist];
+	    slot[pos[a]] = i;
+	    pos[i] = pos[a];
+	    slot[nexist] = a;
+	    pos[a] = nexist;
+	}
+
+	thr->ndone++;
+	if(iotest.shm->is_measuring){
+	    if(!thr->ts[0])
+		thr->ts[0] = ts[0];
+	    iotest_account(thr, devid, size ? OP_WRITE : OP_READ,
+			   a >= 0 ? a : b, size, ts[0], ts[1]);
+	    lat = ts[1] - ts[0];
+	    hist_add(&(thr->meta_hist[op]), lat > iotest.timer_ovh ? lat - iotest.timer_ovh : 0);
+	}
+    }
+
+    thr->ts[1] = iotest_now();
+
+    if(!iotest.meta_keep){
+	for(i=0; i<nexist; i++){
+	    meta_path(path[0], slot[i]);
+	    unlinkat(root, path[0], 0);
+	}
+	for(i=0; i<iotest.meta_dirs; i++){
+	    snprintf(name, sizeof(name), "d%d", i);
+	    unlinkat(root, name, AT_REMOVEDIR);
+	}
+	snprintf(name, sizeof(name), "iotest.%d", id);
+	if(unlinkat(iotest.fd[devid], name, AT_REMOVEDIR) != 0)
+	    perror("metatest:unlinkat()");
+    }
+    close(root);
+    free(slot);
+
+    if(VERBOSE4)
+	printf("TH[%d] ends.\n", id);
+}
+
+/*
+ * meta_path(): name of a file of the tree, relative to its root; files
+ * are spread over the directories in turn
+ */
+
+static void meta_path(char *path, int n)
+{
+    snprintf(path, NAME_MAX, "d%d/f%d", n % iotest.meta_dirs, n);
+}
+
+/*
+ * oltp_read(): random page reads of the composite workload; those which
+ * overlap a checkpoint burst are recorded separately
+ */
+
+static void oltp_read(int id)
+{
+    struct iotest_thr_t *thr = &(iotest.child[id]);
+    unsigned long long next = 0;
+
+    if(VERBOSE4)
+	printf("TH[%d] starts.\n", id);
+
+    thr->seed = iotest_seed(id);
+
+    iotest_start(thr);
+
+    while(thr->nio < iotest.nio && !iotest.shm->is_stopping){
+	int devid, in_ckpt;
+	unsigned long long ofst;
+	unsigned long long ts[2];
+
+	iotest_pace(&next, thr->rate);
+
+	ofst = iotest_rand_ofst(thr, thr->blksiz);
+	devid = (int)(((double)iotest.ndev)*rand_r(&(thr->seed))/(RAND_MAX+1.0));
+
+	iotest_cache_sample(thr, thr->ndone, devid, ofst, thr->blksiz);
+
+	in_ckpt = iotest.shm->ckpt_active;
+	ts[0] = iotest_now();
+	iotest_pread(iotest.fd[devid], thr->buf, thr->blksiz, ofst);
+	ts[1] = iotest_now();
+	in_ckpt |= iotest.shm->ckpt_active;
+
+	thr->ndone++;
+	if(iotest.shm->is_measuring){
+	    if(!thr->ts[0])
+		thr->ts[0] = ts[0];
+	    iotest_account(thr, devid, OP_READ, ofst, thr->blksiz, ts[0], ts[1]);
+	    if(in_ckpt)
+		hist_add(&(thr->ckpt_hist), ts[1] - ts[0]);
+	}
+    }
+
+    thr->ts[1] = iotest_now();
+
+    if(VERBOSE4)
+	printf("TH[%d] ends.\n", id);
+}
+
+/*
+ * oltp_ckpt(): every ckpt_period, writes ckpt_pages random pages as fast
+ * as possible, shared among checkpoint threads, then syncs the devices
+ */
+
+static void oltp_ckpt(int id)
+{
+    struct iotest_thr_t *thr = &(iotest.child[id]);
+    int nckpt = iotest.oltp[ROLE_CKPT][0];
+    int npage = (iotest.ckpt_pages + nckpt - 1) / nckpt;
+    unsigned long long next;
+
+    if(VERBOSE4)
+	printf("TH[%d] starts.\n", id);
+
+    thr->seed = iotest_seed(id);
+
+    iotest_start(thr);
+
+    next = iotest_now() + (unsigned long long)iotest.ckpt_period * MEGA;
+    while(!iotest.shm->is_stopping){
+	int i, devid;
+	unsigned long long now, ofst, ts[2], tb;
+
+	/* Sleeps in short steps so as to notice the end of the run. */
+	if((now = iotest_now()) < next){
+	    struct timespec req;
+	    unsigned long long d = next - now < 10 * MEGA ? next - now : 10 * MEGA;
+	    req.tv_sec = 0;
+	    req.tv_nsec = d;
+	    nanosleep(&req, NULL);
+	    continue;
+	}
+	next += (unsigned long long)iotest.ckpt_period * MEGA;
+
+	__sync_fetch_and_add(&(iotest.shm->ckpt_active), 1);
+	tb = iotest_now();
+	for(i=0; i<npage && !iotest.shm->is_stopping; i++){
+	    ofst = iotest_rand_ofst(thr, thr->blksiz);
+	    devid = (int)(((double)iotest.ndev)*rand_r(&(thr->seed))/(RAND_MAX+1.0));
+
+	    ts[0] = iotest_now();
+	    iotest_pwrite(iotest.fd[devid], thr->buf, thr->blksiz, ofst);
+	    ts[1] = iotest_now();
+
+	    thr->ndone++;
+	    if(iotest.shm->is_measuring){
+		if(!thr->ts[0])
+		    thr->ts[0] = ts[0];
+		iotest_account(thr, devid, OP_WRITE, ofst, thr->blksiz, ts[0], ts[1]);
+	    }
+	}
+	for(devid=0; devid<iotest.ndev && !IS_NONOP; devid++)
+	    if(fdatasync(iotest.fd[devid]) != 0){
+		perror("oltp_ckpt:fdatasync()");
+		iotest_exit(EXIT_FAILURE);
+	    }
+	__sync_fetch_and_sub(&(iotest.shm->ckpt_active), 1);
+
+	if(iotest.shm->is_measuring){
+	    thr->nburst++;
+	    thr->burstim += iotest_now() - tb;
+	}
+    }
+
+    thr->ts[1] = iotest_now();
+
+    if(VERBOSE4)
+	printf("TH[%d] ends.\n", id);
+}
+
+/*
+ * log_commit(): makes appends in [lo, hi) durable. With group commit,
+ * a thread waits for a sync which started after its appends, and one of
+ * the waiters leads the next sync on behalf of all the others.
+ */
+
+static void log_commit(struct iotest_thr_t *thr, int devid,
+		       unsigned long long lo, unsigned long long hi)
+{
+    struct iotest_dev_t *dev = &(iotest.dev[devid]);
+    unsigned long long target, n;
+
+    if(iotest.shm->is_measuring)
+	thr->ncommit++;
+
+    if(!iotest.log_group){
+	log_sync(thr, devid, lo, hi - lo);
+	return;
+    }
+
+    pthread_mutex_lock(&(dev->mtx));
+    target = dev->sync_started + 1;
+    while(dev->sync_done < target){
+	if(!dev->is_syncing){
+	    dev->is_syncing = 1;
+	    n = ++dev->sync_started;
+	    pthread_mutex_unlock(&(dev->mtx));
+
+	    log_sync(thr, devid, 0, 0);
+
+	    pthread_mutex_lock(&(dev->mtx));
+	    dev->sync_done = n;
+	    dev->is_syncing = 0;
+	    pthread_cond_broadcast(&(dev->cond));
+	}else{
+	    pthread_cond_wait(&(dev->cond), &(dev->mtx));
+	}
+    }
+    pthread_mutex_unlock(&(dev->mtx));
+}
+
+/*
+ * log_sync(): issues one fsync, fdatasync or sync_file_range; len 0
+ * means to the end of the file
+ */
+
+static void log_sync(struct iotest_thr_t *thr, int devid,
+		     unsigned long long ofst, unsigned long long len)
+{
+    int fd = iotest.fd[devid], ret = 0;
+    unsigned long long ts[2];
+
+    if(IS_NONOP)
+	return;
+
+    ts[0] = iotest_now();
+    switch(iotest.log){
+    case LOG_FSYNC:
+	ret = fsync(fd);
+	break;
+    case LOG_FDATASYNC:
+	ret = fdatasync(fd);
+	break;
+    case LOG_SFR:
+#ifdef __linux__
+	ret = sync_file_range(fd, ofst, len,
+			      SYNC_FILE_RANGE_WAIT_BEFORE | SYNC_FILE_RANGE_WRITE |
+			      SYNC_FILE_RANGE_WAIT_AFTER);
+#else
+	ret = fdatasync(fd);
+#endif
+	break;
+    }
+    ts[1] = iotest_now();
+
+    if(ret != 0){
+	perror("log_sync:sync()");
+	iotest_exit(EXIT_FAILURE);
+    }
+
+    if(VERBOSE5)
+	printf("  sync(fd=%d, offset=%llu, len=%llu)\n", fd, ofst, len);
+
+    if(iotest.shm->is_measuring){
+	thr->nsync++;
+	hist_add(&(thr->sync_hist), ts[1] - ts[0]);
+    }
+}
+
+/*
+ * pipe_setup(): splits threads into submitters and completers, and sets
+ * up the aio context, eventfd and slot ring of each submitter
+ */
+
+static void pipe_setup(void)
+{
+    int i, s;
+
+    iotest.pipe_ncomp = iotest.nthr * iotest.pipe_c / (iotest.pipe_s + iotest.pipe_c);
+    if(iotest.pipe_ncomp < 1)
+	iotest.pipe_ncomp = 1;
+    iotest.pipe_nsub = iotest.nthr - iotest.pipe_ncomp;
+    if(iotest.pipe_nsub < 1){
+	fprintf(stderr, "Error: -Q requires -M of 2 or more.\n");
+	iotest_exit(EXIT_FAILURE);
+    }
+
+    if((iotest.pipe = (struct iotest_pipe_t *)calloc(iotest.pipe_nsub, sizeof(struct iotest_pipe_t))) == NULL){
+	perror("pipe_setup:calloc()");
+	iotest_exit(EXIT_FAILURE);
+    }
+    for(i=0; i<iotest.pipe_nsub; i++){
+	struct iotest_pipe_t *p = &(iotest.pipe[i]);
+	int r;
+
+	if((r = io_setup(iotest.naio, &(p->ctx))) != 0){
+	    errno = - r;
+	    perror("pipe_setup:io_setup()");
+	    iotest_exit(EXIT_FAILURE);
+	}
+	if((p->efd = eventfd(0, EFD_NONBLOCK)) < 0){
+	    perror("pipe_setup:eventfd()");
+	    iotest_exit(EXIT_FAILURE);
+	}
+
+	for(p->mask=1; p->mask<iotest.naio; p->mask<<=1)
+	    ;
+	p->iocbs = (struct iocb *)calloc(iotest.naio, sizeof(struct iocb));
+	p->batch = (struct iocb **)calloc(iotest.naio, sizeof(struct iocb *));
+	p->slot = (struct iotest_pipe_slot_t *)calloc(iotest.naio, sizeof(struct iotest_pipe_slot_t));
+	p->ring = (int *)calloc(p->mask, sizeof(int));
+	p->bufs = (char *)valloc((size_t)iotest.naio * iotest.blksiz);
+	if(p->iocbs == NULL || p->batch == NULL || p->slot == NULL || p->ring == NULL || p->bufs == NULL){
+	    perror("pipe_setup:malloc()");
+	    iotest_exit(EXIT_FAILURE);
+	}
+	memset(p->bufs, 0, (size_t)iotest.naio * iotest.blksiz);
+	p->mask--;
+
+	/* All the slots are free at first. */
+	for(s=0; s<iotest.naio; s++)
+	    p->ring[s] = s;
+	p->head = 0;
+	p->tail = iotest.naio;
+    }
+}
+
+/*
+ * pipe_teardown(): releases the resources of pipe_setup()
+ */
+
+static void pipe_teardown(void)
+{
+    int i;
+
+    for(i=0; i<iotest.pipe_nsub; i++){
+	struct iotest_pipe_t *p = &(iotest.pipe[i]);
+	io_destroy(p->ctx);
+	close(p->efd);
+	free(p->iocbs);
+	free(p->batch);
+	free(p->slot);
+	free(p->ring);
+	free(p->bufs);
+    }
+    free(iotest.pipe);
+    iotest.pipe = NULL;
+}
+#endif /* __linux__ */
+
+/*
+ * print_version():
+ */
+
+static void print_version(void)
+{
+    printf("%s %s\n", NAME, VERSION);
+    printf("%s %s\n", AUTHOR, CONTACT);
+}
+
+/*
+ * print_usage(): 
+ */
+
+static void print_usage(void)
+{
+    fputs("\
+Usage: iotest [options] devices_or_files ... \n\
+Description:\n\
+  I/O device test\n\
+Options (access mode):\n\
+  -R     : random access\n\
+  -S     : sequential access\n\
+  -W     : write operation; unless set, read operation\n\
+  -M <n> : multiplex degree of I/O threads; unless set, non-multiplexing\n\
+  -m     : multiplexing by worker processes instead of threads\n\
+  -A <n> : number of libaio contexts per thread; unless set, synchronous I/O\n\
+  -i <s> : I/O engine of -R and -S; unless set, libaio with -A, or sync\n\
+           sync   : pread and pwrite\n\
+           null   : no I/O (see -n)\n\
+           libaio : Linux native aio, keeping -A ios in flight\n\
+           aioring: Linux native aio on one context per thread; completions\n\
+                    are read from its ring in user space, and io_getevents()\n\
+                    is called only to wait. ,batch=<n> after the name submits\n\
+                    n ios per io_submit(), or all pending ones before a wait;\n\
+                    unless set, 1\n\
+  -Q <s>:<c> : libaio pipeline; -M threads are split into submitters and\n\
+           completers by the ratio s:c. A submitter keeps -A ios in flight on\n\
+           its own context and -c counts per submitter; completions wake its\n\
+           completer by eventfd and epoll, which returns the slots through a\n\
+           lock-free single-producer single-consumer ring\n\
+Options (I/O configuration):\n\
+  -b <n> : access block size (in bytes)\n\
+  -s <n> : block offset (in blocks) to start with; unless set, 0\n\
+  -e <n> : block offset (in blocks) to end with; unless set, size of device or file\n\
+  -c <n> : number of I/O operations\n\
+  -D <n> : duration (in s); runs stop at -c I/Os or at n seconds, whichever first\n\
+Options (traffic shaping of -R and -S):\n\
+  -k <s> : think time of a thread after each completion, from a distribution\n\
+           (in us):\n\
+           const=<n> | exp=<mean> | uniform=<lo>:<hi> | pareto=<mean>:<shape>\n\
+  -B <s> : on/off bursts; a thread issues n ios, waits for them to complete,\n\
+           then idles. Comma-separated:\n\
+           n=<n>     : ios per burst\n\
+           idle=<n>  : idle gap (in ms); unless set, 0\n\
+           exp       : idle gaps exponentially distributed with that mean\n\
+           first=<n> : first ios of each burst, reported separately; unless\n\
+                       set, 8\n\
+Options (log mode):\n\
+  -L <s> : log writer mode; sequential appends of -b bytes followed by syncs.\n\
+           Comma-separated:\n\
+           fsync | fdatasync | sfr : sync method (sfr: sync_file_range)\n\
+           n=<n>     : sync every n appends; unless set, 1\n\
+           us=<n>    : sync when the oldest unsynced append is n us old\n\
+           group     : group commit among threads appending to a device\n\
+Options (composite workload):\n\
+  -O <s> : OLTP-like composite workload of concurrent streams; requires -D.\n\
+           Comma-separated, each optional:\n\
+           log[=<threads>:<size>:<rate>]   : log appends, committed as -L;\n\
+                                             unless set, 1:4096:0\n\
+           read[=<threads>:<size>:<rate>]  : random page reads; unless set, 8:8192:0\n\
+           ckpt[=<ms>:<pages>:<size>:<threads>] : checkpoint bursts of random page\n\
+                                             writes and fdatasync; unless set,\n\
+                                             1000:256:8192:1\n\
+           rate is in IO/s per thread; 0 means unlimited.\n\
+Options (copy mode):\n\
+  -Y <s> : copies the -s..-e range of the first device to the second at the\n\
+           same offsets, in -b chunks split among -M threads, once with each\n\
+           method to compare. Comma-separated:\n\
+           rw | splice | cfr : read/write, splice through a pipe, or\n\
+                               copy_file_range\n\
+           all      : all of them\n\
+Options (metadata mode):\n\
+  -F <s> : metadata and small-file workload; each thread makes a tree of\n\
+           files under each directory given, runs a weighted mix of\n\
+           operations on them, and removes it. Comma-separated:\n\
+           create=<n> | open=<n> | write=<n> | fsync=<n> | stat=<n> |\n\
+           rename=<n> | unlink=<n> : weight of the operation; unless any is\n\
+                      set, 20,10,10,5,40,5,10 in this order. create makes an\n\
+                      empty file, write rewrites one with size bytes, fsync\n\
+                      also syncs it, and rename moves one to a free name\n\
+           files=<n>: files per thread; unless set, 1024\n\
+           dirs=<n> : directories per thread; unless set, 16\n\
+           size=<n> : write size (k, m or g suffix allowed); unless set, 4096\n\
+           fill=<n> : percentage of files made before the run; unless set, 50\n\
+           keep     : keeps the tree after the run\n\
+           -c counts operations per thread; unless set with -D, files\n\
+Options (prepare):\n\
+  -P <s> : prepare phase before the run; without -R, -S, -L or -O, only prepares.\n\
+           Comma-separated:\n\
+           alloc | fill | full : creates and fallocates the files; fill also\n\
+                      writes them sequentially in parallel (-M threads), and\n\
+                      full also overwrites them at random in -b blocks\n\
+           size=<n> : file size (k, m or g suffix allowed); unless set, -e\n\
+                      blocks or the current size\n\
+           chunk=<n>: write size of the fill; unless set, 1m\n\
+Options (IO event log):\n\
+  -E <s> : records ios in a per-thread ring and dumps them after the run.\n\
+           Comma-separated:\n\
+           n=<n>      : ring size (in records/thread); unless set, 65536\n\
+           thresh=<n> : records only ios taking n us or more\n\
+           file=<s>   : dumps to the file; unless set, standard output\n\
+Options (checkpoint):\n\
+  -K <s> : saves the results so far to a file every interval, replacing it\n\
+           atomically, and at the end of the run. Comma-separated:\n\
+           file=<s> : checkpoint file\n\
+           int=<n>  : interval (in s); unless set, 60\n\
+Options (heatmap):\n\
+  -H <s> : aggregates ios by offset into regions of the access range of each\n\
+           device, and writes their throughput and response time over time\n\
+           as region x interval matrices after the run. Comma-separated:\n\
+           regions=<n>: number of regions; unless set, 64\n\
+           int=<n>    : interval (in ms); unless set, 1000\n\
+           file=<s>   : writes to the file; unless set, standard output\n\
+Options (trials):\n\
+  -r <s> : runs the workload n times, and reports each trial, and mean,\n\
+           standard deviation, min/max and 95% confidence interval over them;\n\
+           outlying trials are flagged. -E and -H show the last one.\n\
+           Comma-separated:\n\
+           n=<n>    : number of trials\n\
+           cool=<n> : cooldown (in s) between trials; unless set, 0\n\
+           drop     : evicts the targets from the page cache before each\n\
+                      trial, as -C drop\n\
+Options (sweep):\n\
+  -G <s> : sweep mode; -M, -A and -b take comma-separated lists, e.g. -M 1,2,4\n\
+           grid     : runs all the combinations\n\
+           adapt    : doubles -M (1 to its max) until throughput saturates,\n\
+                      then searches for the knee\n\
+           knee=<n> : knee as percentage of peak throughput; unless set, 95\n\
+Options (page cache):\n\
+  -C <s> : page cache control of buffered I/O. Comma-separated:\n\
+           drop       : evicts cached pages of the targets before each run\n\
+                        (fadvise DONTNEED; BLKFLSBUF for block devices)\n\
+           dropall    : drop, and drops the whole page cache where permitted\n\
+           normal | random | sequential | willneed | noreuse : fadvise hint\n\
+           ra=<n>     : readahead (in KiB) of the devices; restored at exit\n\
+           hit=<n>    : samples page cache residency by mincore() every n reads\n\
+Options (live statistics):\n\
+  -Z <s> : publishes the running counters in a POSIX shared memory segment,\n\
+           to be watched (and stopped) by iotstat. Comma-separated:\n\
+           name=<s> : name of the segment\n\
+           int=<n>  : update interval (in ms); unless set, 1000\n\
+Options (coordinator):\n\
+  -z <s> : runs under iotcoord, which starts its iotests together and reports\n\
+           their counters combined. Comma-separated:\n\
+           path=<s> : Unix domain socket of the coordinator\n\
+           port=<n> : TCP port of the coordinator on 127.0.0.1\n\
+           name=<s> : name in the report; unless set, iotest.<pid>\n\
+Options (OS dependent configuration):\n\
+  -d <n> : direct mode, directly copying data from/to user space buffers\n\
+  -p <n> : synchronous mode, physically synchronizing data\n\
+Options (general configuration):\n\
+  -w <s> : steady state detection; measurement begins when the coefficient of\n\
+           variation of throughput falls under a threshold. Comma-separated:\n\
+           on        : enables with defaults\n\
+           cv=<n>    : threshold (in %); unless set, 5\n\
+           win=<n>   : number of samples in the window; unless set, 5\n\
+           int=<n>   : sampling interval (in ms); unless set, 200\n\
+           max=<n>   : maximum warm-up time (in s); unless set, 60\n\
+  -x <n> : seed of the random offsets and data of each thread, for runs to\n\
+           be repeated; unless set, from the time\n\
+  -t <s> : timer source, mono (CLOCK_MONOTONIC_RAW) or tsc (invariant TSC);\n\
+           unless set, mono, or tsc where -I says it is invariant\n\
+  -I <s> : capability profile made by checksize -p; the run is checked\n\
+           against the O_DIRECT alignment of the devices, -A is lowered to\n\
+           what aio-max-nr leaves, and the timer source is chosen\n\
+  -X     : counts cycles, instructions, LLC misses, branch misses, context\n\
+           switches and page faults of each thread by perf_event_open(), and\n\
+           reports them per I/O; those the host does not allow are left out\n\
+  -v     : verbose mode\n\
+  -n     : non-operation mode; does not really issue I/O. -R and -S run on the\n\
+           null engine, or on that of -i without its system calls, and report\n\
+           the throughput and CPU time per I/O of iotest itself\n\
+",
+	  stderr);
+}
+
+/*
+ * print_config(): print application configuration parameters
+ */
+
+void print_config(void)
+{
+    int i;
+    
+    printf("\
+************************************************************\n\
+  iotest - Configuration\n\
+************************************************************\n\
+");
+    
+    printf("  Device(s)            : %d \n", iotest.ndev);
+    for(i=0; i<iotest.ndev; i++)
+	printf("                         %s\n", iotest.dev[i].fname);
+    if(iotest.meta)
+	printf("  Access pattern       : Metadata operations\n");
+    else
+	printf("  Access pattern       : %s %s\n",
+	       IS_RANDOM ? "Fully random" : "Fully sequential",
+	       IS_READ ? "read" : "write");
+    printf("  IO mode option       : %s%s\n",
+	   IS_DIRECTIO ? "O_DIRECT " : "",
+	   IS_SYNCHRONOUS ? "O_SYNC " : "");
+    printf("  Multiplexing         : %s (multiplex degree: %d, %s)\n",
+	   IS_MULTIPLE ? "Yes" : "No",
+	   iotest.nthr,
+	   iotest.is_proc ? "processes" : "threads");
+    printf("  Aio                  : %s (number of contexts: %d)\n",
+	   iotest.naio ? "Yes" : "No",
+	   iotest.naio);
+    if(!iotest.log && !iotest.is_oltp && !iotest.copy && !iotest.pipe_s && !iotest.meta){
+	printf("  Engine               : %s (%s)",
+	       iotest_engine[engine_of_run()].name,
+	       iotest_engine[engine_of_run()].desc);
+	if(iotest.aio_batch > 1)
+	    printf(", %d [block] per io_submit()", iotest.aio_batch);
+	printf("%s\n", IS_NONOP ? ", no I/O issued" : "");
+    }
+    if(iotest.pipe_s)
+	printf("  Pipeline             : %d:%d (submitters:completers)\n",
+	       iotest.pipe_s, iotest.pipe_c);
+    if(iotest.prof_file){
+	printf("  Profile              : %s (invariant TSC: %s, io_uring: %s, aio events left: %lld)\n",
+	       iotest.prof_file,
+	       iotest.prof_tsc < 0 ? "unknown" : iotest.prof_tsc ? "yes" : "no",
+	       iotest.prof_io_uring < 0 ? "unknown" : iotest.prof_io_uring ? "yes" : "no",
+	       iotest.prof_aio);
+	for(i=0; i<iotest.ndev; i++)
+	    if(iotest.dev[i].dio_align >= 0 || iotest.dev[i].numa_node >= 0)
+		printf("                       : %s: O_DIRECT alignment %d [Byte], NUMA node %d\n",
+		       iotest.dev[i].fname, iotest.dev[i].dio_align, iotest.dev[i].numa_node);
+    }
+    printf("  Timer                : %s (overhead: %llu [ns])\n",
+	   iotest.timer == TIMER_TSC ? "TSC" : "CLOCK_MONOTONIC_RAW",
+	   iotest.timer_ovh);
+    if(iotest.seed)
+	printf("  Random seed          : %u\n", iotest.seed);
+    printf("  Block size           : %7d [Byte]\n",
+	   iotest.blksiz);
+    if(iotest.cache_drop || iotest.cache_advice >= 0 || iotest.cache_ra >= 0 || iotest.cache_hit){
+	char *advice[] = { "normal", "random", "sequential", "willneed", "dontneed", "noreuse" };
+	printf("  Page cache           : eviction %s, hint %s, readahead ",
+	       iotest.cache_drop == CACHE_DROP_ALL ? "system-wide" :
+	       iotest.cache_drop == CACHE_DROP_FILE ? "per file" : "none",
+	       iotest.cache_advice >= 0 ? advice[iotest.cache_advice] : "none");
+	if(iotest.cache_ra >= 0)
+	    printf("%d [KiB]", iotest.cache_ra);
+	else
+	    printf("default");
+	if(iotest.cache_hit)
+	    printf(", hit sampling every %d reads", iotest.cache_hit);
+	printf("\n");
+    }
+    if(iotest.copy)
+	printf("  Copy                 : %s -> %s by%s%s%s\n",
+	       iotest.dev[0].fname, iotest.dev[1].fname,
+	       iotest.copy & (1 << COPY_RW) ? " read/write" : "",
+	       iotest.copy & (1 << COPY_SPLICE) ? " splice" : "",
+	       iotest.copy & (1 << COPY_CFR) ? " copy_file_range" : "");
+    if(iotest.meta){
+	printf("  Metadata             : %d [file] in %d [dir] per thread, %d%% made before, %d [Byte] writes%s\n",
+	       iotest.meta_files, iotest.meta_dirs, iotest.meta_fill, iotest.meta_size,
+	       iotest.meta_keep ? ", kept" : "");
+	printf("                       :");
+	for(i=0; i<NMETA; i++)
+	    if(iotest.meta_mix[i])
+		printf(" %s %d", meta_name[i], iotest.meta_mix[i]);
+	printf("\n");
+    }
+    if(iotest.is_oltp)
+	printf("  Composite workload   : log %d x %d [Byte], read %d x %d [Byte], ckpt %d x %d [Byte]\n",
+	       iotest.oltp[ROLE_LOG][0], iotest.oltp[ROLE_LOG][1],
+	       iotest.oltp[ROLE_READ][0], iotest.oltp[ROLE_READ][1],
+	       iotest.oltp[ROLE_CKPT][0], iotest.oltp[ROLE_CKPT][1]);
+    if(iotest.duration)
+	printf("  Duration             : %d [s]\n", iotest.duration);
+    if(iotest.think){
+	char *dist[] = { "", "const", "exp", "uniform", "pareto" };
+	printf("  Think time           : %s %.3f", dist[iotest.think], iotest.think_a);
+	if(iotest.think >= DIST_UNIFORM)
+	    printf(":%.3f", iotest.think_b);
+	printf(" [us]\n");
+    }
+    if(iotest.onoff_n)
+	printf("  Bursts               : %d [block], idle %s%d [ms], first %d [block] reported\n",
+	       iotest.onoff_n, iotest.onoff_dist == DIST_EXP ? "exp " : "",
+	       iotest.onoff_idle, iotest.onoff_first);
+    if(iotest.is_perf){
+	printf("  Perf. counters       :");
+	for(i=0; i<NPERF; i++)
+	    if(iotest.perf_mask & (1 << i))
+		printf(" %s%s", iotest_perf[i].name, iotest.perf_mask >> (i + 1) ? "," : "");
+	printf("%s%s\n", iotest.perf_mask ? "" : " none available",
+	       iotest.perf_user ? " (user space only)" : "");
+    }
+    if(iotest.stat_name)
+	printf("  Live statistics      : %s every %d [ms]\n",
+	       iotest.stat_name, iotest.stat_int);
+    if(iotest.coord_path)
+	printf("  Coordinator          : %s\n", iotest.coord_path);
+    else if(iotest.coord_port)
+	printf("  Coordinator          : 127.0.0.1:%d\n", iotest.coord_port);
+    if(iotest.chk_file)
+	printf("  Checkpoint           : %s every %d [s]\n",
+	       iotest.chk_file, iotest.chk_int);
+    if(iotest.heat_nregion)
+	printf("  Heatmap              : %d [region] x every %d [ms] to %s\n",
+	       iotest.heat_nregion, iotest.heat_int,
+	       iotest.heat_file ? iotest.heat_file : "standard output");
+    if(iotest.log)
+	printf("  Log                  : %s every %d [append] / %d [us]%s\n",
+	       iotest.log == LOG_FSYNC ? "fsync" :
+	       iotest.log == LOG_FDATASYNC ? "fdatasync" : "sync_file_range",
+	       iotest.log_n, iotest.log_us,
+	       iotest.log_group ? ", group commit" : "");
+    if(iotest.is_steady)
+	printf("  Steady state         : cv <= %d%% over %d x %d [ms] (max. %d [s])\n",
+	       iotest.steady_cv, iotest.steady_win, iotest.steady_int, iotest.steady_max);
+    if(iotest.trial_n)
+	printf("  Trials               : %d, cooldown %d [s]%s\n",
+	       iotest.trial_n, iotest.trial_cool,
+	       iotest.cache_drop ? ", page cache evicted before each" : "");
+    if(iotest.sweep)
+	printf("  Sweep                : %s (knee: %d%% of peak)\n",
+	       iotest.sweep == SWEEP_GRID ? "Grid" : "Adaptive",
+	       iotest.knee);
+    if(iotest.meta){
+	if(iotest.nio == NIO_INF)
+	    printf("  Number of ops        : %12s [op] (until -D)\n", "unlimited");
+	else
+	    printf("  Number of ops        : %12llu [op] %12llu [op/thread]\n",
+		   iotest.nio * iotest.nthr, iotest.nio);
+	return;
+    }
+    printf("  Access region        : %12lu - %12lu (%12lu) [block]\n",
+	   iotest.ofst0,
+	   iotest.ofst1,
+	   iotest.ofst1-iotest.ofst0);
+    printf("                       : %12lld - %12lld (%12lld) [MB]\n",
+	   (unsigned long long)iotest.ofst0 * iotest.blksiz / MEGA,
+	   (unsigned long long)iotest.ofst1 * iotest.blksiz / MEGA,
+	   (unsigned long long)(iotest.ofst1-iotest.ofst0) * iotest.blksiz / MEGA);
+    printf("                       : %12lld - %12lld (%12lld) [MiB]\n",
+	   (unsigned long long)iotest.ofst0 * iotest.blksiz / MEBI,
+	   (unsigned long long)iotest.ofst1 * iotest.blksiz / MEBI,
+	   (unsigned long long)(iotest.ofst1-iotest.ofst0) * iotest.blksiz / MEBI);
+    if(iotest.nio == NIO_INF){
+	printf("  Number of I/Os       : %12s [block] (until -D)\n", "unlimited");
+	return;
+    }
+    printf("  Number of I/Os       : %12llu [block] %12llu [block/thread]\n",
+	   iotest.nio * iotest.nthr,
+	   iotest.nio);
+    printf("                       : %12llu [MB]    %12llu [MB/thread]\n",
+	   iotest.nio * iotest.blksiz / MEGA * iotest.nthr,
+	   iotest.nio * iotest.blksiz / MEGA);
+    printf("                       : %12llu [MiB]   %12llu [MiB/thread]\n",
+	   iotest.nio * iotest.blksiz / MEBI * iotest.nthr,
+    	   iotest.nio * iotest.blksiz / MEBI);
+}
+
+/*
+ * print_result():
+ */
+
+static void print_result()
+{
+    int i;
+    unsigned long long sum_nio = 0, sum_nbyte = 0, sum_acciotim = 0, sum_mxiotim = 0;
+    double elapsed = NSEC2DOUBLE(iotest.ts[1] - iotest.ts[0]);
+    
+    printf("\
+************************************************************\n\
+  iotest - Global result\n\
+************************************************************\n\
+");
+
+    for(i=0; i<iotest.nthr; i++){
+	sum_nio += iotest.child[i].nio;
+	sum_nbyte += iotest.child[i].nbyte;
+    }
+
+    if(iotest.stop_signo)
+	printf("  Stopped              : by %s\n", strsignal(iotest.stop_signo));
+    if(iotest.is_steady)
+	printf("  Warm-up time         : %9.3f [s]\n",
+	       NSEC2DOUBLE(iotest.warmup));
+    printf("  Exec. time           : %9.3f - %9.3f (%9.3f) [s]\n",
+	   0.0, elapsed, elapsed);
+
+    printf("  Total throughput     : %9.3f [block/s]\n",
+	   (double)sum_nio / elapsed);
+    printf("                       : %9.3f [MB/s]\n",
+	   (double)sum_nbyte / elapsed / MEGA);
+    printf("                       : %9.3f [MiB/s]\n",
+	   (double)sum_nbyte / elapsed / MEBI);
+
+    for(i=0; i<iotest.nthr; i++)
+	sum_acciotim += iotest.child[i].acciotim;
+    for(i=0; i<iotest.nthr; i++)
+	if(sum_mxiotim < iotest.child[i].mxiotim)
+	    sum_mxiotim = iotest.child[i].mxiotim;
+    printf("  Avg. Resp. time      : %9.6f [ms/block]\n",
+	   sum_nio ? NSEC2MSEC(sum_acciotim) / sum_nio : 0.0);
+    printf("  Max. Resp. time      : %9.6f [ms/block]\n",
+	   NSEC2MSEC(sum_mxiotim));
+    printf("  Accm. I/O time       : %9.3f [s]\n",
+	   NSEC2DOUBLE(sum_acciotim));
+    {
+	struct iotest_hist_t *h;
+	if((h = (struct iotest_hist_t *)calloc(1, sizeof(struct iotest_hist_t))) == NULL){
+	    perror("print_result:calloc()");
+	    iotest_exit(EXIT_FAILURE);
+	}
+	for(i=0; i<iotest.nthr; i++)
+	    hist_merge(h, &(iotest.child[i].hist));
+	printf("  Resp. time pctl.     : %9.6f %9.6f %9.6f [ms/block] (50%%, 99%%, 99.9%%)\n",
+	       NSEC2MSEC(iotest_hist_percentile(h->cnt, NULL, 50)),
+	       NSEC2MSEC(iotest_hist_percentile(h->cnt, NULL, 99)),
+	       NSEC2MSEC(iotest_hist_percentile(h->cnt, NULL, 99.9)));
+	free(h);
+    }
+    {
+	unsigned long long ndone = 0, cpu[2] = { 0, 0 };
+	double us;
+	for(i=0; i<iotest.nthr; i++){
+	    ndone += iotest.child[i].ndone;
+	    cpu[0] += iotest.child[i].cpu[0];
+	    cpu[1] += iotest.child[i].cpu[1];
+	}
+	us = ndone ? (double)(cpu[0] + cpu[1]) / ndone / KILO : 0.0;
+	printf("  CPU time             : %9.3f [us/block] (user %.3f, sys %.3f [us/block])\n",
+	       us,
+	       ndone ? (double)cpu[0] / ndone / KILO : 0.0,
+	       ndone ? (double)cpu[1] / ndone / KILO : 0.0);
+	if(IS_NONOP)
+	    printf("  Harness ceiling      : %9.3f [block/s] by %d thread(s); %9.3f [block/s] per CPU\n",
+		   (double)sum_nio / elapsed, iotest.nthr, us > 0 ? MEGA / us : 0.0);
+    }
+    if(iotest.is_perf){
+	unsigned long long ndone = 0, perf[NPERF];
+	int k, sep = 0;
+
+	memset(perf, 0, sizeof(perf));
+	for(i=0; i<iotest.nthr; i++){
+	    ndone += iotest.child[i].ndone;
+	    for(k=0; k<NPERF; k++)
+		perf[k] += iotest.child[i].perf[k];
+	}
+	printf("  Perf. counters       :");
+	if(!iotest.perf_mask || !ndone)
+	    printf(" not available\n");
+	for(k=0; iotest.perf_mask && ndone && k<NPERF; k++){
+	    if(!(iotest.perf_mask & (1 << k)))
+		continue;
+	    /* Software counters go on a line of their own. */
+	    if(k >= PERF_CS && sep == 1){
+		printf(" [/block]\n                       :");
+		sep = 0;
+	    }
+	    printf("%s %s %.3f", sep ? "," : "", iotest_perf[k].name, (double)perf[k] / ndone);
+	    if(k == PERF_INSTR && (iotest.perf_mask & (1 << PERF_CYCLES)) && perf[PERF_CYCLES])
+		printf(" (IPC %.3f)", (double)perf[PERF_INSTR] / perf[PERF_CYCLES]);
+	    sep = k < PERF_CS ? 1 : 2;
+	}
+	if(iotest.perf_mask && ndone)
+	    printf(" [/block]%s\n", iotest.perf_user ? " (user space only)" : "");
+    }
+    if(iotest.onoff_n){
+	struct iotest_hist_t *h, *f;
+	unsigned long long nonoff = 0, nfirst = 0, first_acc = 0, first_mx = 0;
+	int k;
+	if((h = (struct iotest_hist_t *)calloc(2, sizeof(struct iotest_hist_t))) == NULL){
+	    perror("print_result:calloc()");
+	    iotest_exit(EXIT_FAILURE);
+	}
+	f = h + 1;
+	for(i=0; i<iotest.nthr; i++){
+	    nonoff += iotest.child[i].nonoff;
+	    nfirst += iotest.child[i].first_nio;
+	    first_acc += iotest.child[i].first_acciotim;
+	    if(first_mx < iotest.child[i].first_mxiotim)
+		first_mx = iotest.child[i].first_mxiotim;
+	    hist_merge(h, &(iotest.child[i].hist));
+	    hist_merge(f, &(iotest.child[i].first_hist));
+	}
+	/* The rest are all the ios but the first ones. */
+	for(k=0; k<HIST_NBUCKET; k++)
+	    h->cnt[k] -= f->cnt[k];
+	printf("  Bursts               : %9llu (%llu [block] of them first)\n",
+	       nonoff, nfirst);
+	printf("  First ios of bursts  : %9.6f %9.6f %9.6f %9.6f [ms/block] (avg, 50%%, 99%%, max)\n",
+	       nfirst ? NSEC2MSEC(first_acc) / nfirst : 0.0,
+	       NSEC2MSEC(iotest_hist_percentile(f->cnt, NULL, 50)),
+	       NSEC2MSEC(iotest_hist_percentile(f->cnt, NULL, 99)),
+	       NSEC2MSEC(first_mx));
+	printf("  Other ios            : %9.6f %9.6f %9.6f [ms/block] (avg, 50%%, 99%%)\n",
+	       sum_nio > nfirst ? NSEC2MSEC(sum_acciotim - first_acc) / (sum_nio - nfirst) : 0.0,
+	       NSEC2MSEC(iotest_hist_percentile(h->cnt, NULL, 50)),
+	       NSEC2MSEC(iotest_hist_percentile(h->cnt, NULL, 99)));
+	free(h);
+    }
+    if(iotest.pipe_s){
+	unsigned long long nbatch = 0, nstall = 0, nwake = 0, ndone = 0;
+	for(i=0; i<iotest.pipe_nsub; i++){
+	    nbatch += iotest.child[i].nbatch;
+	    nstall += iotest.child[i].nstall;
+	}
+	for(; i<iotest.nthr; i++){
+	    nwake += iotest.child[i].nwake;
+	    ndone += iotest.child[i].ndone;
+	}
+	printf("  Pipeline             : %9.3f [IO/submit] %9.3f [IO/wake-up] %llu [stall]\n",
+	       nbatch ? (double)ndone / nbatch : 0.0,
+	       nwake ? (double)ndone / nwake : 0.0,
+	       nstall);
+    }
+    if(iotest.cache_hit){
+	unsigned long long n = 0, hit = 0;
+	for(i=0; i<iotest.nthr; i++){
+	    n += iotest.child[i].ncache_sample;
+	    hit += iotest.child[i].ncache_hit;
+	}
+	printf("  Page cache hit ratio : %9.3f [%%] (%llu pages sampled; %.3f [%%] resident at start)\n",
+	       n ? (double)hit * 100 / n : 0.0, n, iotest.cache_resident);
+    }
+    
+    if(VERBOSE2){
+
+	printf("\
+************************************************************\n\
+  iotest - Child result(s)\n\
+************************************************************\n\
+");
+	
+	for(i=0; i<iotest.nthr; i++)
+	    print_result_child(i);
+    }
+    if(VERBOSE2){
+
+	printf("\
+************************************************************\n\
+  iotest - Device result(s)\n\
+************************************************************\n\
+");
+	
+	for(i=0; i<iotest.ndev; i++)
+	    print_result_dev(i);
+    }
+}
+
+static void print_result_child(int id)
+{
+    struct iotest_thr_t *thr = &(iotest.child[id]);
+    double elapsed = NSEC2DOUBLE(thr->ts[1] - thr->ts[0]);
+
+    printf("  [%02d] Exec. time      : %9.3f - %9.3f (%9.3f) [s]\n",
+	   id,
+	   NSEC2DOUBLE((long long)(thr->ts[0] - iotest.ts[0])),
+	   NSEC2DOUBLE((long long)(thr->ts[1] - iotest.ts[0])),
+	   elapsed);
+
+    printf("       Throughput      : %9.3f [block/s]\n",
+	   (double)thr->nio / elapsed);
+    printf("                       : %9.3f [MB/s]\n",
+	   (double)thr->nbyte / elapsed / MEGA);
+    printf("                       : %9.3f [MiB/s]\n",
+	   (double)thr->nbyte / elapsed / MEBI);
+
+    printf("       Avg. Resp. time : %9.6f [ms/block]\n",
+	   thr->nio ? NSEC2MSEC(thr->acciotim) / thr->nio : 0.0);
+    printf("       Max. Resp. time : %9.6f [ms/block]\n",
+	   NSEC2MSEC(thr->mxiotim));
+    printf("       Accm. I/O time  : %9.3f [s]\n",
+	   NSEC2DOUBLE(thr->acciotim));
+}
+
+static void print_result_dev(int id)
+{
+    struct iotest_dev_t *dev = &(iotest.dev[id]);
+    double elapsed = NSEC2DOUBLE(iotest.ts[1] - iotest.ts[0]);
+
+    printf("  [%02d] Throughput      : %9.3f [block/s]\n",
+	   id,
+	   (double)dev->nio / elapsed);
+    printf("                       : %9.3f [MB/s]\n",
+	   (double)dev->nbyte / elapsed / MEGA);
+    printf("                       : %9.3f [MiB/s]\n",
+	   (double)dev->nbyte / elapsed / MEBI);
+
+    printf("       Avg. Resp. time : %9.6f [ms/block]\n",
+	   dev->nio ? NSEC2MSEC(dev->acciotim) / dev->nio : 0.0);
+    printf("       Max. Resp. time : %9.6f [ms/block]\n",
+	   NSEC2MSEC(dev->mxiotim));
+    printf("       Accm. I/O time  : %9.3f [s]\n",
+	   NSEC2DOUBLE(dev->acciotim));
+}
+
+/*
+ * print_result_log(): prints write, sync and commit response times
+ */
+
+static void print_result_log(void)
+{
+    int i;
+    unsigned long long ncommit = 0, nsync = 0, acciotim = 0;
+    double elapsed = NSEC2DOUBLE(iotest.ts[1] - iotest.ts[0]);
+    struct iotest_hist_t *h;
+
+    printf("\
+************************************************************\n\
+  iotest - Log result\n\
+************************************************************\n\
+");
+
+    for(i=0; i<iotest.nthr; i++){
+	ncommit += iotest.child[i].ncommit;
+	nsync += iotest.child[i].nsync;
+	acciotim += iotest.child[i].acciotim;
+    }
+    printf("  Commits              : %12llu (%9.3f [commit/s])\n",
+	   ncommit, (double)ncommit / elapsed);
+    printf("  Syncs                : %12llu (%9.3f [sync/s], %6.2f [commit/sync])\n",
+	   nsync, (double)nsync / elapsed,
+	   nsync ? (double)ncommit / nsync : 0.0);
+
+    if((h = (struct iotest_hist_t *)malloc(sizeof(struct iotest_hist_t))) == NULL){
+	perror("print_result_log:malloc()");
+	iotest_exit(EXIT_FAILURE);
+    }
+    memset(h, 0, sizeof(struct iotest_hist_t));
+    for(i=0; i<iotest.nthr; i++)
+	hist_merge(h, &(iotest.child[i].hist));
+    print_hist("Write resp. time", h, acciotim);
+
+    memset(h, 0, sizeof(struct iotest_hist_t));
+    for(i=0; i<iotest.nthr; i++)
+	hist_merge(h, &(iotest.child[i].sync_hist));
+    print_hist("Sync resp. time", h, 0);
+
+    memset(h, 0, sizeof(struct iotest_hist_t));
+    for(i=0; i<iotest.nthr; i++)
+	hist_merge(h, &(iotest.child[i].commit_hist));
+    print_hist("Commit resp. time", h, 0);
+
+    free(h);
+}
+
+/*
+ * print_result_meta(): prints throughput and response times per
+ * metadata operation
+ */
+
+static void print_result_meta(void)
+{
+    int i, op;
+    double elapsed = NSEC2DOUBLE(iotest.ts[1] - iotest.ts[0]);
+    struct iotest_hist_t *h;
+
+    printf("\
+************************************************************\n\
+  iotest - Metadata result\n\
+************************************************************\n\
+");
+
+    if((h = (struct iotest_hist_t *)malloc(sizeof(struct iotest_hist_t))) == NULL){
+	perror("print_result_meta:malloc()");
+	iotest_exit(EXIT_FAILURE);
+    }
+
+    for(op=0; op<NMETA; op++){
+	unsigned long long n = 0;
+	char label[32];
+
+	memset(h, 0, sizeof(struct iotest_hist_t));
+	for(i=0; i<iotest.nthr; i++)
+	    hist_merge(h, &(iotest.child[i].meta_hist[op]));
+	for(i=0; i<HIST_NBUCKET; i++)
+	    n += h->cnt[i];
+	if(!n && !iotest.meta_mix[op])
+	    continue;
+
+	printf("  %-20s : %12llu (%9.3f [op/s])\n", meta_name[op], n, (double)n / elapsed);
+	snprintf(label, sizeof(label), "%s resp. time", meta_name[op]);
+	print_hist(label, h, 0);
+    }
+
+    free(h);
+}
+
+/*
+ * print_result_oltp(): prints throughput and response times per stream
+ */
+
+static void print_result_oltp(void)
+{
+    int i, r, n;
+    char *name[NROLE] = { "Log", "Read", "Ckpt" };
+    double elapsed = NSEC2DOUBLE(iotest.ts[1] - iotest.ts[0]);
+    struct iotest_hist_t *h, *hc;
+
+    printf("\
+************************************************************\n\
+  iotest - Stream result(s)\n\
+************************************************************\n\
+");
+
+    if((h = (struct iotest_hist_t *)malloc(sizeof(struct iotest_hist_t) * 2)) == NULL){
+	perror("print_result_oltp:malloc()");
+	iotest_exit(EXIT_FAILURE);
+    }
+    hc = h + 1;
+
+    for(r=0, n=0; r<NROLE; n+=iotest.oltp[r][0], r++){
+	unsigned long long nio = 0, nbyte = 0, acciotim = 0;
+	unsigned long long ncommit = 0, nburst = 0, burstim = 0;
+
+	if(!iotest.oltp[r][0])
+	    continue;
+
+	memset(h, 0, sizeof(struct iotest_hist_t) * 2);
+	for(i=n; i<n+iotest.oltp[r][0]; i++){
+	    struct iotest_thr_t *thr = &(iotest.child[i]);
+	    nio += thr->nio;
+	    nbyte += thr->nbyte;
+	    acciotim += thr->acciotim;
+	    ncommit += thr->ncommit;
+	    nburst += thr->nburst;
+	    burstim += thr->burstim;
+	    hist_merge(h, &(thr->hist));
+	    hist_merge(hc, r == ROLE_LOG ? &(thr->commit_hist) : &(thr->ckpt_hist));
+	}
+
+	printf("  %-4s stream          : %d thread(s), %d [Byte]",
+	       name[r], iotest.oltp[r][0], iotest.oltp[r][1]);
+	if(r == ROLE_CKPT)
+	    printf(", %d pages every %d [ms]\n", iotest.ckpt_pages, iotest.ckpt_period);
+	else if(iotest.oltp[r][2])
+	    printf(", %d [IO/s/thread]\n", iotest.oltp[r][2]);
+	else
+	    printf(", unlimited\n");
+	printf("  Throughput           : %9.3f [block/s] %9.3f [MB/s]\n",
+	       (double)nio / elapsed, (double)nbyte / elapsed / MEGA);
+
+	switch(r){
+	case ROLE_LOG:
+	    print_hist("Append resp. time", h, acciotim);
+	    printf("  Commits              : %12llu (%9.3f [commit/s])\n",
+		   ncommit, (double)ncommit / elapsed);
+	    print_hist("Commit resp. time", hc, 0);
+	    break;
+	case ROLE_READ:
+	    print_hist("Read resp. time", h, acciotim);
+	    print_hist("  during ckpt", hc, 0);
+	    for(i=0; i<HIST_NBUCKET; i++)
+		h->cnt[i] -= hc->cnt[i];
+	    print_hist("  outside ckpt", h, 0);
+	    break;
+	case ROLE_CKPT:
+	    print_hist("Write resp. time", h, acciotim);
+	    printf("  Bursts               : %12llu (avg. %9.3f [s/burst])\n",
+		   nburst, nburst ? NSEC2DOUBLE(burstim) / nburst : 0.0);
+	    break;
+	}
+    }
+
+    free(h);
+}
+
+/*
+ * print_result_copy(): compares the copy methods
+ */
+
+static void print_result_copy(void)
+{
+    char *name[] = { "read/write", "splice", "copy_file_range" };
+    int m;
+
+    printf("\
+************************************************************\n\
+  iotest - Copy result\n\
+************************************************************\n\
+");
+    printf("  %-16s %12s %10s %12s %12s\n",
+	   "method", "[block/s]", "[MB/s]", "avg [ms]", "max [ms]");
+    for(m=0; m<NCOPY; m++){
+	struct iotest_point_t *pt = &(iotest.copy_point[m]);
+	double elapsed = NSEC2DOUBLE(pt->elapsed);
+	if(!(iotest.copy & (1 << m)))
+	    continue;
+	printf("  %-16s %12.3f %10.3f %12.6f %12.6f\n",
+	       name[m],
+	       (double)pt->nio / elapsed,
+	       (double)pt->nio * pt->blksiz / elapsed / MEGA,
+	       pt->nio ? NSEC2MSEC(pt->acciotim) / pt->nio : 0.0,
+	       NSEC2MSEC(pt->mxiotim));
+    }
 }
 
+/*
+ * dump_events(): writes the IO event records of all threads in time order
+ */
 
-#ifdef __linux__
-static void disktest_libaio(int id)
+static void dump_events(void)
 {
     int i;
-    struct iotest_thr_t *thr;
-
-    thr = &(iotest.child[id]);
-    
-    /*
-     * Begin
-     */
-    
-    if(VERBOSE4)
-	printf("TH[%d] starts.\n", id);
+    unsigned long long n = 0, nrec = 0, k;
+    struct iotest_rec_t *recs;
+    FILE *fp = stdout;
 
-    gettimeofday(&(thr->tv[0]), NULL);
-
-    if((thr->acs = (struct iotest_aio_context_t *)malloc(sizeof(struct iotest_aio_context_t) * iotest.naio)) == NULL){
-	perror("disktest_libaio:malloc():acs");
-	exit(EXIT_FAILURE);
+    for(i=0; i<iotest.nthr; i++){
+	struct iotest_thr_t *thr = &(iotest.child[i]);
+	nrec += thr->nrec;
+	n += thr->nrec < iotest.rec_size ? thr->nrec : iotest.rec_size;
     }
+    if((recs = (struct iotest_rec_t *)malloc(sizeof(struct iotest_rec_t) * (n ? n : 1))) == NULL){
+	perror("dump_events:malloc()");
+	iotest_exit(EXIT_FAILURE);
+    }
+    for(i=0, k=0; i<iotest.nthr; i++){
+	struct iotest_thr_t *thr = &(iotest.child[i]);
+	unsigned long long m = thr->nrec < iotest.rec_size ? thr->nrec : iotest.rec_size;
+	memcpy(recs + k, thr->rec, sizeof(struct iotest_rec_t) * m);
+	k += m;
+    }
+    qsort(recs, n, sizeof(struct iotest_rec_t), cmp_rec);
 
-    for(i=0; i<iotest.naio; i++){
-
-	struct iotest_aio_context_t *ac = &(thr->acs[i]);
-	int r;
-	
-	ac->id = i;
-	
-	memset(&(ac->ctx), 0, sizeof(io_context_t));
-	if((r = io_setup(1, &(ac->ctx))) != 0){
-	    errno = - r;
-	    perror("disktest:io_setup()");
-	    exit(EXIT_FAILURE);
-	}
-
-	if((ac->iocbs[0] = (struct iocb *)malloc(sizeof(struct iocb))) == NULL){
-	    perror("disktest_libaio:malloc():iocbs");
-	    exit(EXIT_FAILURE);
-	}
-
-	if((ac->bufs[0] = (char *)valloc(iotest.blksiz)) == NULL){
-	    perror("disktest_libaio:malloc():bufs");
-	    exit(EXIT_FAILURE);
-	}	
+    if(iotest.rec_file && (fp = fopen(iotest.rec_file, "w")) == NULL){
+	perror("dump_events:fopen()");
+	iotest_exit(EXIT_FAILURE);
+    }
+    if(fp == stdout)
+	printf("\
+************************************************************\n\
+  iotest - IO event log\n\
+************************************************************\n\
+");
+    fprintf(fp, "# %llu records of %llu ios at or over %.3f [ms] (%llu overwritten)\n",
+	    n, nrec, NSEC2MSEC(iotest.rec_thresh), nrec - n);
+    fprintf(fp, "# %17s %12s %5s %4s %2s %16s %8s %12s\n",
+	    "wall clock [s]", "elapsed [s]", "thr", "dev", "op", "offset", "size", "resp. [ms]");
+    for(k=0; k<n; k++){
+	struct iotest_rec_t *r = &(recs[k]);
+	unsigned long long wall = iotest.rt0 + r->ts;
+	fprintf(fp, "  %10llu.%06llu %12.6f %5u %4u %2s %16llu %8u %12.6f\n",
+		wall / GIGA, wall % GIGA / KILO,
+		NSEC2DOUBLE((long long)(r->ts - iotest.ts[0])),
+		r->thr, r->dev, r->op == OP_READ ? "R" : "W",
+		r->ofst, r->size, NSEC2MSEC(r->lat));
     }
+    if(fp != stdout)
+	fclose(fp);
 
-    /*
-     * Loop
-     */
+    free(recs);
+}
 
-    int cid = 0, nio_completed = 0, nio_issued = 0;
+static int cmp_rec(const void *a, const void *b)
+{
+    const struct iotest_rec_t *ra = a, *rb = b;
 
-    while(1){
-	int ret;
-	struct iotest_aio_context_t *ac;
-	ac = &(thr->acs[cid % iotest.naio]);
-	cid++;
-	if(!iotest_aio_check_io_ongoing(ac)){
-	    /* Context can be processed. */
-
-	    if(nio_issued < iotest.nio){
-		
-		i = nio_issued;
-		
-		if(1){
-		    
-		    int devid;
-		    unsigned long long ofst;
-
-		    if(i==0){
-			if(IS_RANDOM)
-			    srand(time(0));
-		    }
+    return(ra->ts < rb->ts ? -1 : ra->ts > rb->ts ? 1 : 0);
+}
 
-		    if(IS_RANDOM){
-			ofst = (unsigned long long)iotest.ofst0;
-			ofst += (unsigned long long)((unsigned long long)iotest.ofst1-(unsigned long long)iotest.ofst0)*rand()/(RAND_MAX+1.0);
-			ofst *=  iotest.blksiz;
-		    }else{
-			ofst = (iotest.ofst0 + i) * iotest.blksiz;
-		    }
+/*
+ * dump_heat(): writes, for each device, IO/s, MB/s, average and maximum
+ * response time as matrices of regions by intervals, in the nonuniform
+ * matrix format of gnuplot; blocks are separated by two blank lines
+ */
 
-		    if(IS_RANDOM)
-			devid = (int)(((double)iotest.ndev)*rand()/(RAND_MAX+1.0));
-		    else
-			devid = thr->id % iotest.ndev;
-		    
-		    gettimeofday(&(ac->tv[0]), NULL);
-		    if(IS_READ)
-			iotest_aio_pread(ac,
-					 iotest.dev[devid].fd, ac->bufs[0], iotest.blksiz, ofst);
-		    else
-			iotest_aio_pwrite(ac,
-					  iotest.dev[devid].fd, ac->bufs[0], iotest.blksiz, ofst);
-		    gettimeofday(&(ac->tv[1]), NULL);
-		    
-		    TIMEVAL_SUB(ac->tv[1], ac->tv[0]);
-		    thr->acciotim += TIMEVAL2DOUBLE(ac->tv[1]);
-		    if(thr->mxiotim < TIMEVAL2DOUBLE(ac->tv[1]))
-			thr->mxiotim = TIMEVAL2DOUBLE(ac->tv[1]);
-		    thr->nio++;
-		    iotest.dev[devid].acciotim += TIMEVAL2DOUBLE(ac->tv[1]);
-		    if(iotest.dev[devid].mxiotim < TIMEVAL2DOUBLE(ac->tv[1]))
-			iotest.dev[devid].mxiotim = TIMEVAL2DOUBLE(ac->tv[1]);
-		    iotest.dev[devid].nio++;
-
-		} /* if(1) */
-		    
-		nio_issued++;
+static void dump_heat(void)
+{
+    char *metric[] = { "[IO/s]", "[MB/s]", "avg. resp. [ms]", "max. resp. [ms]" };
+    int ncell = iotest.ndev * iotest.heat_nregion, nint = iotest.heat_nsnap - 1;
+    double span = (double)(iotest.ofst1 - iotest.ofst0) * iotest.blksiz / iotest.heat_nregion;
+    int d, m, r, j;
+    FILE *fp = stdout;
+
+    if(iotest.heat_file && (fp = fopen(iotest.heat_file, "w")) == NULL){
+	perror("dump_heat:fopen()");
+	iotest_exit(EXIT_FAILURE);
+    }
+    if(fp == stdout)
+	printf("\
+************************************************************\n\
+  iotest - Heatmap\n\
+************************************************************\n\
+");
+    fprintf(fp, "# %d [region] of %.3f [MiB] x %d [interval] of %d [ms]\n",
+	    iotest.heat_nregion, span / MEBI, nint, iotest.heat_int);
+    fprintf(fp, "# first row: end of interval [s] from the start of measurement\n");
+    fprintf(fp, "# first column: start of region [MiB]\n");
+
+    for(d=0; d<iotest.ndev; d++)
+	for(m=0; m<4; m++){
+	    fprintf(fp, "\n# %s %s\n", iotest.dev[d].fname, metric[m]);
+	    fprintf(fp, "%d", nint);
+	    for(j=1; j<=nint; j++)
+		fprintf(fp, " %.3f", NSEC2DOUBLE((long long)(iotest.heat_ts[j] - iotest.ts[0])));
+	    fprintf(fp, "\n");
+	    for(r=0; r<iotest.heat_nregion; r++){
+		fprintf(fp, "%.3f", ((double)iotest.ofst0 * iotest.blksiz + span * r) / MEBI);
+		for(j=1; j<=nint; j++){
+		    struct iotest_heat_t *c = &(iotest.heat[(size_t)j * ncell + d * iotest.heat_nregion + r]);
+		    struct iotest_heat_t *p = c - ncell;
+		    double dt = NSEC2DOUBLE(iotest.heat_ts[j] - iotest.heat_ts[j-1]);
+		    unsigned long long nio = c->nio - p->nio;
+		    double v;
+
+		    switch(m){
+		    case 0:
+			v = dt > 0 ? nio / dt : 0;
+			break;
+		    case 1:
+			v = dt > 0 ? (double)(c->nbyte - p->nbyte) / dt / MEGA : 0;
+			break;
+		    case 2:
+			v = nio ? NSEC2MSEC(c->acciotim - p->acciotim) / nio : 0;
+			break;
+		    default:
+			v = NSEC2MSEC(c->mxiotim);
+			break;
+		    }
+		    fprintf(fp, " %.6f", v);
+		}
+		fprintf(fp, "\n");
 	    }
-	}else{
-	    /* IO is still being operated. */
+	    fprintf(fp, "\n");
 	}
 
-	if((ret = iotest_aio_return(ac)))
-	    nio_completed += ret;
-
-	if(nio_completed >= iotest.nio)
-	    break;
-    }
-    
-    /*
-     * Finish
-     */
+    if(fp != stdout)
+	fclose(fp);
+}
 
-    gettimeofday(&(thr->tv[1]), NULL);
+/*
+ * perf_probe(): finds the counters of -X which this host lets iotest
+ * open; counting kernel space as well where it is permitted
+ */
 
-    if(VERBOSE4)
-	printf("TH[%d] ends.\n", id);
+static void perf_probe(void)
+{
+#ifdef __linux__
+    int i, fd;
+
+    iotest.perf_mask = 0;
+    iotest.perf_user = 0;
+    for(i=0; i<NPERF; i++){
+	if((fd = perf_open(i)) < 0 && (errno == EACCES || errno == EPERM) && !iotest.perf_user){
+	    iotest.perf_user = 1;
+	    fd = perf_open(i);
+	}
+	if(fd < 0){
+	    if(VERBOSE1)
+		fprintf(stderr, "Warning: Counter of %s is not available: %s\n",
+			iotest_perf[i].name, strerror(errno));
+	    continue;
+	}
+	close(fd);
+	iotest.perf_mask |= 1 << i;
+    }
+    if(!iotest.perf_mask)
+	fprintf(stderr, "Warning: No performance counter is available.\n");
+#endif
 }
-#endif /* __linux__ */
 
 /*
- * print_version():
+ * perf_open(): opens a counter of the calling thread, counting from now
  */
 
-static void print_version(void)
+static int perf_open(int k)
 {
-    printf("%s %s\n", NAME, VERSION);
-    printf("%s %s\n", AUTHOR, CONTACT);
+#ifdef __linux__
+    struct perf_event_attr attr;
+
+    memset(&attr, 0, sizeof(attr));
+    attr.size = sizeof(attr);
+    attr.type = iotest_perf[k].type;
+    attr.config = iotest_perf[k].config;
+    attr.read_format = PERF_FORMAT_TOTAL_TIME_ENABLED | PERF_FORMAT_TOTAL_TIME_RUNNING;
+    attr.exclude_kernel = iotest.perf_user;
+    attr.exclude_hv = 1;
+
+    return(syscall(SYS_perf_event_open, &attr, 0, -1, -1, PERF_FLAG_FD_CLOEXEC));
+#else
+    errno = ENOSYS;
+    return(-1);
+#endif
 }
 
 /*
- * print_usage(): 
+ * perf_start(), perf_stop(): counters of a worker over its run; counts
+ * are scaled up by the time a counter was multiplexed out
  */
 
-static void print_usage(void)
+static void perf_start(struct iotest_thr_t *thr)
 {
-    fputs("\
-Usage: iotest [options] devices_or_files ... \n\
-Description:\n\
-  I/O device test\n\
-Options (access mode):\n\
-  -R     : random access\n\
-  -S     : sequential access\n\
-  -W     : write operation; unless set, read operation\n\
-  -M <n> : multiplex degree of I/O threads; unless set, non-multiplexing\n\
-Options (I/O configuration):\n\
-  -b <n> : access block size (in bytes)\n\
-  -s <n> : block offset (in blocks) to start with; unless set, 0\n\
-  -e <n> : block offset (in blocks) to end with; unless set, size of device or file\n\
-  -c <n> : number of I/O operations\n\
-Options (OS dependent configuration):\n\
-  -d <n> : direct mode, directly copying data from/to user space buffers\n\
-  -p <n> : synchronous mode, physically synchronizing data\n\
-Options (general configuration):\n\
-  -v     : verbose mode\n\
-  -n     : non-operation mode; does not really issue I/O\n\
-",
-	  stderr);
+    int i;
+
+    for(i=0; i<NPERF; i++)
+	thr->perf_fd[i] = iotest.perf_mask & (1 << i) ? perf_open(i) : -1;
+}
+
+static void perf_stop(struct iotest_thr_t *thr)
+{
+    unsigned long long v[3];
+    int i;
+
+    for(i=0; i<NPERF; i++){
+	if(thr->perf_fd[i] < 0)
+	    continue;
+	if(read(thr->perf_fd[i], v, sizeof(v)) == sizeof(v) && v[2])
+	    thr->perf[i] = (unsigned long long)((double)v[0] * v[1] / v[2]);
+	close(thr->perf_fd[i]);
+	thr->perf_fd[i] = -1;
+    }
 }
 
 /*
- * print_config(): print application configuration parameters
+ * print_hist(): prints average and percentiles of a histogram in ms;
+ * the average is taken from the buckets unless sum is given
  */
 
-void print_config(void)
+static void print_hist(char *label, struct iotest_hist_t *h, unsigned long long sum)
 {
     int i;
-    
-    printf("\
-************************************************************\n\
-  iotest - Configuration\n\
-************************************************************\n\
-");
-    
-    printf("  Device(s)            : %d \n", iotest.ndev);
-    for(i=0; i<iotest.ndev; i++)
-	printf("                         %s\n", iotest.dev[i].fname);
-    printf("  Access pattern       : %s %s\n",
-	   IS_RANDOM ? "Fully random" : "Fully sequential",
-	   IS_READ ? "read" : "write");
-    printf("  IO mode option       : %s%s\n",
-	   IS_DIRECTIO ? "O_DIRECT " : "",
-	   IS_SYNCHRONOUS ? "O_SYNC " : "");
-    printf("  Multiplexing         : %s (multiplex degree: %d)\n",
-	   IS_MULTIPLE ? "Yes" : "No",
-	   iotest.nthr);
-    printf("  Aio                  : %s (number of contexts: %d)\n",
-	   iotest.naio ? "Yes" : "No",
-	   iotest.naio);
-    printf("  Block size           : %7d [Byte]\n",
-	   iotest.blksiz);
-    printf("  Access region        : %12lu - %12lu (%12lu) [block]\n",
-	   iotest.ofst0,
-	   iotest.ofst1,
-	   iotest.ofst1-iotest.ofst0);
-    printf("                       : %12lld - %12lld (%12lld) [MB]\n",
-	   (unsigned long long)iotest.ofst0 * iotest.blksiz / MEGA,
-	   (unsigned long long)iotest.ofst1 * iotest.blksiz / MEGA,
-	   (unsigned long long)(iotest.ofst1-iotest.ofst0) * iotest.blksiz / MEGA);
-    printf("                       : %12lld - %12lld (%12lld) [MiB]\n",
-	   (unsigned long long)iotest.ofst0 * iotest.blksiz / MEBI,
-	   (unsigned long long)iotest.ofst1 * iotest.blksiz / MEBI,
-	   (unsigned long long)(iotest.ofst1-iotest.ofst0) * iotest.blksiz / MEBI);
-    printf("  Number of I/Os       : %12d [block] %12d [block/thread]\n",
-	   iotest.nio * iotest.nthr,
-	   iotest.nio);
-    printf("                       : %12lld [MB]    %12lld [MB/thread]\n",
-	   (unsigned long long)iotest.nio * iotest.blksiz / MEGA * iotest.nthr,
-	   (unsigned long long)iotest.nio * iotest.blksiz / MEGA);
-    printf("                       : %12lld [MiB]   %12lld [MiB/thread]\n",
-	   (unsigned long long)iotest.nio * iotest.blksiz / MEBI * iotest.nthr,
-    	   (unsigned long long)iotest.nio * iotest.blksiz / MEBI);
+    unsigned long long n = 0;
+    double avg = 0;
+
+    for(i=0; i<HIST_NBUCKET; i++){
+	n += h->cnt[i];
+	if(!sum)
+	    avg += (double)h->cnt[i] * iotest_hist_value(i);
+    }
+    avg = n ? (sum ? (double)sum : avg) / n : 0;
+
+    printf("  %-20s : avg %9.6f  50%% %9.6f  99%% %9.6f  99.9%% %9.6f  max %9.6f [ms]\n",
+	   label,
+	   NSEC2MSEC(avg),
+	   NSEC2MSEC(iotest_hist_percentile(h->cnt, NULL, 50)),
+	   NSEC2MSEC(iotest_hist_percentile(h->cnt, NULL, 99)),
+	   NSEC2MSEC(iotest_hist_percentile(h->cnt, NULL, 99.9)),
+	   NSEC2MSEC(iotest_hist_percentile(h->cnt, NULL, 100)));
 }
 
 /*
- * print_result():
+ * print_result_sweep(): prints the throughput/latency curve and the knee
  */
 
-static void print_result()
+static void print_result_sweep(void)
 {
-    int i;
-    double sum_acciotim = 0, sum_mxiotim = 0;
-    
+    int i, j;
+
     printf("\
 ************************************************************\n\
-  iotest - Global result\n\
+  iotest - Sweep result\n\
 ************************************************************\n\
 ");
+    printf("  %7s %7s %9s %11s %12s %10s %12s %12s %10s\n",
+	   "threads", "aio", "blksiz", "concurrency",
+	   "[block/s]", "[MB/s]", "avg [ms]", "max [ms]", "cpu [us]");
+    for(i=0; i<iotest.npoint; i++){
+	struct iotest_point_t *pt = &(iotest.point[i]);
+	double elapsed = NSEC2DOUBLE(pt->elapsed);
+	printf("  %7d %7d %9d %11d %12.3f %10.3f %12.6f %12.6f %10.3f\n",
+	       pt->nthr, pt->naio, pt->blksiz,
+	       pt->nthr * (pt->naio ? pt->naio : 1),
+	       (double)pt->nio / elapsed,
+	       (double)pt->nio * pt->blksiz / elapsed / MEGA,
+	       pt->nio ? NSEC2MSEC(pt->acciotim) / pt->nio : 0.0,
+	       NSEC2MSEC(pt->mxiotim),
+	       pt->ndone ? (double)pt->cpu / pt->ndone / KILO : 0.0);
+    }
 
-    printf("  Exec. time           : %9.3f - %9.3f (%9.3f) [s]\n",
-	   TIMEVAL2DOUBLE(iotest.tv[0]),
-	   TIMEVAL2DOUBLE(iotest.tv[1]),
-	   TIMEVAL2DOUBLE(iotest.tv[1]) - TIMEVAL2DOUBLE(iotest.tv[0]));
+    /* Knee for each block size */
+    for(i=0; i<iotest.npoint; i++){
+	struct iotest_point_t *pt = &(iotest.point[i]), *knee;
+	double peak;
+
+	for(j=0; j<i; j++)
+	    if(iotest.point[j].blksiz == pt->blksiz)
+		break;
+	if(j < i)
+	    continue;
+
+	knee = sweep_knee(pt->blksiz, &peak);
+	printf("  Knee (%3d%% of peak) : block size %d [Byte]: concurrency %d"
+	       " (threads %d, aio %d), %9.3f of %9.3f [block/s]\n",
+	       iotest.knee, pt->blksiz,
+	       knee->nthr * (knee->naio ? knee->naio : 1), knee->nthr, knee->naio,
+	       (double)knee->nio * GIGA / knee->elapsed, peak * GIGA);
+    }
+}
 
-    printf("  Total throughput     : %9.3f [block/s]\n",
-	   (double)iotest.nio * iotest.nthr /
-	   (TIMEVAL2DOUBLE(iotest.tv[1]) - TIMEVAL2DOUBLE(iotest.tv[0])));
-    printf("                       : %9.3f [MB/s]\n",
-	   (double)iotest.nio * iotest.nthr * iotest.blksiz /
-	   (TIMEVAL2DOUBLE(iotest.tv[1]) - TIMEVAL2DOUBLE(iotest.tv[0]))
-	   / MEGA);
-    printf("                       : %9.3f [MiB/s]\n",
-	   (double)iotest.nio * iotest.nthr * iotest.blksiz /
-	   (TIMEVAL2DOUBLE(iotest.tv[1]) - TIMEVAL2DOUBLE(iotest.tv[0]))
-	   / MEBI);
+/*
+ * print_result_trial(): prints each trial, then mean, standard deviation,
+ * minimum, maximum and 95% confidence interval of the mean over them;
+ * a trial whose modified z-score (by the median absolute deviation) is
+ * over 3.5 in throughput or a percentile is flagged as an outlier
+ */
 
-    for(i=0; i<iotest.nthr; i++)
-	sum_acciotim += iotest.child[i].acciotim;
-    for(i=0; i<iotest.nthr; i++)
-	if(sum_mxiotim < iotest.child[i].mxiotim)
-	    sum_mxiotim = iotest.child[i].mxiotim;
-    printf("  Avg. Resp. time      : %9.3f [ms/block]\n",
-	   sum_acciotim * KILO / (iotest.nio * iotest.nthr));
-    printf("  Max. Resp. time      : %9.3f [ms/block]\n",
-	   sum_mxiotim * KILO);
-    printf("  Accm. I/O time       : %9.3f [s]\n",
-	   sum_acciotim);
-    
-    if(VERBOSE2){
+static void print_result_trial(void)
+{
+    char *name[] = { "[block/s]", "[MB/s]", "avg [ms]", "50% [ms]", "99% [ms]", "99.9% [ms]", "max [ms]" };
+    char *tag[] = { "iops", "mbps", "avg", "p50", "p99", "p99.9", "max" };
+    /* t distribution, 97.5 percentile, by degrees of freedom */
+    double t975[] = { 0, 12.706, 4.303, 3.182, 2.776, 2.571, 2.447, 2.365, 2.306, 2.262, 2.228,
+		      2.201, 2.179, 2.160, 2.145, 2.131, 2.120, 2.110, 2.101, 2.093, 2.086,
+		      2.080, 2.074, 2.069, 2.064, 2.060, 2.056, 2.052, 2.048, 2.045, 2.042 };
+    int n = iotest.npoint, i, m, k;
+    double *v, *dev;
+    unsigned char *flag;
+
+    if(n == 0)
+	return;
+    if((v = (double *)malloc(sizeof(double) * n * NTRIAL_STAT)) == NULL ||
+       (dev = (double *)malloc(sizeof(double) * n)) == NULL ||
+       (flag = (unsigned char *)calloc(n, 1)) == NULL){
+	perror("print_result_trial:malloc()");
+	iotest_exit(EXIT_FAILURE);
+    }
+    for(i=0; i<n; i++){
+	struct iotest_point_t *pt = &(iotest.point[i]);
+	double elapsed = NSEC2DOUBLE(pt->elapsed), *x = v + i * NTRIAL_STAT;
+	x[0] = elapsed > 0 ? pt->nio / elapsed : 0;
+	x[1] = elapsed > 0 ? (double)pt->nbyte / elapsed / MEGA : 0;
+	x[2] = pt->nio ? NSEC2MSEC(pt->acciotim) / pt->nio : 0;
+	x[3] = NSEC2MSEC(pt->pctl[0]);
+	x[4] = NSEC2MSEC(pt->pctl[1]);
+	x[5] = NSEC2MSEC(pt->pctl[2]);
+	x[6] = NSEC2MSEC(pt->mxiotim);
+    }
 
-	printf("\
-************************************************************\n\
-  iotest - Child result(s)\n\
-************************************************************\n\
-");
-	
-	for(i=0; i<iotest.nthr; i++)
-	    print_result_child(i);
+    /* Outliers in throughput and percentiles; the deviation is scaled to
+       that of a normal distribution, by the mean absolute one if the
+       median one is 0 */
+    for(m=0; n >= 3 && m<NTRIAL_STAT; m++){
+	double med, s;
+	if(m == 1 || m == 2 || m == 6)
+	    continue;
+	for(i=0; i<n; i++)
+	    dev[i] = v[i * NTRIAL_STAT + m];
+	med = median(dev, n);
+	for(i=0; i<n; i++)
+	    dev[i] = fabs(v[i * NTRIAL_STAT + m] - med);
+	if((s = 1.4826 * median(dev, n)) == 0){
+	    for(i=0; i<n; i++)
+		s += dev[i];
+	    s = 1.2533 * s / n;
+	}
+	for(i=0; s > 0 && i<n; i++)
+	    if(fabs(v[i * NTRIAL_STAT + m] - med) / s > 3.5)
+		flag[i] |= 1 << m;
     }
-    if(VERBOSE2){
 
-	printf("\
+    printf("\
 ************************************************************\n\
-  iotest - Device result(s)\n\
+  iotest - Trial result\n\
 ************************************************************\n\
 ");
-	
-	for(i=0; i<iotest.ndev; i++)
-	    print_result_dev(i);
+    printf("  %6s", "trial");
+    for(m=0; m<NTRIAL_STAT; m++)
+	printf(" %12s", name[m]);
+    printf("  outlier\n");
+    for(i=0; i<n; i++){
+	printf("  %6d", i + 1);
+	for(m=0; m<NTRIAL_STAT; m++)
+	    printf(m < 2 ? " %12.3f" : " %12.6f", v[i * NTRIAL_STAT + m]);
+	printf("  ");
+	for(m=0, k=0; m<NTRIAL_STAT; m++)
+	    if(flag[i] & (1 << m))
+		printf("%s%s", k++ ? "," : "", tag[m]);
+	printf("%s\n", k ? "" : "-");
+    }
+
+    for(k=0; k<5; k++){
+	char *label[] = { "mean", "stddev", "min", "max", "95% ci" };
+	printf("  %-6s", label[k]);
+	for(m=0; m<NTRIAL_STAT; m++){
+	    double sum = 0, var = 0, mn = v[m], mx = v[m], mean, r;
+	    for(i=0; i<n; i++){
+		double x = v[i * NTRIAL_STAT + m];
+		sum += x;
+		if(mn > x)
+		    mn = x;
+		if(mx < x)
+		    mx = x;
+	    }
+	    mean = sum / n;
+	    for(i=0; i<n; i++)
+		var += (v[i * NTRIAL_STAT + m] - mean) * (v[i * NTRIAL_STAT + m] - mean);
+	    var = n > 1 ? var / (n - 1) : 0;
+	    r = k == 0 ? mean : k == 1 ? sqrt(var) : k == 2 ? mn : k == 3 ? mx :
+		(n - 1 < (int)(sizeof(t975) / sizeof(double)) ? t975[n - 1] : 1.960) * sqrt(var / n);
+	    printf(m < 2 ? " %12.3f" : " %12.6f", r);
+	}
+	printf("\n");
     }
+    if(iotest.stop_signo)
+	printf("  Stopped              : by %s, %d of %d trials run\n",
+	       strsignal(iotest.stop_signo), n, iotest.trial_n);
+
+    free(flag);
+    free(dev);
+    free(v);
 }
 
-static void print_result_child(int id)
+/*
+ * median(): median of n values, which are reordered
+ */
+
+static double median(double *v, int n)
 {
-    struct iotest_thr_t *thr = &(iotest.child[id]);
+    qsort(v, n, sizeof(double), cmp_double);
+    return(n % 2 ? v[n / 2] : (v[n / 2 - 1] + v[n / 2]) / 2);
+}
 
-    printf("  [%02d] Exec. time      : %9.3f - %9.3f (%9.3f) [s]\n",
-	   id,
-	   TIMEVAL2DOUBLE(thr->tv[0]),
-	   TIMEVAL2DOUBLE(thr->tv[1]),
-	   TIMEVAL2DOUBLE(thr->tv[1]) - TIMEVAL2DOUBLE(thr->tv[0]));
+static int cmp_double(const void *a, const void *b)
+{
+    double x = *(const double *)a, y = *(const double *)b;
 
-    printf("       Throughput      : %9.3f [block/s]\n",
-	   (double)iotest.nio /
-	   (TIMEVAL2DOUBLE(thr->tv[1]) - TIMEVAL2DOUBLE(thr->tv[0])));
-    printf("                       : %9.3f [MB/s]\n",
-	   (double)iotest.nio * iotest.blksiz /
-	   (TIMEVAL2DOUBLE(thr->tv[1]) - TIMEVAL2DOUBLE(thr->tv[0]))
-	   / MEGA);
-    printf("                       : %9.3f [MiB/s]\n",
-	   (double)iotest.nio * iotest.blksiz /
-	   (TIMEVAL2DOUBLE(thr->tv[1]) - TIMEVAL2DOUBLE(thr->tv[0]))
-	   / MEBI);
-
-    printf("       Avg. Resp. time : %9.3f [ms/block]\n",
-	   thr->acciotim * KILO / iotest.nio);
-    printf("       Max. Resp. time : %9.3f [ms/block]\n",
-	   thr->mxiotim * KILO);
-    printf("       Accm. I/O time  : %9.3f [s]\n",
-	   thr->acciotim);
+    return(x < y ? -1 : x > y ? 1 : 0);
 }
 
-static void print_result_dev(int id)
+/*
+ * sweep_knee(): the point of the lowest concurrency reaching the knee
+ * among those of a block size, and their peak throughput [block/ns]
+ */
+
+static struct iotest_point_t *sweep_knee(int blksiz, double *peakp)
 {
-    struct iotest_dev_t *dev = &(iotest.dev[id]);
+    struct iotest_point_t *knee = NULL;
+    double peak = 0;
+    int j;
+
+    for(j=0; j<iotest.npoint; j++)
+	if(iotest.point[j].blksiz == blksiz &&
+	   peak < (double)iotest.point[j].nio / iotest.point[j].elapsed)
+	    peak = (double)iotest.point[j].nio / iotest.point[j].elapsed;
+    for(j=0; j<iotest.npoint; j++){
+	struct iotest_point_t *p = &(iotest.point[j]);
+	if(p->blksiz != blksiz)
+	    continue;
+	if((double)p->nio / p->elapsed < peak * iotest.knee / 100)
+	    continue;
+	if(knee == NULL ||
+	   p->nthr * (p->naio ? p->naio : 1) < knee->nthr * (knee->naio ? knee->naio : 1))
+	    knee = p;
+    }
+    if(peakp)
+	*peakp = peak;
+    return(knee);
+}
 
-    printf("  [%02d] Throughput      : %9.3f [block/s]\n",
-	   id,
-	   (double)dev->nio /
-	   (TIMEVAL2DOUBLE(iotest.tv[1]) - TIMEVAL2DOUBLE(iotest.tv[0])));
-    printf("                       : %9.3f [MB/s]\n",
-	   (double)dev->nio * iotest.blksiz /
-	   (TIMEVAL2DOUBLE(iotest.tv[1]) - TIMEVAL2DOUBLE(iotest.tv[0]))
-	   / MEGA);
-    printf("                       : %9.3f [MiB/s]\n",
-	   (double)dev->nio * iotest.blksiz /
-	   (TIMEVAL2DOUBLE(iotest.tv[1]) - TIMEVAL2DOUBLE(iotest.tv[0]))
-	   / MEBI);
-
-    printf("       Avg. Resp. time : %9.3f [ms/block]\n",
-	   dev->acciotim * KILO / iotest.nio);
-    printf("       Max. Resp. time : %9.3f [ms/block]\n",
-	   dev->mxiotim * KILO);
-    printf("       Accm. I/O time  : %9.3f [s]\n",
-	   dev->acciotim);
+/*
+ * point_record(): records the result of the last run as a point
+ */
+
+static void point_record(struct iotest_point_t *pt)
+{
+    struct iotest_hist_t *h;
+    int i;
+
+    if((h = (struct iotest_hist_t *)calloc(1, sizeof(struct iotest_hist_t))) == NULL){
+	perror("point_record:calloc()");
+	iotest_exit(EXIT_FAILURE);
+    }
+
+    pt->nthr = iotest.nthr;
+    pt->naio = iotest.naio;
+    pt->blksiz = iotest.blksiz;
+    pt->elapsed = iotest.ts[1] - iotest.ts[0];
+    pt->nio = pt->nbyte = pt->acciotim = pt->mxiotim = pt->ndone = pt->cpu = 0;
+    for(i=0; i<iotest.nthr; i++){
+	pt->ndone += iotest.child[i].ndone;
+	pt->cpu += iotest.child[i].cpu[0] + iotest.child[i].cpu[1];
+	pt->nio += iotest.child[i].nio;
+	pt->nbyte += iotest.child[i].nbyte;
+	pt->acciotim += iotest.child[i].acciotim;
+	if(pt->mxiotim < iotest.child[i].mxiotim)
+	    pt->mxiotim = iotest.child[i].mxiotim;
+	hist_merge(h, &(iotest.child[i].hist));
+    }
+    pt->pctl[0] = iotest_hist_percentile(h->cnt, NULL, 50);
+    pt->pctl[1] = iotest_hist_percentile(h->cnt, NULL, 99);
+    pt->pctl[2] = iotest_hist_percentile(h->cnt, NULL, 99.9);
+    free(h);
+}
+
+/*
+ * point_result(): fills in a result of the library from a point
+ */
+
+static void point_result(struct iotest_point_t *pt, struct iotest_result_t *res)
+{
+    double elapsed = NSEC2DOUBLE(pt->elapsed);
+
+    memset(res, 0, sizeof(struct iotest_result_t));
+    res->nthr = pt->nthr;
+    res->naio = pt->naio;
+    res->blksiz = pt->blksiz;
+    res->nio = pt->nio;
+    res->elapsed = elapsed;
+    if(elapsed > 0){
+	res->iops = (double)pt->nio / elapsed;
+	res->mbps = (double)pt->nbyte / elapsed / MEGA;
+    }
+    res->avg = pt->nio ? NSEC2MSEC(pt->acciotim) / pt->nio : 0.0;
+    res->p50 = NSEC2MSEC(pt->pctl[0]);
+    res->p99 = NSEC2MSEC(pt->pctl[1]);
+    res->p999 = NSEC2MSEC(pt->pctl[2]);
+    res->max = NSEC2MSEC(pt->mxiotim);
+    res->cpu = pt->ndone ? (double)pt->cpu / pt->ndone / KILO : 0.0;
 }
 
 /*
@@ -1100,7 +7579,7 @@ static unsigned long long getsize(char *fn)
 
     if((fd = open(fn, O_RDONLY, 0)) == -1){
 	perror("getsize:open()");
-	exit(EXIT_FAILURE);
+	iotest_exit(EXIT_FAILURE);
     }
     
     if(fstat(fd, &statbuf) != 0){
@@ -1137,5 +7616,55 @@ static unsigned long long getsize(char *fn)
     return(size);
 }
 
+/*
+ * timer_init(): calibrates the TSC, if used, and measures timer overhead
+ */
+
+static void timer_init(void)
+{
+    int i;
+    unsigned long long t0, t1, d;
+
+#if defined(__x86_64__) || defined(__i386__)
+    if(iotest.timer == TIMER_TSC){
+	unsigned int eax, ebx, ecx, edx;
+	unsigned long long c0, c1;
+	struct timespec req = { 0, 50 * MEGA };
+
+	/* Invariant TSC: CPUID.80000007H:EDX[8] */
+	if(!__get_cpuid(0x80000007, &eax, &ebx, &ecx, &edx) || !(edx & (1 << 8))){
+	    fprintf(stderr, "Error: Invariant TSC is not available on this processor.\n");
+	    iotest_exit(EXIT_FAILURE);
+	}
+
+	c0 = iotest_rdtsc();
+	t0 = iotest_clock();
+	nanosleep(&req, NULL);
+	c1 = iotest_rdtsc();
+	t1 = iotest_clock();
+
+	/* t1 - t0 is far under 2^32 [ns], so the shift fits in 64 bits. */
+	iotest.tsc_base = c0;
+	iotest.tsc_nsec = t0;
+	iotest.tsc_mult = ((t1 - t0) << 32) / (c1 - c0);
+    }
+#else
+    if(iotest.timer == TIMER_TSC){
+	fprintf(stderr, "Error: TSC is not supported on this platform.\n");
+	iotest_exit(EXIT_FAILURE);
+    }
+#endif
+
+    /* The smallest back-to-back difference is taken as the overhead. */
+    iotest.timer_ovh = ~0ULL;
+    for(i=0; i<TIMER_NSAMPLE; i++){
+	t0 = iotest_now();
+	t1 = iotest_now();
+	d = t1 - t0;
+	if(d < iotest.timer_ovh)
+	    iotest.timer_ovh = d;
+    }
+}
+
 /* iotest.c */
 
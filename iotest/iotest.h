@@ -7,59 +7,95 @@
  * Time-stamp: <2007-09-29 17:03:03 kgoda>
  */
 
-#ifdef __linux__
-#define _GNU_SOURCE
-#define _FILE_OFFSET_BITS 64
-#define _LARGEFILE_SOURCE
-#define _LARGEFILE64_SOURCE
+#ifndef IOTEST_H
+#define IOTEST_H
+
+#include <stddef.h>
+
+#define IOTEST_VERSION "1.20"
+
+/*
+ * Library (libiotest.a): a context is configured with the options of the
+ * command, and runs and reports the same; the results are also returned.
+ * Functions return 0, or -1 with errno set on an error. Programs link it
+ * with -lpthread -laio -lm -lrt.
+ *
+ * None of them is thread-safe, even on distinct contexts; call them from
+ * one thread at a time. iotest_configure() parses by getopt(), whose state
+ * is process-wide, and iotest_engine_register() changes the engines shared
+ * by all contexts. A run makes its own worker threads (or, with -m,
+ * processes), each drawing random numbers from its own state, and leaves
+ * signal handling to the caller.
+ */
+
+#ifdef __cplusplus
+extern "C" {
 #endif
 
-#include <stdio.h>
-#include <stdlib.h>
-#include <unistd.h>
-#include <fcntl.h>
-#include <string.h>
+struct iotest_t;
 
-#include <sys/param.h>
-#include <sys/stat.h>
-#include <sys/ioctl.h>
-#include <sys/types.h>
+struct iotest_result_t {
+    int nthr;
+    int naio;
+    int blksiz;
+    unsigned long long nio;
+    double elapsed;                 /* [s] */
+    double iops;
+    double mbps;
+    double avg;                     /* [ms] */
+    double p50;                     /* [ms] */
+    double p99;                     /* [ms] */
+    double p999;                    /* [ms] */
+    double max;                     /* [ms] */
+    double cpu;                     /* [us] user and system time per io */
+};
 
-#include <pthread.h>
+/*
+ * Engines: iotest generates the ios of a worker thread (offsets, devices,
+ * timing and stats) and an engine issues them. An engine keeps its state
+ * of a thread in *data, set up once for up to depth ios in flight and kept
+ * over the runs of a sweep. reap() returns up to max completed ios, waiting
+ * for at least min of them. Functions return -1 with errno on an error.
+ */
 
-#include <errno.h>
+#define IOTEST_OP_READ  0
+#define IOTEST_OP_WRITE 1
 
-#ifdef __sun__
-#ifdef SUNOS5
-#include <sys/sysmacros.h>
-#include <sys/dkio.h>
-#endif
-#ifdef SUNOS4
-#include <sun/dkio.h>
-#endif
-#endif
+struct iotest_io_t {
+    int fd;
+    int op;                         /* IOTEST_OP_* */
+    char *buf;
+    size_t size;                    /* [byte] */
+    unsigned long long ofst;        /* [byte] */
+    int slot;                       /* 0 .. depth-1, fixed */
+    void *priv;                     /* free for the engine */
+};
 
-#if defined(__FreeBSD__) || defined(__OpenBSD__) || defined(__NetBSD__)
-#define _KERNEL
-#include <sys/disklabel.h>
-#undef _KERNEL
-#endif
+struct iotest_engine_t {
+    const char *name;
+    const char *desc;
+    int is_async;                   /* can keep -A ios in flight */
+    int (*setup)(void **data, int depth);
+    int (*submit)(void *data, struct iotest_io_t *io);
+    int (*reap)(void *data, struct iotest_io_t **done, int max, int min);
+    void (*teardown)(void *data);
+};
 
-#ifdef __linux__
-#include <linux/fs.h>
-#include <sys/time.h>
-#include <time.h>
-#endif
+int iotest_engine_register(const struct iotest_engine_t *);
 
-#ifdef __linux__
-#include <libaio.h>
+struct iotest_t *iotest_create(void);
+int iotest_configure(struct iotest_t *, int, char **);
+int iotest_run(struct iotest_t *);
+int iotest_report(struct iotest_t *);
+int iotest_nresult(struct iotest_t *);
+int iotest_result(struct iotest_t *, int, struct iotest_result_t *);
+int iotest_knee(struct iotest_t *, int, struct iotest_result_t *);
+void iotest_destroy(struct iotest_t *);
+
+#ifdef __cplusplus
+}
 #endif
 
-#define VERSION "1.20"
-#define NAME    "iotest"
-#define AUTHOR  "GODA Kazuo"
-#define CONTACT "<kgoda@tkl.iis.u-tokyo.ac.jp>"
+#endif /* IOTEST_H */
 
 /* iotest.h */
-
-
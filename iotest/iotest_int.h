@@ -0,0 +1,266 @@
+/* iotest_int.h
+ *
+ * Copyright (C) 2000- The University of Tokyo.
+ *
+ * Internals shared by iotest, iotstat and iotcoord: system headers, the
+ * latency histogram, and the layouts of the live statistics segment and
+ * of the coordinator protocol. The library interface is iotest.h, which
+ * this includes; programs using libiotest.a include that alone.
+ */
+
+#ifndef IOTEST_INT_H
+#define IOTEST_INT_H
+
+#ifdef __linux__
+#ifndef _GNU_SOURCE
+#define _GNU_SOURCE
+#endif
+#define _FILE_OFFSET_BITS 64
+#define _LARGEFILE_SOURCE
+#define _LARGEFILE64_SOURCE
+#endif
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <unistd.h>
+#include <fcntl.h>
+#include <string.h>
+#include <limits.h>
+#include <math.h>
+#include <stdint.h>
+#include <setjmp.h>
+
+#include <sys/param.h>
+#include <sys/stat.h>
+#include <sys/ioctl.h>
+#include <sys/types.h>
+#include <sys/mman.h>
+#include <sys/wait.h>
+#include <sys/resource.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+
+#include <pthread.h>
+#include <signal.h>
+#include <poll.h>
+
+#include <errno.h>
+
+#ifdef __sun__
+#ifdef SUNOS5
+#include <sys/sysmacros.h>
+#include <sys/dkio.h>
+#endif
+#ifdef SUNOS4
+#include <sun/dkio.h>
+#endif
+#endif
+
+#if defined(__FreeBSD__) || defined(__OpenBSD__) || defined(__NetBSD__)
+#define _KERNEL
+#include <sys/disklabel.h>
+#undef _KERNEL
+#endif
+
+#ifdef __linux__
+#include <linux/fs.h>
+#include <sys/sysmacros.h>
+#include <sys/time.h>
+#include <time.h>
+#endif
+
+#ifdef __linux__
+#include <libaio.h>
+#include <sys/epoll.h>
+#include <sys/eventfd.h>
+#include <sys/syscall.h>
+#include <linux/perf_event.h>
+#endif
+
+#if defined(__x86_64__) || defined(__i386__)
+#include <cpuid.h>
+#include <x86intrin.h>
+#endif
+
+#define VERSION IOTEST_VERSION         /* of iotest.h, included below */
+#define NAME    "iotest"
+#define AUTHOR  "GODA Kazuo"
+#define CONTACT "<kgoda@tkl.iis.u-tokyo.ac.jp>"
+
+/*
+ * Units
+ */
+
+#define KILO     (1000)
+#define MEGA     (KILO*KILO)
+#define GIGA     (KILO*KILO*KILO)
+#define KIBI     (1024)
+#define MEBI     (KIBI*KIBI)
+#define GIBI     (KIBI*KIBI*KIBI)
+
+#define NSEC2DOUBLE(a)                      \
+    ((double)(a) / (double) GIGA)
+
+#define NSEC2MSEC(a)                        \
+    ((double)(a) / (double) MEGA)
+
+#define NSEC2USEC(a)                        \
+    ((double)(a) / (double) KILO)
+
+/*
+ * Latency histogram: log-linear buckets, 2^HIST_SUBBITS per power of two
+ */
+
+#define HIST_SUBBITS 5
+#define HIST_NSUB    (1 << HIST_SUBBITS)
+#define HIST_MAXBIT  40             /* 2^40 [ns], about 18 minutes */
+#define HIST_NBUCKET ((HIST_MAXBIT - HIST_SUBBITS + 2) << HIST_SUBBITS)
+
+struct iotest_hist_t {
+    uint64_t cnt[HIST_NBUCKET];
+};
+
+/*
+ * iotest_hist_index(), iotest_hist_value(): bucket of a sample [ns], and
+ * the value representing a bucket
+ */
+
+static inline int iotest_hist_index(unsigned long long v)
+{
+    int msb;
+
+    if(v < HIST_NSUB)
+	return((int)v);
+    msb = 63 - __builtin_clzll(v);
+    if(msb > HIST_MAXBIT)
+	return(HIST_NBUCKET - 1);
+    return(((msb - HIST_SUBBITS + 1) << HIST_SUBBITS)
+	   + (int)((v >> (msb - HIST_SUBBITS)) & (HIST_NSUB - 1)));
+}
+
+static inline unsigned long long iotest_hist_value(int idx)
+{
+    int e;
+
+    if(idx < HIST_NSUB)
+	return(idx);
+    e = (idx >> HIST_SUBBITS) - 1;
+    return(((unsigned long long)(HIST_NSUB + (idx & (HIST_NSUB - 1))) << e)
+	   + ((1ULL << e) >> 1));
+}
+
+/*
+ * iotest_hist_percentile(): p-th percentile [ns] of the samples counted
+ * in cnt, less those in since unless it is NULL (those of an earlier
+ * snapshot of the same counts)
+ */
+
+static inline unsigned long long iotest_hist_percentile(const uint64_t *cnt, const uint64_t *since,
+							double p)
+{
+    unsigned long long n = 0, k, acc = 0;
+    int i;
+
+    for(i=0; i<HIST_NBUCKET; i++)
+	n += cnt[i] - (since ? since[i] : 0);
+    if(n == 0)
+	return(0);
+
+    k = (unsigned long long)ceil(n * p / 100);
+    if(k < 1)
+	k = 1;
+    for(i=0; i<HIST_NBUCKET; i++){
+	acc += cnt[i] - (since ? since[i] : 0);
+	if(acc >= k)
+	    return(iotest_hist_value(i));
+    }
+    return(iotest_hist_value(HIST_NBUCKET - 1));
+}
+
+/*
+ * Live statistics (-Z): a shared memory segment of the running counters,
+ * updated by iotest under a sequence counter and read by iotstat. The
+ * header is followed by the entries of nthr threads and of ndev devices,
+ * and then by the histograms of the threads.
+ */
+
+#define IOTEST_STAT_MAGIC   0x494f5453  /* "IOTS" */
+#define IOTEST_STAT_VERSION 1
+
+#define IOTEST_STAT_RUNNING 1
+#define IOTEST_STAT_DONE    2
+
+struct iotest_stat_ent_t {
+    char name[64];
+    uint64_t nio;
+    uint64_t nbyte;
+    uint64_t acciotim;              /* [ns] */
+    uint64_t mxiotim;               /* [ns] */
+};
+
+struct iotest_stat_hdr_t {
+    uint32_t magic;
+    uint32_t version;
+    uint64_t size;                  /* of the segment [byte] */
+    uint32_t nthr;
+    uint32_t ndev;
+    uint32_t hist_nbucket;
+    uint32_t interval;              /* of updates [ms] */
+    int32_t pid;
+    volatile uint32_t state;        /* IOTEST_STAT_* */
+    volatile uint32_t stop;         /* set by a viewer to stop the run */
+    uint32_t run;                   /* counts runs (sweep points, copy methods) */
+    volatile uint64_t seq;          /* odd while being updated */
+    uint64_t ts;                    /* monotonic time of the update [ns] */
+};
+
+#define IOTEST_STAT_THR(h, i)                                       \
+    ((struct iotest_stat_ent_t *)((h) + 1) + (i))
+#define IOTEST_STAT_DEV(h, i)                                       \
+    ((struct iotest_stat_ent_t *)((h) + 1) + (h)->nthr + (i))
+#define IOTEST_STAT_HIST(h, i)                                      \
+    ((uint64_t *)((struct iotest_stat_ent_t *)((h) + 1) + (h)->nthr + (h)->ndev) \
+     + (size_t)(i) * (h)->hist_nbucket)
+#define IOTEST_STAT_SIZE(nthr, ndev)                                \
+    (sizeof(struct iotest_stat_hdr_t)                               \
+     + sizeof(struct iotest_stat_ent_t) * ((nthr) + (ndev))         \
+     + sizeof(uint64_t) * HIST_NBUCKET * (nthr))
+
+/*
+ * Coordinator (-z): iotest connects to iotcoord over a Unix domain socket
+ * or TCP on loopback, waits to be started together with the others, and
+ * sends its counters every interval and at the end. A message carrying
+ * counters (STAT, FINAL) is followed by the histogram of the worker,
+ * HIST_NBUCKET counts. Times are of CLOCK_MONOTONIC_RAW [ns].
+ */
+
+#define IOTEST_COORD_MAGIC  0x494f5443  /* "IOTC" */
+
+#define IOTEST_COORD_HELLO  1           /* worker: name, threads and devices */
+#define IOTEST_COORD_READY  2           /* worker: set up, waiting to start */
+#define IOTEST_COORD_START  3           /* coordinator: start time and interval */
+#define IOTEST_COORD_STAT   4           /* worker: counters so far */
+#define IOTEST_COORD_FINAL  5           /* worker: counters of the run */
+#define IOTEST_COORD_STOP   6           /* coordinator: stop the run */
+
+struct iotest_coord_msg_t {
+    uint32_t magic;
+    uint32_t type;
+    int32_t pid;
+    uint32_t nthr;
+    uint32_t ndev;
+    uint32_t interval;              /* START: of STAT messages [ms] */
+    uint64_t ts;                    /* START: time to start; others: time sent */
+    uint64_t go;                    /* STAT, FINAL: time released */
+    uint64_t ts0, ts1;              /* FINAL: span of the run */
+    struct iotest_stat_ent_t tot;   /* name of the worker, and its counters */
+};
+
+#include "iotest.h"
+
+#endif /* IOTEST_INT_H */
+
+/* iotest_int.h */
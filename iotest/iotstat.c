@@ -0,0 +1,302 @@
+/* iotstat.c
+ *
+ * Copyright (C) 2000- GODA Kazuo (The University of Tokyo)
+ *
+ * Live view of the counters published by iotest -Z
+ */
+
+#include "iotest_int.h"
+
+static struct {
+    struct iotest_stat_hdr_t *h;    /* segment */
+    struct iotest_stat_hdr_t *cur;  /* consistent copies of the segment */
+    struct iotest_stat_hdr_t *prev;
+    uint64_t t0;                    /* time of the first snapshot [ns] */
+    int interval;                   /* [ms] */
+    int count;
+    int is_thread;
+} iotstat;
+
+static void print_usage(void);
+static void attach(char *, int);
+static void snapshot(struct iotest_stat_hdr_t *);
+static void check_alive(void);
+static void print_interval(void);
+static void print_row(char *, struct iotest_stat_ent_t *, struct iotest_stat_ent_t *,
+		      double, uint64_t *, uint64_t *);
+
+/*
+ *
+ * Main
+ *
+ */
+
+int main(int argc, char **argv)
+{
+    int ch, is_stop = 0, n;
+
+    iotstat.interval = 0;
+    iotstat.count = 0;
+
+    while((ch = getopt(argc, argv, "i:c:tsV")) != -1){
+	switch(ch){
+	case 'i':
+	    if((iotstat.interval = atoi(optarg)) <= 0){
+		fprintf(stderr, "Error: Interval must be a positive integer.\n");
+		exit(EXIT_FAILURE);
+	    }
+	    break;
+	case 'c':
+	    iotstat.count = atoi(optarg);
+	    break;
+	case 't':
+	    iotstat.is_thread = 1;
+	    break;
+	case 's':
+	    is_stop = 1;
+	    break;
+	case 'V':
+	    printf("iotstat %s\n", VERSION);
+	    exit(EXIT_SUCCESS);
+	default:
+	    print_usage();
+	    exit(EXIT_FAILURE);
+	}
+    }
+    if(optind != argc - 1){
+	fprintf(stderr, "Error: name of the segment is not specified.\n");
+	print_usage();
+	exit(EXIT_FAILURE);
+    }
+
+    attach(argv[optind], is_stop);
+
+    if(is_stop){
+	iotstat.h->stop = 1;
+	printf("Stop requested to iotest (pid %d).\n", iotstat.h->pid);
+	exit(EXIT_SUCCESS);
+    }
+
+    if(!iotstat.interval)
+	iotstat.interval = iotstat.h->interval;
+    if((iotstat.cur = (struct iotest_stat_hdr_t *)malloc(iotstat.h->size)) == NULL ||
+       (iotstat.prev = (struct iotest_stat_hdr_t *)malloc(iotstat.h->size)) == NULL){
+	perror("main:malloc()");
+	exit(EXIT_FAILURE);
+    }
+
+    snapshot(iotstat.prev);
+    iotstat.t0 = iotstat.prev->ts;
+    for(n=0; iotstat.count == 0 || n < iotstat.count; n++){
+	struct iotest_stat_hdr_t *t;
+	int is_done = iotstat.h->state == IOTEST_STAT_DONE;
+
+	if(!is_done){
+	    usleep(iotstat.interval * 1000);
+	    check_alive();
+	}
+	snapshot(iotstat.cur);
+	print_interval();
+
+	t = iotstat.prev;
+	iotstat.prev = iotstat.cur;
+	iotstat.cur = t;
+	if(is_done || iotstat.prev->state == IOTEST_STAT_DONE)
+	    break;
+    }
+
+    return(EXIT_SUCCESS);
+}
+
+/*
+ * print_usage():
+ */
+
+static void print_usage(void)
+{
+    fputs("\
+Usage: iotstat [options] name\n\
+Description:\n\
+  Live view of the counters published by iotest -Z name=<name>\n\
+Options:\n\
+  -i <n> : interval (in ms); unless set, the update interval of iotest\n\
+  -c <n> : number of reports; unless set, until iotest ends\n\
+  -t     : reports threads as well as devices\n\
+  -s     : asks iotest to stop the run and print its report\n\
+  -V     : version\n\
+",
+	  stderr);
+}
+
+/*
+ * attach(): maps the segment of the given name
+ */
+
+static void attach(char *arg, int is_rw)
+{
+    char name[NAME_MAX];
+    struct stat st;
+    int fd, i;
+
+    snprintf(name, sizeof(name), "%s%s", arg[0] == '/' ? "" : "/", arg);
+    if((fd = shm_open(name, is_rw ? O_RDWR : O_RDONLY, 0)) < 0){
+	perror("attach:shm_open()");
+	exit(EXIT_FAILURE);
+    }
+
+    /* The segment is sized before it is filled in; wait for the magic. */
+    for(i=0; ; i++){
+	if(fstat(fd, &st) != 0){
+	    perror("attach:fstat()");
+	    exit(EXIT_FAILURE);
+	}
+	if(st.st_size >= sizeof(struct iotest_stat_hdr_t)){
+	    iotstat.h = mmap(NULL, st.st_size, is_rw ? PROT_READ | PROT_WRITE : PROT_READ,
+			     MAP_SHARED, fd, 0);
+	    if(iotstat.h == MAP_FAILED){
+		perror("attach:mmap()");
+		exit(EXIT_FAILURE);
+	    }
+	    if(iotstat.h->magic == IOTEST_STAT_MAGIC)
+		break;
+	    munmap(iotstat.h, st.st_size);
+	}
+	if(i >= 50){
+	    fprintf(stderr, "Error: %s is not a statistics segment of iotest.\n", arg);
+	    exit(EXIT_FAILURE);
+	}
+	usleep(100000);
+    }
+    close(fd);
+
+    __sync_synchronize();
+    if(iotstat.h->version != IOTEST_STAT_VERSION || iotstat.h->hist_nbucket != HIST_NBUCKET){
+	fprintf(stderr, "Error: Statistics version %u is not supported.\n", iotstat.h->version);
+	exit(EXIT_FAILURE);
+    }
+}
+
+/*
+ * snapshot(): copies the segment, retrying while it is being updated
+ */
+
+static void snapshot(struct iotest_stat_hdr_t *dst)
+{
+    uint64_t seq;
+
+    for(;;){
+	seq = iotstat.h->seq;
+	__sync_synchronize();
+	if(seq & 1){
+	    /* iotest may have died in the middle of an update. */
+	    check_alive();
+	    sched_yield();
+	    continue;
+	}
+	memcpy(dst, iotstat.h, iotstat.h->size);
+	__sync_synchronize();
+	if(iotstat.h->seq == seq)
+	    break;
+    }
+    dst->state = iotstat.h->state;
+}
+
+/*
+ * check_alive(): exits if iotest has gone without ending the segment,
+ * killed or failed, since it would never be updated again
+ */
+
+static void check_alive(void)
+{
+    if(iotstat.h->state != IOTEST_STAT_DONE && kill(iotstat.h->pid, 0) == -1 && errno == ESRCH){
+	fprintf(stderr, "Error: iotest (pid %d) has gone without ending the run.\n", iotstat.h->pid);
+	exit(EXIT_FAILURE);
+    }
+}
+
+/*
+ * print_interval(): prints the rates since the previous snapshot; a new
+ * run of iotest resets the counters, so it is reported from its start
+ */
+
+static void print_interval(void)
+{
+    struct iotest_stat_hdr_t *c = iotstat.cur, *p = iotstat.prev;
+    struct iotest_stat_ent_t zero, tot, ptot;
+    uint64_t *hist, *phist;
+    double elapsed;
+    int i, is_new = c->run != p->run;
+    unsigned int k;
+
+    memset(&zero, 0, sizeof(zero));
+    elapsed = NSEC2DOUBLE(c->ts - p->ts);
+    if(elapsed <= 0)
+	return;
+
+    if((hist = (uint64_t *)calloc(2 * c->hist_nbucket, sizeof(uint64_t))) == NULL){
+	perror("print_interval:calloc()");
+	exit(EXIT_FAILURE);
+    }
+    phist = hist + c->hist_nbucket;
+
+    memset(&tot, 0, sizeof(tot));
+    memset(&ptot, 0, sizeof(ptot));
+    for(i=0; i<c->nthr; i++){
+	struct iotest_stat_ent_t *e = IOTEST_STAT_THR(c, i), *pe = IOTEST_STAT_THR(p, i);
+	tot.nio += e->nio;
+	tot.nbyte += e->nbyte;
+	tot.acciotim += e->acciotim;
+	if(tot.mxiotim < e->mxiotim)
+	    tot.mxiotim = e->mxiotim;
+	for(k=0; k<c->hist_nbucket; k++)
+	    hist[k] += IOTEST_STAT_HIST(c, i)[k];
+	if(is_new)
+	    continue;
+	ptot.nio += pe->nio;
+	ptot.nbyte += pe->nbyte;
+	ptot.acciotim += pe->acciotim;
+	for(k=0; k<c->hist_nbucket; k++)
+	    phist[k] += IOTEST_STAT_HIST(p, i)[k];
+    }
+    strcpy(tot.name, "total");
+
+    printf("%9.3f [s] run %u%s\n", NSEC2DOUBLE(c->ts - iotstat.t0),
+	   c->run, c->state == IOTEST_STAT_DONE ? " (done)" : "");
+    printf("  %-24s %12s %10s %10s %10s %10s\n",
+	   "", "[IO/s]", "[MB/s]", "avg [ms]", "99% [ms]", "max [ms]");
+    for(i=0; i<c->ndev; i++)
+	print_row(IOTEST_STAT_DEV(c, i)->name, IOTEST_STAT_DEV(c, i),
+		  is_new ? &zero : IOTEST_STAT_DEV(p, i), elapsed, NULL, NULL);
+    if(iotstat.is_thread)
+	for(i=0; i<c->nthr; i++)
+	    if(IOTEST_STAT_THR(c, i)->nio)
+		print_row(IOTEST_STAT_THR(c, i)->name, IOTEST_STAT_THR(c, i),
+			  is_new ? &zero : IOTEST_STAT_THR(p, i), elapsed,
+			  IOTEST_STAT_HIST(c, i), is_new ? NULL : IOTEST_STAT_HIST(p, i));
+    print_row(tot.name, &tot, &ptot, elapsed, hist, is_new ? NULL : phist);
+
+    free(hist);
+}
+
+/*
+ * print_row(): prints the rates of an entry over an interval
+ */
+
+static void print_row(char *name, struct iotest_stat_ent_t *e, struct iotest_stat_ent_t *pe,
+		      double elapsed, uint64_t *hist, uint64_t *phist)
+{
+    unsigned long long nio = e->nio - pe->nio;
+
+    printf("  %-24.24s %12.3f %10.3f %10.6f ",
+	   name,
+	   (double)nio / elapsed,
+	   (double)(e->nbyte - pe->nbyte) / elapsed / MEGA,
+	   nio ? NSEC2MSEC(e->acciotim - pe->acciotim) / nio : 0.0);
+    if(hist)
+	printf("%10.6f ", NSEC2MSEC(iotest_hist_percentile(hist, phist, 99)));
+    else
+	printf("%10s ", "-");
+    printf("%10.6f\n", NSEC2MSEC(e->mxiotim));
+}
+
+/* iotstat.c */